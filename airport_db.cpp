@@ -0,0 +1,77 @@
+#include "airport_db.h"
+#include "departure_source.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+static_assert(findAirport("KCVG") != nullptr && findAirport("KCVG")->kind == AirportKind::Large,
+              "the table resolves at compile time");
+static_assert(findAirport("ZZZZ") == nullptr && findAirport("KCV") == nullptr);
+
+namespace {
+
+constexpr int32_t kUnresolved = -2;
+constexpr int32_t kNotInTable = -1;
+
+// Slot per AirportId, resolved on first use; names never change once interned.
+std::vector<int32_t>& slots() {
+  thread_local std::vector<int32_t> s;
+  return s;
+}
+
+} // namespace
+
+const AirportRecord* findAirport(AirportId id) {
+  if (id == kNoAirport) return nullptr;
+  std::vector<int32_t>& s = slots();
+  if (id >= s.size()) s.resize((size_t)id + 1, kUnresolved);
+  if (s[id] == kUnresolved) {
+    const AirportRecord* r = findAirport(AirportDict::name(id));
+    s[id] = r ? (int32_t)(r - kAirportTable) : kNotInTable;
+  }
+  return s[id] == kNotInTable ? nullptr : &kAirportTable[s[id]];
+}
+
+double greatCircleKm(const AirportRecord& a, const AirportRecord& b) {
+  constexpr double kEarthRadiusKm = 6371.0;
+  constexpr double kRad = 3.14159265358979323846 / 180.0;
+  double dLat = (b.lat - a.lat) * kRad;
+  double dLon = (b.lon - a.lon) * kRad;
+  double h = std::sin(dLat / 2) * std::sin(dLat / 2)
+           + std::cos(a.lat * kRad) * std::cos(b.lat * kRad) * std::sin(dLon / 2) * std::sin(dLon / 2);
+  return 2 * kEarthRadiusKm * std::asin(std::sqrt(std::min(1.0, h)));
+}
+
+double routeKm(AirportId from, AirportId to) {
+  const AirportRecord* a = findAirport(from);
+  const AirportRecord* b = findAirport(to);
+  return a && b ? greatCircleKm(*a, *b) : 0.0;
+}
+
+double routeKm(AirportId from, AirportId to, long observedSeconds) {
+  const AirportRecord* a = findAirport(from);
+  const AirportRecord* b = findAirport(to);
+  if (a && b) return greatCircleKm(*a, *b);
+  return std::max(0.0, (double)(observedSeconds - 30 * 60) / 3600.0 * 800.0);
+}
+
+double hubScore(AirportId id) {
+  const AirportRecord* r = findAirport(id);
+  if (!r) return 0.0;
+  if (r->kind == AirportKind::Large) return 1.0;
+  if (r->kind == AirportKind::Medium) return 0.5;
+  return 0.0;
+}
+
+long estimatedFlightSeconds(AirportId from, AirportId to) {
+  const AirportRecord* a = findAirport(from);
+  const AirportRecord* b = findAirport(to);
+  if (!a || !b) return 2 * 3600;
+  return 30 * 60 + std::lround(greatCircleKm(*a, *b) / 800.0 * 3600.0);
+}
+
+long estimatedArrival(const Flight& f) {
+  if (f.lastSeen > 0) return f.lastSeen;
+  return f.firstSeen + estimatedFlightSeconds(f.estDepartureAirport, f.estArrivalAirport);
+}
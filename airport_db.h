@@ -0,0 +1,77 @@
+#pragma once
+#include "airport_dict.h"
+
+#include <cstdint>
+#include <string_view>
+
+struct Flight;
+
+// Compile-time airport database: coordinates and size for every airport in
+// airport_db_data.h, generated by tools/gen_airport_db.py from an OurAirports
+// style CSV. The table is a minimal-probe perfect hash (see the generator), so
+// a lookup by ICAO code is two hashes and one compare, with no allocation and
+// nothing loaded at run time. Airports not in the table are simply unknown.
+
+enum class AirportKind : uint8_t { Unknown, Closed, Heliport, SeaplaneBase, Small, Medium, Large };
+
+struct AirportRecord {
+  uint32_t key = 0; // airportKey() of the ICAO code; 0 = empty slot
+  float lat = 0;
+  float lon = 0;
+  AirportKind kind = AirportKind::Unknown;
+};
+
+// The four characters of an ICAO code packed little-endian; 0 for any other length.
+constexpr uint32_t airportKey(std::string_view icao) {
+  if (icao.size() != 4) return 0;
+  uint32_t key = 0;
+  for (size_t i = 0; i < 4; i++) key |= (uint32_t)(unsigned char)icao[i] << (8 * i);
+  return key;
+}
+
+// A 32-bit finaliser (murmur3's) over key ^ seed; the generator mirrors it.
+constexpr uint32_t airportHash(uint32_t key, uint32_t seed) {
+  uint32_t h = key ^ (seed * 0x9E3779B9u);
+  h ^= h >> 16;
+  h *= 0x85EBCA6Bu;
+  h ^= h >> 13;
+  h *= 0xC2B2AE35u;
+  h ^= h >> 16;
+  return h;
+}
+
+#include "airport_db_data.h"
+
+// nullptr if the code is not in the table.
+constexpr const AirportRecord* findAirport(std::string_view icao) {
+  uint32_t key = airportKey(icao);
+  if (key == 0) return nullptr;
+  uint32_t d = kAirportDisplacement[airportHash(key, 0) % kAirportBuckets];
+  const AirportRecord& r = kAirportTable[airportHash(key, d) % kAirportSlots];
+  return r.key == key ? &r : nullptr;
+}
+
+// The same by interned ID, memoised per thread.
+const AirportRecord* findAirport(AirportId id);
+
+// Great-circle distance on a spherical Earth.
+double greatCircleKm(const AirportRecord& a, const AirportRecord& b);
+
+// Distance between two airports, 0 if either is unknown.
+double routeKm(AirportId from, AirportId to);
+
+// The same, except that when either airport is unknown the distance is read
+// back from the flight's observed duration (estimatedFlightSeconds() run
+// backwards), so a strip missing from the table is not scored as going
+// nowhere. 0 if an airport is unknown and no duration was observed.
+double routeKm(AirportId from, AirportId to, long observedSeconds);
+
+// 1 for a large airport, 0.5 for a medium one, 0 for anything else or unknown.
+double hubScore(AirportId id);
+
+// Gate-to-gate estimate for a route: half an hour of taxi, climb and descent
+// plus cruise at 800 km/h; two hours when either airport is unknown.
+long estimatedFlightSeconds(AirportId from, AirportId to);
+
+// lastSeen when OpenSky has it, else firstSeen plus the estimate above.
+long estimatedArrival(const Flight& f);
@@ -0,0 +1,200 @@
+// Generated by tools/gen_airport_db.py from airports_seed.csv -- do not edit.
+// 155 airports in 183 slots, 39 buckets. Included by airport_db.h only.
+#pragma once
+
+inline constexpr uint32_t kAirportCount = 155;
+inline constexpr uint32_t kAirportBuckets = 39;
+inline constexpr uint32_t kAirportSlots = 183;
+
+inline constexpr uint32_t kAirportDisplacement[kAirportBuckets] = {
+  1, 15, 6, 0, 67, 6, 1, 3, 3, 0, 101, 1,
+  13, 67, 3, 17, 0, 62, 7, 24, 4, 18, 34, 2,
+  17, 40, 1, 35, 4, 4, 5, 95, 100, 15, 8, 25,
+  1, 19, 7,
+};
+
+inline constexpr AirportRecord kAirportTable[kAirportSlots] = {
+  {},
+  {airportKey("KSJC"), 37.3626f, -121.9291f, AirportKind::Medium},
+  {airportKey("LTFM"), 41.2753f, 28.7519f, AirportKind::Large},
+  {airportKey("KSNA"), 33.6757f, -117.8682f, AirportKind::Medium},
+  {airportKey("EPWA"), 52.1657f, 20.9671f, AirportKind::Large},
+  {airportKey("KALB"), 42.7483f, -73.8017f, AirportKind::Medium},
+  {airportKey("LIRF"), 41.8003f, 12.2389f, AirportKind::Large},
+  {airportKey("GMMN"), 33.3675f, -7.5898f, AirportKind::Large},
+  {airportKey("YMML"), -37.6733f, 144.8433f, AirportKind::Large},
+  {airportKey("KOKC"), 35.3931f, -97.6007f, AirportKind::Medium},
+  {airportKey("YBBN"), -27.3842f, 153.1175f, AirportKind::Large},
+  {airportKey("LOWW"), 48.1103f, 16.5697f, AirportKind::Large},
+  {airportKey("RCTP"), 25.0777f, 121.2330f, AirportKind::Large},
+  {},
+  {airportKey("KBHM"), 33.5629f, -86.7535f, AirportKind::Medium},
+  {airportKey("EKCH"), 55.6180f, 12.6560f, AirportKind::Large},
+  {airportKey("RPLL"), 14.5086f, 121.0194f, AirportKind::Large},
+  {},
+  {airportKey("MPTO"), 9.0714f, -79.3835f, AirportKind::Large},
+  {airportKey("KPBI"), 26.6832f, -80.0956f, AirportKind::Medium},
+  {airportKey("KTUS"), 32.1161f, -110.9410f, AirportKind::Medium},
+  {},
+  {airportKey("LPPT"), 38.7813f, -9.1359f, AirportKind::Large},
+  {airportKey("EDDM"), 48.3538f, 11.7861f, AirportKind::Large},
+  {airportKey("VHHH"), 22.3080f, 113.9185f, AirportKind::Large},
+  {airportKey("SKBO"), 4.7016f, -74.1469f, AirportKind::Large},
+  {airportKey("KOAK"), 37.7213f, -122.2208f, AirportKind::Medium},
+  {airportKey("KMSP"), 44.8820f, -93.2218f, AirportKind::Large},
+  {airportKey("KMKE"), 42.9472f, -87.8966f, AirportKind::Medium},
+  {airportKey("KSEA"), 47.4490f, -122.3093f, AirportKind::Large},
+  {airportKey("KORF"), 36.8946f, -76.2012f, AirportKind::Medium},
+  {airportKey("KMIA"), 25.7932f, -80.2906f, AirportKind::Large},
+  {airportKey("SPJC"), -12.0219f, -77.1143f, AirportKind::Large},
+  {},
+  {},
+  {airportKey("FAOR"), -26.1392f, 28.2460f, AirportKind::Large},
+  {airportKey("LKPR"), 50.1008f, 14.2600f, AirportKind::Large},
+  {airportKey("EFHK"), 60.3172f, 24.9633f, AirportKind::Large},
+  {airportKey("LLBG"), 32.0114f, 34.8867f, AirportKind::Large},
+  {airportKey("EGCC"), 53.3537f, -2.2750f, AirportKind::Large},
+  {},
+  {airportKey("HKJK"), -1.3192f, 36.9278f, AirportKind::Large},
+  {airportKey("KDTW"), 42.2124f, -83.3534f, AirportKind::Large},
+  {airportKey("KLUK"), 39.1033f, -84.4186f, AirportKind::Medium},
+  {airportKey("ZGGG"), 23.3924f, 113.2988f, AirportKind::Large},
+  {airportKey("KLGA"), 40.7772f, -73.8726f, AirportKind::Large},
+  {airportKey("KJFK"), 40.6398f, -73.7789f, AirportKind::Large},
+  {airportKey("KJAX"), 30.4941f, -81.6879f, AirportKind::Medium},
+  {},
+  {airportKey("KLEX"), 38.0365f, -84.6059f, AirportKind::Medium},
+  {airportKey("KMCO"), 28.4294f, -81.3090f, AirportKind::Large},
+  {airportKey("ZSPD"), 31.1443f, 121.8083f, AirportKind::Large},
+  {airportKey("KMSY"), 29.9934f, -90.2580f, AirportKind::Medium},
+  {airportKey("LGAV"), 37.9364f, 23.9445f, AirportKind::Large},
+  {airportKey("VABB"), 19.0887f, 72.8679f, AirportKind::Large},
+  {airportKey("KIND"), 39.7173f, -86.2944f, AirportKind::Medium},
+  {airportKey("KOMA"), 41.3032f, -95.8941f, AirportKind::Medium},
+  {airportKey("KPIT"), 40.4915f, -80.2329f, AirportKind::Medium},
+  {},
+  {airportKey("KRIC"), 37.5052f, -77.3197f, AirportKind::Medium},
+  {airportKey("KCHA"), 35.0353f, -85.2038f, AirportKind::Medium},
+  {airportKey("KELP"), 31.8072f, -106.3778f, AirportKind::Medium},
+  {airportKey("KMCI"), 39.2976f, -94.7139f, AirportKind::Large},
+  {airportKey("KONT"), 34.0560f, -117.6012f, AirportKind::Medium},
+  {airportKey("LEBL"), 41.2971f, 2.0785f, AirportKind::Large},
+  {airportKey("UUEE"), 55.9726f, 37.4146f, AirportKind::Large},
+  {airportKey("KGRR"), 42.8808f, -85.5228f, AirportKind::Medium},
+  {airportKey("KSAT"), 29.5337f, -98.4698f, AirportKind::Medium},
+  {airportKey("EDDF"), 50.0333f, 8.5706f, AirportKind::Large},
+  {airportKey("KGSO"), 36.0978f, -79.9373f, AirportKind::Medium},
+  {airportKey("KMBT"), 35.8775f, -86.3775f, AirportKind::Small},
+  {},
+  {airportKey("KBWI"), 39.1754f, -76.6683f, AirportKind::Large},
+  {airportKey("MMUN"), 21.0365f, -86.8771f, AirportKind::Large},
+  {airportKey("NZAA"), -37.0081f, 174.7917f, AirportKind::Large},
+  {airportKey("RJTT"), 35.5523f, 139.7800f, AirportKind::Large},
+  {airportKey("KBDL"), 41.9389f, -72.6832f, AirportKind::Medium},
+  {airportKey("EGLL"), 51.4700f, -0.4543f, AirportKind::Large},
+  {airportKey("SBGR"), -23.4356f, -46.4731f, AirportKind::Large},
+  {},
+  {airportKey("KDCA"), 38.8521f, -77.0377f, AirportKind::Large},
+  {airportKey("VTBS"), 13.6900f, 100.7501f, AirportKind::Large},
+  {airportKey("KCLE"), 41.4117f, -81.8498f, AirportKind::Medium},
+  {airportKey("KIAD"), 38.9445f, -77.4558f, AirportKind::Large},
+  {airportKey("KFLL"), 26.0726f, -80.1527f, AirportKind::Large},
+  {airportKey("KMEM"), 35.0424f, -89.9767f, AirportKind::Large},
+  {airportKey("KBUF"), 42.9405f, -78.7322f, AirportKind::Medium},
+  {airportKey("SCEL"), -33.3930f, -70.7858f, AirportKind::Large},
+  {airportKey("KATL"), 33.6367f, -84.4281f, AirportKind::Large},
+  {airportKey("KRNO"), 39.4991f, -119.7681f, AirportKind::Medium},
+  {airportKey("KEWR"), 40.6925f, -74.1687f, AirportKind::Large},
+  {},
+  {airportKey("KDSM"), 41.5340f, -93.6631f, AirportKind::Medium},
+  {airportKey("KDAL"), 32.8471f, -96.8518f, AirportKind::Large},
+  {},
+  {airportKey("RJAA"), 35.7647f, 140.3864f, AirportKind::Large},
+  {},
+  {airportKey("KIAH"), 29.9844f, -95.3414f, AirportKind::Large},
+  {},
+  {airportKey("KMDW"), 41.7860f, -87.7524f, AirportKind::Large},
+  {airportKey("KBOI"), 43.5644f, -116.2228f, AirportKind::Medium},
+  {airportKey("KBUR"), 34.2007f, -118.3585f, AirportKind::Medium},
+  {airportKey("PHNL"), 21.3187f, -157.9225f, AirportKind::Large},
+  {airportKey("ENGM"), 60.1939f, 11.1004f, AirportKind::Large},
+  {airportKey("WSSS"), 1.3502f, 103.9944f, AirportKind::Large},
+  {airportKey("WMKK"), 2.7456f, 101.7099f, AirportKind::Large},
+  {airportKey("OEJN"), 21.6796f, 39.1565f, AirportKind::Large},
+  {airportKey("KJWN"), 36.1824f, -86.8867f, AirportKind::Small},
+  {airportKey("KPHL"), 39.8719f, -75.2411f, AirportKind::Large},
+  {airportKey("CYUL"), 45.4706f, -73.7408f, AirportKind::Large},
+  {},
+  {airportKey("CYYC"), 51.1139f, -114.0203f, AirportKind::Large},
+  {airportKey("KAUS"), 30.1945f, -97.6699f, AirportKind::Large},
+  {airportKey("OTHH"), 25.2731f, 51.6081f, AirportKind::Large},
+  {airportKey("MMMX"), 19.4363f, -99.0721f, AirportKind::Large},
+  {},
+  {airportKey("KBNA"), 36.1245f, -86.6782f, AirportKind::Large},
+  {airportKey("KDEN"), 39.8617f, -104.6732f, AirportKind::Large},
+  {airportKey("YSSY"), -33.9461f, 151.1772f, AirportKind::Large},
+  {airportKey("CYVR"), 49.1939f, -123.1844f, AirportKind::Large},
+  {airportKey("DNMM"), 6.5774f, 3.3212f, AirportKind::Large},
+  {airportKey("KPVD"), 41.7240f, -71.4282f, AirportKind::Medium},
+  {airportKey("KCVG"), 39.0488f, -84.6678f, AirportKind::Large},
+  {airportKey("KSFO"), 37.6190f, -122.3749f, AirportKind::Large},
+  {airportKey("KSLC"), 40.7884f, -111.9778f, AirportKind::Large},
+  {airportKey("SAEZ"), -34.8222f, -58.5358f, AirportKind::Large},
+  {airportKey("LSZH"), 47.4647f, 8.5492f, AirportKind::Large},
+  {},
+  {airportKey("KTYS"), 35.8110f, -83.9940f, AirportKind::Medium},
+  {airportKey("KSYR"), 43.1112f, -76.1063f, AirportKind::Medium},
+  {airportKey("LIMC"), 45.6306f, 8.7281f, AirportKind::Large},
+  {airportKey("BIKF"), 63.9850f, -22.6056f, AirportKind::Large},
+  {airportKey("KBOS"), 42.3643f, -71.0052f, AirportKind::Large},
+  {airportKey("KLAX"), 33.9425f, -118.4081f, AirportKind::Large},
+  {},
+  {airportKey("KSAN"), 32.7336f, -117.1897f, AirportKind::Large},
+  {airportKey("KPHX"), 33.4343f, -112.0116f, AirportKind::Large},
+  {},
+  {},
+  {airportKey("EIDW"), 53.4213f, -6.2701f, AirportKind::Large},
+  {airportKey("WIII"), -6.1256f, 106.6559f, AirportKind::Large},
+  {airportKey("KTUL"), 36.1984f, -95.8881f, AirportKind::Medium},
+  {},
+  {airportKey("RKSI"), 37.4602f, 126.4407f, AirportKind::Large},
+  {airportKey("LEMD"), 40.4719f, -3.5626f, AirportKind::Large},
+  {airportKey("KSDF"), 38.1744f, -85.7360f, AirportKind::Large},
+  {airportKey("EBBR"), 50.9014f, 4.4844f, AirportKind::Large},
+  {},
+  {},
+  {airportKey("KTPA"), 27.9755f, -82.5332f, AirportKind::Large},
+  {airportKey("EGKK"), 51.1481f, -0.1903f, AirportKind::Large},
+  {airportKey("KDFW"), 32.8968f, -97.0380f, AirportKind::Large},
+  {},
+  {airportKey("KRDU"), 35.8776f, -78.7875f, AirportKind::Medium},
+  {airportKey("HECA"), 30.1219f, 31.4056f, AirportKind::Large},
+  {airportKey("KORD"), 41.9786f, -87.9048f, AirportKind::Large},
+  {airportKey("KRSW"), 26.5362f, -81.7552f, AirportKind::Medium},
+  {airportKey("OMDB"), 25.2528f, 55.3644f, AirportKind::Large},
+  {airportKey("KDAY"), 39.9024f, -84.2194f, AirportKind::Medium},
+  {airportKey("KCMH"), 39.9980f, -82.8919f, AirportKind::Medium},
+  {airportKey("EDDB"), 52.3667f, 13.5033f, AirportKind::Large},
+  {},
+  {airportKey("VIDP"), 28.5665f, 77.1031f, AirportKind::Large},
+  {airportKey("KSTL"), 38.7487f, -90.3700f, AirportKind::Large},
+  {airportKey("KCLT"), 35.2140f, -80.9431f, AirportKind::Large},
+  {airportKey("LFPG"), 49.0097f, 2.5479f, AirportKind::Large},
+  {airportKey("KLAS"), 36.0801f, -115.1522f, AirportKind::Large},
+  {airportKey("KSMF"), 38.6954f, -121.5908f, AirportKind::Medium},
+  {airportKey("PANC"), 61.1743f, -149.9962f, AirportKind::Large},
+  {},
+  {airportKey("KSAV"), 32.1276f, -81.2021f, AirportKind::Medium},
+  {airportKey("KPDX"), 45.5887f, -122.5975f, AirportKind::Large},
+  {airportKey("EHAM"), 52.3086f, 4.7639f, AirportKind::Large},
+  {airportKey("LFPO"), 48.7233f, 2.3794f, AirportKind::Large},
+  {airportKey("KM33"), 36.3769f, -86.4088f, AirportKind::Small},
+  {airportKey("KABQ"), 35.0402f, -106.6092f, AirportKind::Medium},
+  {airportKey("KCHS"), 32.8986f, -80.0405f, AirportKind::Medium},
+  {airportKey("ZBAA"), 40.0801f, 116.5846f, AirportKind::Large},
+  {airportKey("ESSA"), 59.6519f, 17.9186f, AirportKind::Large},
+  {},
+  {airportKey("KHOU"), 29.6454f, -95.2789f, AirportKind::Large},
+  {airportKey("CYYZ"), 43.6772f, -79.6306f, AirportKind::Large},
+  {airportKey("RJBB"), 34.4273f, 135.2440f, AirportKind::Large},
+};
@@ -0,0 +1,97 @@
+#include "airport_dict.h"
+
+#include <deque>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+struct Dict {
+  std::shared_mutex mu;
+  std::deque<std::string> names{""}; // deque: element addresses never move
+  std::unordered_map<std::string_view, AirportId> ids;
+};
+
+Dict& dict() {
+  static Dict d;
+  return d;
+}
+
+struct Hash {
+  using is_transparent = void;
+  size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+};
+
+// Lookups this thread has already resolved. IDs never change once handed out,
+// so hits need no lock -- even a shared lock writes the mutex's reader count,
+// which threads ticking side by side would otherwise keep stealing from each
+// other. Misses (and unknown codes) still go to the shared dictionary.
+struct LocalCache {
+  std::unordered_map<std::string, AirportId, Hash, std::equal_to<>> ids;
+  std::vector<std::string_view> names;
+};
+
+LocalCache& local() {
+  thread_local LocalCache c;
+  return c;
+}
+
+AirportId remember(std::string_view icao, AirportId id) {
+  if (id != kNoAirport) local().ids.emplace(icao, id);
+  return id;
+}
+
+} // namespace
+
+AirportId AirportDict::intern(std::string_view icao) {
+  if (icao.empty()) return kNoAirport;
+  auto cached = local().ids.find(icao);
+  if (cached != local().ids.end()) return cached->second;
+  Dict& d = dict();
+  {
+    std::shared_lock<std::shared_mutex> lock(d.mu);
+    auto it = d.ids.find(icao);
+    if (it != d.ids.end()) return remember(icao, it->second);
+  }
+  std::unique_lock<std::shared_mutex> lock(d.mu);
+  auto it = d.ids.find(icao);
+  if (it != d.ids.end()) return remember(icao, it->second);
+  if (d.names.size() > std::numeric_limits<AirportId>::max()) {
+    throw std::runtime_error("Airport dictionary full");
+  }
+  AirportId id = (AirportId)d.names.size();
+  d.names.emplace_back(icao);
+  d.ids.emplace(d.names.back(), id);
+  return remember(icao, id);
+}
+
+AirportId AirportDict::find(std::string_view icao) {
+  auto cached = local().ids.find(icao);
+  if (cached != local().ids.end()) return cached->second;
+  Dict& d = dict();
+  std::shared_lock<std::shared_mutex> lock(d.mu);
+  auto it = d.ids.find(icao);
+  return it == d.ids.end() ? kNoAirport : remember(icao, it->second);
+}
+
+std::string_view AirportDict::name(AirportId id) {
+  std::vector<std::string_view>& names = local().names;
+  if (id < names.size() && (id == kNoAirport || !names[id].empty())) return names[id];
+  Dict& d = dict();
+  std::shared_lock<std::shared_mutex> lock(d.mu);
+  if (id >= d.names.size()) return {};
+  if (id >= names.size()) names.resize((size_t)id + 1);
+  names[id] = d.names[id];
+  return names[id];
+}
+
+size_t AirportDict::size() {
+  Dict& d = dict();
+  std::shared_lock<std::shared_mutex> lock(d.mu);
+  return d.names.size() - 1;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Process-wide airport dictionary: every ICAO code seen is interned once and
+// referred to by a small integer ID from then on. ID 0 means "no airport".
+// IDs are only meaningful inside one process; persist the ICAO code instead.
+using AirportId = uint16_t;
+constexpr AirportId kNoAirport = 0;
+
+class AirportDict {
+ public:
+  // Thread-safe. Empty codes map to kNoAirport.
+  static AirportId intern(std::string_view icao);
+
+  // kNoAirport if the code has never been interned (does not add it).
+  static AirportId find(std::string_view icao);
+
+  // The code for `id`; "" for kNoAirport. The view stays valid for the process lifetime.
+  static std::string_view name(AirportId id);
+
+  static size_t size();
+};
@@ -0,0 +1,61 @@
+#include "airport_sets.h"
+
+#include <algorithm>
+
+RecentAirports::RecentAirports(int capacity) : ring_((size_t)std::max(1, capacity), kNoAirport) {}
+
+void RecentAirports::setCapacity(int capacity) {
+  std::vector<AirportId> keep = inOrder();
+  size_t n = (size_t)std::max(1, capacity);
+  if (keep.size() > n) keep.erase(keep.begin(), keep.end() - (long)n);
+
+  ring_.assign(n, kNoAirport);
+  head_ = 0;
+  size_ = 0;
+  counts_.clear();
+  for (AirportId id : keep) push(id);
+}
+
+void RecentAirports::push(AirportId id) {
+  if (size_ == ring_.size()) {
+    // Full: the slot about to be overwritten holds the oldest entry.
+    AirportId old = ring_[head_];
+    auto it = counts_.find(old);
+    if (it != counts_.end() && --it->second == 0) counts_.erase(it);
+  } else {
+    size_++;
+  }
+  ring_[head_] = id;
+  counts_[id]++;
+  head_ = (head_ + 1) % ring_.size();
+}
+
+std::vector<AirportId> RecentAirports::inOrder() const {
+  std::vector<AirportId> out;
+  out.reserve(size_);
+  size_t start = (head_ + ring_.size() - size_) % ring_.size();
+  for (size_t i = 0; i < size_; i++) out.push_back(ring_[(start + i) % ring_.size()]);
+  return out;
+}
+
+void VisitedAirports::insert(AirportId id) {
+  if (id == kNoAirport) return;
+  size_t word = id >> 6;
+  if (word >= bits_.size()) bits_.resize(word + 1, 0);
+  uint64_t mask = uint64_t(1) << (id & 63);
+  if (!(bits_[word] & mask)) {
+    bits_[word] |= mask;
+    count_++;
+  }
+}
+
+std::vector<AirportId> VisitedAirports::ids() const {
+  std::vector<AirportId> out;
+  out.reserve(count_);
+  for (size_t w = 0; w < bits_.size(); w++) {
+    for (uint64_t b = bits_[w]; b; b &= b - 1) {
+      out.push_back((AirportId)(w * 64 + (size_t)__builtin_ctzll(b)));
+    }
+  }
+  return out;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "airport_dict.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// The last N airports visited: a ring buffer plus per-airport counts, so both
+// push and lookup are O(1) whatever N is.
+class RecentAirports {
+ public:
+  explicit RecentAirports(int capacity = 10);
+
+  // Shrinking keeps the most recent entries.
+  void setCapacity(int capacity);
+  int capacity() const { return (int)ring_.size(); }
+
+  void push(AirportId id);
+  bool contains(AirportId id) const { return counts_.count(id) != 0; }
+  size_t size() const { return size_; }
+
+  // Oldest first, as stored in state.json.
+  std::vector<AirportId> inOrder() const;
+
+ private:
+  std::vector<AirportId> ring_;
+  size_t head_ = 0; // next slot to write
+  size_t size_ = 0;
+  std::unordered_map<AirportId, uint16_t> counts_;
+};
+
+// Every airport ever visited, as a bitset indexed by AirportId: a few bytes per
+// thousand airports and one bit test per lookup.
+class VisitedAirports {
+ public:
+  void insert(AirportId id);
+  bool contains(AirportId id) const {
+    return id != kNoAirport && (size_t)(id >> 6) < bits_.size() && (bits_[id >> 6] >> (id & 63) & 1);
+  }
+  size_t count() const { return count_; }
+
+  std::vector<AirportId> ids() const;
+
+ private:
+  std::vector<uint64_t> bits_;
+  size_t count_ = 0;
+};
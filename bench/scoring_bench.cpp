@@ -0,0 +1,124 @@
+// Candidate scoring throughput on synthetic departure windows.
+//
+// Compares the per-flight path tick() used to take (personality string
+// compares, std::exp and a distribution draw per candidate, then a full sort)
+// with the batch kernel plus top-K selection from scoring.h.
+//
+//   cmake --build build --target scoring_bench
+//   ./build/scoring_bench [candidates] [rounds]
+
+#include "scoring.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct Input {
+  std::vector<double> durationHours;
+  std::vector<bool> recent;
+};
+
+static Input syntheticWindow(size_t n, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> hours(0.3, 14.0);
+  std::bernoulli_distribution recent(0.1);
+  Input in;
+  in.durationHours.resize(n);
+  in.recent.resize(n);
+  for (size_t i = 0; i < n; i++) {
+    in.durationHours[i] = hours(rng);
+    in.recent[i] = recent(rng);
+  }
+  return in;
+}
+
+// The previous scoreFlight, kept verbatim in spirit for comparison.
+static double legacyScore(const std::string& personality, double durationHours, bool recent, std::mt19937& rng) {
+  double noveltyScore = recent ? -0.5 : 1.0;
+  double shortnessScore = std::exp(-durationHours / 2.0);
+  double longnessScore = std::min(1.0, durationHours / 6.0);
+  std::uniform_real_distribution<double> jitterDist(-0.05, 0.05);
+  double jitter = jitterDist(rng);
+
+  double wNovel = 0.6, wShort = 0.2, wLong = 0.2, wJit = 0.1;
+  if (personality == "chaotic") {
+    wNovel = 0.8; wShort = 0.1; wLong = 0.1; wJit = 0.25;
+  } else if (personality == "budget") {
+    wNovel = 0.5; wShort = 0.6; wLong = 0.0; wJit = 0.08;
+  } else if (personality == "scenic") {
+    wNovel = 0.5; wShort = 0.0; wLong = 0.7; wJit = 0.08;
+  }
+  return wNovel * noveltyScore + wShort * shortnessScore + wLong * longnessScore + wJit * jitter;
+}
+
+static double msSince(std::chrono::steady_clock::time_point t0) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static void report(const std::string& personality, const char* name, size_t n, int rounds, double ms) {
+  std::cout << "{\"bench\":\"scoring\",\"personality\":\"" << personality << "\",\"case\":\"" << name << "\""
+            << ",\"candidates\":" << n << ",\"rounds\":" << rounds
+            << ",\"ms_per_round\":" << ms / rounds
+            << ",\"ns_per_candidate\":" << ms * 1e6 / ((double)n * rounds) << "}\n";
+}
+
+int main(int argc, char** argv) {
+  size_t n = argc > 1 ? (size_t)std::atol(argv[1]) : 100000;
+  int rounds = argc > 2 ? std::atoi(argv[2]) : 50;
+
+  Input in = syntheticWindow(n, 7);
+  volatile double sink = 0;
+
+  for (std::string personality : {"chaotic", "budget", "scenic"}) {
+    std::mt19937 rng(1);
+
+    // Legacy: score one flight at a time, then sort everything.
+    auto t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+      struct Scored { uint32_t idx; double score; };
+      std::vector<Scored> scored;
+      scored.reserve(n);
+      for (uint32_t i = 0; i < n; i++) {
+        scored.push_back({i, legacyScore(personality, in.durationHours[i], in.recent[i], rng)});
+      }
+      std::sort(scored.begin(), scored.end(), [](const Scored& a, const Scored& b) { return a.score > b.score; });
+      sink = sink + scored[0].score;
+    }
+    report(personality, "per_flight_full_sort", n, rounds, msSince(t0));
+
+    // Batch: gather columns, one kernel call, partial top-5.
+    Personality p = parsePersonality(personality);
+    ScoreColumns cols;
+    t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+      cols.resize(n);
+      for (size_t i = 0; i < n; i++) {
+        cols.durationHours[i] = in.durationHours[i];
+        cols.novelty[i] = in.recent[i] ? kNoveltyRecent : kNoveltyNew;
+      }
+      fillJitter(rng, cols.jitter.data(), n);
+      scoreBatch(p, cols);
+      sink = sink + cols.score[topK(cols.score, 5)[0]];
+    }
+    report(personality, "batch_top5", n, rounds, msSince(t0));
+
+    // Kernel alone, jitter already in place.
+    t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+      scoreBatch(p, cols);
+      sink = sink + cols.score[r % n];
+    }
+    report(personality, "kernel_only", n, rounds, msSince(t0));
+  }
+
+  double maxRelErr = 0;
+  for (double x = -700.0; x <= 0.0; x += 0.0137) {
+    maxRelErr = std::max(maxRelErr, std::fabs(expNonPositive(x) - std::exp(x)) / std::exp(x));
+  }
+  std::cout << "{\"bench\":\"scoring\",\"case\":\"exp_accuracy\",\"max_rel_err\":" << maxRelErr << "}\n";
+  return 0;
+}
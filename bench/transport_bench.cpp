@@ -0,0 +1,192 @@
+// Loopback measurement of the OpenSkyClient transport.
+//
+// Starts a tiny HTTP/1.1 keep-alive server on 127.0.0.1 that serves a synthetic
+// departures payload (gzip-encoded when the client asks for it), then drives
+// OpenSkyClient against it and reports connection reuse and bytes on the wire.
+// The latency cases add server think time to compare one-at-a-time requests
+// with a batch.
+//
+//   cmake --build build --target transport_bench
+//   ./build/transport_bench [requests] [flights_per_response]
+
+#include "opensky_client.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static std::string syntheticDepartures(int n) {
+  std::ostringstream o;
+  o << "[";
+  for (int i = 0; i < n; i++) {
+    if (i) o << ",";
+    o << "{\"icao24\":\"a" << (10000 + i) << "\",\"firstSeen\":" << (1767340269 + i * 60)
+      << ",\"estDepartureAirport\":\"KATL\",\"lastSeen\":" << (1767347469 + i * 60)
+      << ",\"estArrivalAirport\":\"K" << (char)('A' + i % 26) << (char)('A' + i / 26 % 26)
+      << "X\",\"callsign\":\"DAL" << i << "  \",\"estDepartureAirportHorizDistance\":"
+      << (i % 900) << ",\"arrivalAirportCandidatesCount\":" << (i % 4) << "}";
+  }
+  o << "]";
+  return o.str();
+}
+
+static std::string gzip(const std::string& in) {
+  z_stream zs{};
+  deflateInit2(&zs, Z_BEST_SPEED, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+  std::string out(deflateBound(&zs, in.size()), '\0');
+  zs.next_in = (Bytef*)in.data();
+  zs.avail_in = (uInt)in.size();
+  zs.next_out = (Bytef*)out.data();
+  zs.avail_out = (uInt)out.size();
+  deflate(&zs, Z_FINISH);
+  out.resize(zs.total_out);
+  deflateEnd(&zs);
+  return out;
+}
+
+struct LoopbackServer {
+  int listenFd = -1;
+  int port = 0;
+  std::string plain, gzipped;
+  std::atomic<long> accepted{0};
+  std::atomic<int> delayMs{0}; // think time before each response
+
+  explicit LoopbackServer(const std::string& body) : plain(body), gzipped(gzip(body)) {
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(listenFd, (sockaddr*)&addr, sizeof(addr));
+    socklen_t len = sizeof(addr);
+    getsockname(listenFd, (sockaddr*)&addr, &len);
+    port = ntohs(addr.sin_port);
+    listen(listenFd, 64);
+    std::thread([this] { acceptLoop(); }).detach();
+  }
+
+  void acceptLoop() {
+    while (true) {
+      int fd = accept(listenFd, nullptr, nullptr);
+      if (fd < 0) return;
+      accepted++;
+      std::thread([this, fd] { serve(fd); }).detach();
+    }
+  }
+
+  void serve(int fd) {
+    std::string buf;
+    char chunk[4096];
+    while (true) {
+      size_t end;
+      while ((end = buf.find("\r\n\r\n")) == std::string::npos) {
+        ssize_t n = read(fd, chunk, sizeof(chunk));
+        if (n <= 0) {
+          close(fd);
+          return;
+        }
+        buf.append(chunk, (size_t)n);
+      }
+      std::string request = buf.substr(0, end);
+      buf.erase(0, end + 4);
+
+      if (delayMs > 0) std::this_thread::sleep_for(std::chrono::milliseconds(delayMs.load()));
+      bool wantsGzip = request.find("gzip") != std::string::npos;
+      const std::string& body = wantsGzip ? gzipped : plain;
+      std::ostringstream h;
+      h << "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+        << "Content-Length: " << body.size() << "\r\n";
+      if (wantsGzip) h << "Content-Encoding: gzip\r\n";
+      h << "\r\n";
+      std::string response = h.str() + body; // one write: avoids Nagle/delayed-ACK stalls
+      if (write(fd, response.data(), response.size()) < 0) {
+        close(fd);
+        return;
+      }
+    }
+  }
+};
+
+static void report(const char* name, const TransferStats& s, long accepted, double ms, int requests) {
+  std::cout << "{\"bench\":\"transport\",\"case\":\"" << name << "\""
+            << ",\"requests\":" << s.requests
+            << ",\"server_connections\":" << accepted
+            << ",\"reuse_rate\":" << (s.requests ? (double)s.reusedConnections / s.requests : 0.0)
+            << ",\"bytes_on_wire\":" << s.bytesOnWire
+            << ",\"bytes_decoded\":" << s.bytesDecoded
+            << ",\"ms_per_request\":" << ms / requests << "}\n";
+}
+
+int main(int argc, char** argv) {
+  int requests = argc > 1 ? std::atoi(argv[1]) : 200;
+  int flights = argc > 2 ? std::atoi(argv[2]) : 2000;
+
+  LoopbackServer server(syntheticDepartures(flights));
+  std::string base = "http://127.0.0.1:" + std::to_string(server.port) + "/api";
+
+  auto run = [&](const char* name, const std::string& encoding, bool freshClientPerRequest) {
+    long before = server.accepted;
+    TransferStats total;
+    auto t0 = std::chrono::steady_clock::now();
+
+    OpenSkyOptions opts;
+    opts.baseUrl = base;
+    opts.acceptEncoding = encoding;
+    auto shared = std::make_unique<OpenSkyClient>("", opts);
+
+    for (int i = 0; i < requests; i++) {
+      if (freshClientPerRequest) {
+        OpenSkyClient cold("", opts);
+        cold.getDepartures("KATL", 1767340269, 1767340269 + 36 * 3600);
+        TransferStats s = cold.stats();
+        total.requests += s.requests;
+        total.newConnections += s.newConnections;
+        total.reusedConnections += s.reusedConnections;
+        total.bytesOnWire += s.bytesOnWire;
+        total.bytesDecoded += s.bytesDecoded;
+      } else {
+        shared->getDepartures("KATL", 1767340269, 1767340269 + 36 * 3600);
+      }
+    }
+    if (!freshClientPerRequest) total = shared->stats();
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    report(name, total, server.accepted - before, ms, requests);
+  };
+
+  auto runBatch = [&](const char* name, int n) {
+    long before = server.accepted;
+    OpenSkyOptions opts;
+    opts.baseUrl = base;
+    OpenSkyClient client("", opts);
+    std::vector<DepartureRequest> batch(n, DepartureRequest{"KATL", 1767340269, 1767340269 + 36 * 3600});
+    long failed = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    client.getDeparturesBatch(batch, [&](size_t, std::vector<Flight>, std::exception_ptr error) {
+      if (error) failed++;
+    });
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    if (failed) std::cerr << name << ": " << failed << " requests failed\n";
+    report(name, client.stats(), server.accepted - before, ms, n);
+  };
+
+  run("cold_identity", "identity", true);
+  run("pooled_identity", "identity", false);
+  run("pooled_compressed", "", false);
+
+  server.delayMs = 20;
+  requests = std::min(requests, 48);
+  run("pooled_latency_20ms", "", false);
+  runBatch("batch_latency_20ms", requests);
+  return 0;
+}
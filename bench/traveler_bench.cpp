@@ -0,0 +1,315 @@
+// End-to-end benchmark suite: response parsing, candidate ranking, state
+// load/save (state.json and the fleet store), a full TravelerEngine::tick and
+// departure index queries, without touching the network.
+//
+// OpenSkyClient is replaced by StubOpenSky, which serves canned OpenSky
+// response bodies and parses them exactly as the client does while they
+// stream in. The bodies are synthetic by default; with --recorded they are
+// rebuilt per airport from a recording (OpenSky JSON/NDJSON, as for `sim`).
+//
+// One JSON object per line on stdout, so runs can be diffed across commits:
+//
+//   cmake --build build --target bench     # writes build/bench_results.ndjson
+//   ./build/traveler_bench [--recorded rec.ndjson] [--flights 2000] [--min-ms 300]
+
+#include "airport_db.h"
+#include "departure_index.h"
+#include "departure_parser.h"
+#include "scoring.h"
+#include "state_io.h"
+#include "state_store.h"
+#include "traveler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+static std::string argValue(int argc, char** argv, const std::string& name, const std::string& def = "") {
+  for (int i = 1; i + 1 < argc; i++) {
+    if (argv[i] == name) return argv[i + 1];
+  }
+  return def;
+}
+
+static std::string flightJson(const Flight& f) {
+  std::ostringstream o;
+  o << "{\"icao24\":\"" << f.icao24Hex() << "\",\"firstSeen\":" << f.firstSeen
+    << ",\"estDepartureAirport\":\"" << f.departure() << "\",\"lastSeen\":" << f.lastSeen
+    << ",\"estArrivalAirport\":\"" << f.arrival() << "\",\"callsign\":\"" << f.callsignStr()
+    << "\",\"estDepartureAirportHorizDistance\":512,\"arrivalAirportCandidatesCount\":2}";
+  return o.str();
+}
+
+// Airport -> OpenSky response body, as /flights/departure would return it.
+using Responses = std::map<std::string, std::string>;
+
+static Responses toResponses(const std::vector<Flight>& flights) {
+  std::map<std::string, std::vector<const Flight*>> byAirport;
+  for (const Flight& f : flights) byAirport[std::string(f.departure())].push_back(&f);
+  Responses out;
+  for (auto& [airport, list] : byAirport) {
+    std::sort(list.begin(), list.end(), [](const Flight* a, const Flight* b) { return a->firstSeen < b->firstSeen; });
+    std::string body = "[";
+    for (size_t i = 0; i < list.size(); i++) {
+      if (i) body += ",";
+      body += flightJson(*list[i]);
+    }
+    out[airport] = body + "]";
+  }
+  return out;
+}
+
+static std::vector<Flight> syntheticFlights(int perAirport) {
+  static const char* hubs[] = {"KATL", "KORD", "KDFW", "KDEN", "KLAX", "KJFK", "KSEA", "KMCO"};
+  std::mt19937 rng(11);
+  std::uniform_int_distribution<long> minutes(30, 14 * 60);
+  std::vector<Flight> out;
+  long t0 = 1767225600; // 2026-01-01
+  for (const char* from : hubs) {
+    for (int i = 0; i < perAirport; i++) {
+      Flight f;
+      f.setIcao24(std::to_string(100000 + i));
+      f.setCallsign("TST" + std::to_string(i));
+      f.estDepartureAirport = AirportDict::intern(from);
+      // Mostly hub-to-hub, with a long tail of small fields.
+      std::string to = i % 3 ? hubs[(size_t)(i * 7) % 8] : "K" + std::to_string(100 + i % 700);
+      if (to == from) to = "KCVG";
+      f.estArrivalAirport = AirportDict::intern(to);
+      f.firstSeen = t0 + (long)i * 86400 * 2 / perAirport;
+      f.lastSeen = f.firstSeen + minutes(rng) * 60;
+      out.push_back(f);
+    }
+  }
+  return out;
+}
+
+static std::vector<Flight> recordedFlights(const std::string& path) {
+  DepartureStreamParser parser;
+  std::ifstream in(path, std::ios::binary);
+  if (!in) throw std::runtime_error("Cannot read " + path);
+  char buf[1 << 16];
+  while (in.read(buf, sizeof(buf)) || in.gcount() > 0) parser.feed(buf, (size_t)in.gcount());
+  return std::move(parser.flights());
+}
+
+// Stands in for OpenSkyClient: same parser, same filtering, no network.
+class StubOpenSky : public DepartureSource {
+ public:
+  explicit StubOpenSky(const Responses& responses) : responses_(responses) {}
+
+  std::vector<Flight> getDepartures(const std::string& airportIcao, long beginUtc, long endUtc) override {
+    calls++;
+    auto it = responses_.find(airportIcao);
+    if (it == responses_.end()) return {}; // OpenSky's 404
+    DepartureStreamParser parser(airportIcao);
+    const std::string& body = it->second;
+    for (size_t off = 0; off < body.size(); off += kChunk) {
+      parser.feed(body.data() + off, std::min(kChunk, body.size() - off));
+    }
+    std::vector<Flight> out;
+    for (const Flight& f : parser.flights()) {
+      if (f.firstSeen >= beginUtc && f.firstSeen <= endUtc) out.push_back(f);
+    }
+    return out;
+  }
+
+  long calls = 0;
+
+ private:
+  static constexpr size_t kChunk = 16384; // a typical curl write-callback chunk
+  const Responses& responses_;
+};
+
+// Runs `op` until at least minMs have passed; returns nanoseconds per call.
+static double measure(double minMs, long& ops, const std::function<void()>& op) {
+  using Clock = std::chrono::steady_clock;
+  op(); // warm-up
+  ops = 0;
+  auto t0 = Clock::now();
+  double ms = 0;
+  long batch = 1;
+  while (ms < minMs) {
+    for (long i = 0; i < batch; i++) op();
+    ops += batch;
+    batch *= 2;
+    ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+  }
+  return ms * 1e6 / (double)ops;
+}
+
+static void report(const std::string& name, const std::string& input, long ops, double nsPerOp,
+                   const std::string& extra = "") {
+  std::cout << "{\"bench\":\"traveler\",\"case\":\"" << name << "\",\"input\":\"" << input << "\""
+            << ",\"ops\":" << ops << ",\"ns_per_op\":" << (long)nsPerOp << extra << "}\n";
+}
+
+int main(int argc, char** argv) {
+  std::string recorded = argValue(argc, argv, "--recorded");
+  int perAirport = std::atoi(argValue(argc, argv, "--flights", "2000").c_str());
+  double minMs = std::atof(argValue(argc, argv, "--min-ms", "300").c_str());
+
+  std::string input = recorded.empty() ? "synthetic" : "recorded";
+  std::vector<Flight> flights = recorded.empty() ? syntheticFlights(perAirport) : recordedFlights(recorded);
+  Responses responses = toResponses(flights);
+  if (responses.empty()) {
+    std::cerr << "No departures to benchmark with.\n";
+    return 1;
+  }
+
+  // The busiest airport's response drives the per-window cases.
+  auto busiest = std::max_element(responses.begin(), responses.end(), [](const auto& a, const auto& b) {
+    return a.second.size() < b.second.size();
+  });
+  const std::string& airport = busiest->first;
+  const std::string& body = busiest->second;
+  StubOpenSky stub(responses);
+  std::vector<Flight> window = stub.getDepartures(airport, 0, 1L << 40);
+  long ops = 0;
+
+  // 1. Parsing one response (what getDepartures costs besides the network).
+  double ns = measure(minMs, ops, [&] {
+    std::vector<Flight> got = stub.getDepartures(airport, 0, 1L << 40);
+    if (got.size() != window.size()) std::abort();
+  });
+  report("parse_response", input, ops, ns,
+         ",\"flights\":" + std::to_string(window.size()) + ",\"bytes\":" + std::to_string(body.size()) +
+         ",\"mb_per_s\":" + std::to_string((double)body.size() / ns * 1e3));
+
+  // 2. Ranking one window: gather inputs, batch score, top 5.
+  TravelerState st;
+  st.current_airport = airport;
+  for (size_t i = 0; i < window.size() && st.recent_airports.size() < 10; i += 97) {
+    st.recent_airports.push(window[i].estArrivalAirport);
+  }
+  for (const Flight& f : flights) st.visited_airports.insert(f.estArrivalAirport);
+  std::mt19937 rng(5);
+  ScoreColumns cols;
+  ns = measure(minMs, ops, [&] {
+    cols.resize(window.size());
+    for (size_t i = 0; i < window.size(); i++) {
+      const Flight& f = window[i];
+      cols.durationHours[i] = (double)std::max(0L, f.lastSeen - f.firstSeen) / 3600.0;
+      cols.distanceKm[i] = routeKm(f.estDepartureAirport, f.estArrivalAirport, std::max(0L, f.lastSeen - f.firstSeen));
+      cols.hub[i] = hubScore(f.estArrivalAirport);
+      cols.novelty[i] = st.recent_airports.contains(f.estArrivalAirport) ? kNoveltyRecent : kNoveltyNew;
+    }
+    fillJitter(rng, cols.jitter.data(), cols.size());
+    scoreBatch(Personality::Chaotic, cols);
+    if (topK(cols.score, 5).empty()) std::abort();
+  });
+  report("rank_candidates", input, ops, ns,
+         ",\"candidates\":" + std::to_string(window.size()) +
+         ",\"ns_per_candidate\":" + std::to_string(ns / (double)window.size()));
+
+  // 3. state.json round trip.
+  std::string statePath = (std::filesystem::temp_directory_path() / ("traveler_bench_" + std::to_string(::getpid()) + ".json")).string();
+  writeFile(statePath, toJson(st, 1234));
+  long hopCount = 0;
+  ns = measure(minMs, ops, [&] {
+    TravelerState loaded = loadState(statePath, hopCount);
+    if (toJson(loaded, hopCount).empty()) std::abort();
+  });
+  std::filesystem::remove(statePath);
+  report("state_load_save", input, ops, ns, ",\"visited\":" + std::to_string(st.visited_airports.count()));
+
+  // 4. A full tick: fetch through the stub (parse included), rank, hop.
+  TravelerEngine engine(stub);
+  engine.seed(3);
+  TravelerState start = st;
+  start.sim_time_utc = window.front().firstSeen - 3600;
+  long now = start.sim_time_utc + start.lag_seconds;
+  long hops = 0;
+  ns = measure(minMs, ops, [&] {
+    TravelerState s = start;
+    if (engine.tick(s, now).didHop) hops++;
+  });
+  report("tick", input, ops, ns, ",\"hop_rate\":" + std::to_string((double)hops / (double)(ops + 1)));
+
+  // 5. The same tick with the lookahead planner (depth 3, beam 3).
+  start.lookahead_depth = 3;
+  long calls0 = stub.calls;
+  ns = measure(minMs, ops, [&] {
+    TravelerState s = start;
+    engine.tick(s, now);
+  });
+  report("tick_lookahead", input, ops, ns,
+         ",\"fetches_per_tick\":" + std::to_string((double)(stub.calls - calls0) / (double)(ops + 1)));
+
+  // 6. The same flights as a departure index: open it, then answer the
+  // engine's 36-hour window from the mapping (compare parse_response).
+  std::filesystem::path dir = std::filesystem::temp_directory_path() / ("traveler_bench_idx_" + std::to_string(::getpid()));
+  std::string csvPath = dir.string() + ".csv";
+  {
+    std::ofstream csv(csvPath, std::ios::trunc);
+    csv << "icao24,callsign,estdepartureairport,estarrivalairport,firstseen,lastseen\n";
+    for (const Flight& f : flights) {
+      csv << f.icao24Hex() << "," << f.callsignStr() << "," << f.departure() << "," << f.arrival() << ","
+          << f.firstSeen << "," << f.lastSeen << "\n";
+    }
+  }
+  buildDepartureIndex({csvPath}, dir.string());
+  std::filesystem::remove(csvPath);
+  ns = measure(minMs, ops, [&] {
+    DepartureIndex index(dir.string());
+    if (index.flightCount() == 0) std::abort();
+  });
+  report("index_open", input, ops, ns);
+
+  DepartureIndex index(dir.string());
+  long from = window.front().firstSeen;
+  size_t found = 0;
+  ns = measure(minMs, ops, [&] {
+    found = index.window(airport, from, from + 36 * 3600).size();
+  });
+  report("index_window", input, ops, ns, ",\"flights\":" + std::to_string(found));
+  std::filesystem::remove_all(dir);
+
+  // 7. Fleet store saves once the fleet has seen more airports than the
+  // visited bitset holds: travelers must keep saving (and keep their current
+  // airport and recent ring), only the visits past the cap are dropped.
+  std::string storePath = (std::filesystem::temp_directory_path() / ("traveler_bench_" + std::to_string(::getpid()) + ".tstate")).string();
+  {
+    StateStore store(storePath);
+    auto code = [](size_t n) {
+      const char* digits = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+      return std::string("Z") + digits[n / 1296 % 36] + digits[n / 36 % 36] + digits[n % 36];
+    };
+    size_t next = 0;
+    auto traveler = [&](size_t airports) {
+      TravelerState s;
+      s.recent_airports.setCapacity(s.avoid_recent_n);
+      for (size_t i = 0; i < airports; i++) {
+        AirportId a = AirportDict::intern(code(next++));
+        s.visited_airports.insert(a);
+        s.recent_airports.push(a);
+      }
+      s.current_airport = code(next - 1);
+      return s;
+    };
+    for (size_t t = 0; next < StateStore::kMaxVisited + 1000; t++) {
+      store.save("fill" + std::to_string(t), traveler(500), 1);
+    }
+    TravelerState late = traveler(50);
+    ns = measure(minMs, ops, [&] { store.save("late", late, 2); });
+    TravelerState loaded;
+    long hops = 0;
+    if (!store.load("late", loaded, hops) || hops != 2 || loaded.current_airport != late.current_airport ||
+        loaded.recent_airports.inOrder() != late.recent_airports.inOrder()) {
+      std::abort();
+    }
+    report("store_save_past_visited_cap", input, ops, ns,
+           ",\"airports\":" + std::to_string(next) + ",\"visited_kept\":" + std::to_string(loaded.visited_airports.count()));
+  }
+  std::filesystem::remove(storePath);
+  return 0;
+}
@@ -0,0 +1,205 @@
+#include "daemon.h"
+#include "state_io.h"
+#include "tick_lease.h"
+#include "traveler.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+
+namespace {
+
+// How soon to try again when another process holds the tick lease, or a
+// tick could not read or write its files.
+constexpr long kRetryMs = 30 * 1000;
+
+int gSignalPipe[2] = {-1, -1};
+
+void onSignal(int sig) {
+  int savedErrno = errno;
+  unsigned char b = (unsigned char)sig;
+  (void)!::write(gSignalPipe[1], &b, 1);
+  errno = savedErrno;
+}
+
+// Installs the handlers for the daemon's lifetime and restores the old ones.
+class SignalPipe {
+ public:
+  SignalPipe() {
+    if (::pipe2(gSignalPipe, O_NONBLOCK | O_CLOEXEC) != 0) {
+      throw std::runtime_error(std::string("pipe2 failed: ") + std::strerror(errno));
+    }
+    struct sigaction sa {};
+    sa.sa_handler = onSignal;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    for (size_t i = 0; i < kSignals.size(); i++) sigaction(kSignals[i], &sa, &old_[i]);
+  }
+
+  ~SignalPipe() {
+    for (size_t i = 0; i < kSignals.size(); i++) sigaction(kSignals[i], &old_[i], nullptr);
+    ::close(gSignalPipe[0]);
+    ::close(gSignalPipe[1]);
+    gSignalPipe[0] = gSignalPipe[1] = -1;
+  }
+
+  // Sleeps up to `timeoutMs`; returns the signal that woke us, or 0 on timeout.
+  // Several pending signals: a stop signal wins over SIGHUP.
+  int wait(long timeoutMs) {
+    pollfd pfd{gSignalPipe[0], POLLIN, 0};
+    int rc = ::poll(&pfd, 1, (int)std::clamp(timeoutMs, 0L, (long)INT32_MAX));
+    if (rc == 0) return 0;
+    // Readable, or EINTR because our own handler just ran: drain either way.
+    int got = 0;
+    unsigned char buf[16];
+    ssize_t n;
+    while ((n = ::read(gSignalPipe[0], buf, sizeof(buf))) > 0) {
+      for (ssize_t i = 0; i < n; i++) {
+        if (buf[i] == SIGTERM || buf[i] == SIGINT || got == 0) got = buf[i];
+      }
+    }
+    return got;
+  }
+
+ private:
+  static constexpr std::array<int, 3> kSignals{SIGTERM, SIGINT, SIGHUP};
+  struct sigaction old_[3] {};
+};
+
+long nowMs() {
+  using namespace std::chrono;
+  return (long)duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+// One tick if due, under the state's lease. False if the lease is taken.
+// Throws on I/O errors, with `st` and `hopCount` as they were.
+bool tickOnce(TravelerEngine& engine, const DaemonOptions& options, long now, TravelerState& st, long& hopCount,
+              DaemonReport& report) {
+  if (!TravelerEngine::isDue(st, now)) return true;
+  TickLease lease(options.statePath + ".lock", 0, [&options] { return stateFence(options.statePath); });
+  if (!lease.held()) {
+    std::cout << "DAEMON: another tick is running (" << lease.describeHolder() << "), retrying in "
+              << kRetryMs / 1000 << "s" << std::endl;
+    return false;
+  }
+  if (!stateIsCurrent(options.statePath, st, lease.token())) {
+    // Another process ticked since we last wrote; carry on from its state.
+    st = loadState(options.statePath, hopCount);
+    std::cout << "DAEMON: " << options.statePath << " was updated elsewhere, reloaded"
+              << " next_event_utc=" << st.next_event_utc << std::endl;
+    if (!TravelerEngine::isDue(st, now)) return true;
+  }
+
+  if (options.beforeTick) {
+    try {
+      options.beforeTick();
+    } catch (const std::exception& e) {
+      std::cout << "DAEMON: before-tick hook failed: " << e.what() << std::endl;
+    }
+  }
+
+  TravelerState before = st;
+  long beforeHops = hopCount;
+  auto deadline = options.tickBudgetMs > 0
+                      ? std::chrono::steady_clock::now() + std::chrono::milliseconds(options.tickBudgetMs)
+                      : std::chrono::steady_clock::time_point::max();
+  HopResult hop = engine.tick(st, now, deadline);
+  report.ticks++;
+  auto writeStart = std::chrono::steady_clock::now();
+  if (hop.didHop) hopCount += 1;
+  // State first: if it cannot be written, nothing is logged and the tick is
+  // redone on the next wakeup rather than logged twice.
+  try {
+    commitState(options.statePath, st, hopCount, lease.token());
+  } catch (...) {
+    st = before;
+    hopCount = beforeHops;
+    throw;
+  }
+  if (hop.didHop) {
+    report.hops++;
+    try {
+      writeHopOutputs(options.outputDir, now, before, hop, st, hopCount);
+    } catch (const std::exception& e) {
+      std::cout << "DAEMON: hop " << hopCount << " saved but not logged: " << e.what() << std::endl;
+    }
+  }
+  hop.metrics.stateWriteMs =
+      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - writeStart).count();
+  try {
+    appendTickMetrics((std::filesystem::path(options.outputDir) / "tick_metrics.ndjson").string(), now,
+                      before.current_airport, hop);
+  } catch (const std::exception& e) {
+    std::cout << "DAEMON: tick metrics not written: " << e.what() << std::endl;
+  }
+  std::cout << describeTick(before, hop, st) << std::endl;
+  return true;
+}
+
+} // namespace
+
+DaemonReport runDaemon(DepartureSource& source, const DaemonOptions& options) {
+  DaemonReport report;
+  SignalPipe signals;
+
+  long hopCount = 0;
+  TravelerState st = loadState(options.statePath, hopCount);
+  TravelerEngine engine(source, options.routes);
+
+  std::cout << "DAEMON: state=" << options.statePath
+            << " airport=" << st.current_airport
+            << " next_event_utc=" << st.next_event_utc << std::endl;
+
+  while (true) {
+    long now = nowMs() / 1000;
+    bool retrySoon = false; // lease busy or I/O failed: try again in kRetryMs
+    try {
+      retrySoon = !tickOnce(engine, options, now, st, hopCount, report);
+    } catch (const std::exception& e) {
+      // Nothing of this tick was saved; the next wakeup starts it over.
+      retrySoon = true;
+      std::cout << "DAEMON: tick failed, retrying in " << kRetryMs / 1000 << "s: " << e.what() << std::endl;
+    }
+
+    // tick() always moves next_event_utc forward; the cap only guards against
+    // wall-clock jumps (suspend, NTP step) while we sleep on a monotonic timer.
+    long waitMs = st.next_event_utc * 1000 - nowMs();
+    waitMs = std::clamp(waitMs, 0L, options.maxSleepSeconds * 1000);
+    if (retrySoon) waitMs = kRetryMs;
+
+    int sig = signals.wait(waitMs);
+    report.wakeups++;
+    if (sig == SIGTERM || sig == SIGINT) {
+      report.stopSignal = sig;
+      break;
+    }
+    if (sig == SIGHUP) {
+      try {
+        st = loadState(options.statePath, hopCount);
+        std::cout << "DAEMON: reloaded " << options.statePath
+                  << " next_event_utc=" << st.next_event_utc << std::endl;
+      } catch (const std::exception& e) {
+        std::cout << "DAEMON: reload failed, keeping the current state: " << e.what() << std::endl;
+      }
+    }
+  }
+
+  // Every tick was already checkpointed; nothing is lost by stopping here.
+  std::cout << "DAEMON: stopping on signal " << report.stopSignal
+            << " ticks=" << report.ticks
+            << " hops=" << report.hops
+            << " wakeups=" << report.wakeups << std::endl;
+  return report;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "departure_source.h"
+
+#include <functional>
+#include <string>
+
+class RouteGraph;
+
+// Long-running mode: one process keeps the engine, client connections and
+// cache alive, and sleeps until the traveler's next_event_utc instead of being
+// restarted every few minutes just to find it is "Not time yet".
+//
+// The sleep is a poll() on a self-pipe fed by the signal handlers, so SIGTERM /
+// SIGINT end it immediately and SIGHUP reloads the state file (after an edit).
+// State is checkpointed atomically after every tick; a signal that arrives
+// mid-tick is handled once the tick's checkpoint is written. Each tick takes
+// the state's lease (tick_lease.h) first, so a cron run or a second daemon on
+// the same state never hops alongside it; if another process ticked in the
+// meantime, its state is picked up instead. A tick whose files cannot be read
+// or written (or whose lease cannot be taken) is logged and redone 30s later;
+// the daemon keeps running.
+
+struct DaemonOptions {
+  std::string statePath = "state.json";
+  std::string outputDir = "";          // trip log + latest post files ("" = cwd)
+  long maxSleepSeconds = 15 * 60;      // re-read the wall clock at least this often
+  std::function<void()> beforeTick;    // e.g. refresh the API token; may be empty
+  const RouteGraph* routes = nullptr;  // dead-end prediction for scoring; optional
+  long tickBudgetMs = 90 * 1000;       // deadline for each tick's fetches; 0 = none
+};
+
+struct DaemonReport {
+  long ticks = 0;
+  long hops = 0;
+  long wakeups = 0;
+  int stopSignal = 0;
+};
+
+// Runs until SIGTERM or SIGINT.
+DaemonReport runDaemon(DepartureSource& source, const DaemonOptions& options);
@@ -0,0 +1,328 @@
+#include "departure_cache.h"
+#include "departure_parser.h"
+
+#include <algorithm>
+#include <ctime>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <tuple>
+
+namespace fs = std::filesystem;
+
+static constexpr long kDay = 86400;
+
+static long dayIndex(long t) { return t / kDay; }
+
+// ---- partition file helpers: a header line, then one OpenSky-shaped object per flight ----
+static std::vector<std::pair<long, long>> extractCovered(const std::string& header) {
+  std::vector<std::pair<long, long>> out;
+  size_t p = header.find("\"covered\":");
+  if (p == std::string::npos) return out;
+  p = header.find('[', p);
+  if (p == std::string::npos) return out;
+  while (true) {
+    size_t a = header.find('[', p + 1);
+    if (a == std::string::npos) break;
+    size_t b = header.find(']', a);
+    if (b == std::string::npos) break;
+    std::string pair = header.substr(a + 1, b - a - 1);
+    size_t comma = pair.find(',');
+    if (comma != std::string::npos) {
+      try {
+        out.emplace_back(std::stol(pair.substr(0, comma)), std::stol(pair.substr(comma + 1)));
+      } catch (...) {
+      }
+    }
+    p = b;
+  }
+  return out;
+}
+
+static void addCoverage(std::vector<std::pair<long, long>>& covered, long b, long e) {
+  if (e < b) return;
+  covered.emplace_back(b, e);
+  std::sort(covered.begin(), covered.end());
+  std::vector<std::pair<long, long>> merged;
+  for (const auto& r : covered) {
+    if (!merged.empty() && r.first <= merged.back().second + 1) {
+      merged.back().second = std::max(merged.back().second, r.second);
+    } else {
+      merged.push_back(r);
+    }
+  }
+  covered.swap(merged);
+}
+
+// Sub-ranges of [b,e] not contained in `covered`.
+static std::vector<std::pair<long, long>> gaps(const std::vector<std::pair<long, long>>& covered,
+                                               long b, long e) {
+  std::vector<std::pair<long, long>> out;
+  long cursor = b;
+  for (const auto& r : covered) {
+    if (r.second < cursor) continue;
+    if (r.first > e) break;
+    if (r.first > cursor) out.emplace_back(cursor, r.first - 1);
+    cursor = std::max(cursor, r.second + 1);
+    if (cursor > e) break;
+  }
+  if (cursor <= e) out.emplace_back(cursor, e);
+  return out;
+}
+
+// Sort by firstSeen and drop re-fetched duplicates; the most recently appended copy wins.
+static void dedupe(std::vector<Flight>& flights) {
+  auto less = [](const Flight& a, const Flight& b) {
+    if (a.firstSeen != b.firstSeen) return a.firstSeen < b.firstSeen;
+    return a.icao24 < b.icao24;
+  };
+  std::stable_sort(flights.begin(), flights.end(), less);
+  std::vector<Flight> out;
+  out.reserve(flights.size());
+  for (auto& f : flights) {
+    if (!out.empty() && !less(out.back(), f)) out.back() = std::move(f);
+    else out.push_back(std::move(f));
+  }
+  flights.swap(out);
+}
+
+DepartureCache::DepartureCache(DepartureSource& upstream, std::string dir, long publishLagSeconds)
+  : upstream_(upstream), dir_(std::move(dir)), publishLagSeconds_(publishLagSeconds) {}
+
+long DepartureCache::firstOpenDay() const {
+  return dayIndex((long)std::time(nullptr) - publishLagSeconds_);
+}
+
+std::string DepartureCache::partitionPath(const std::string& airport, long day) const {
+  return (fs::path(dir_) / airport / (std::to_string(day) + ".ndjson")).string();
+}
+
+void DepartureCache::load(const std::string& airport, long day, Partition& p) const {
+  std::ifstream in(partitionPath(airport, day));
+  if (!in) return;
+
+  std::string line;
+  if (!std::getline(in, line)) return;
+  p.covered = extractCovered(line);
+
+  DepartureStreamParser parser(airport);
+  char buf[64 * 1024];
+  while (in.read(buf, sizeof(buf)) || in.gcount() > 0) parser.feed(buf, (size_t)in.gcount());
+  p.flights = std::move(parser.flights());
+}
+
+void DepartureCache::save(const std::string& airport, long day, const Partition& p) const {
+  fs::path path = partitionPath(airport, day);
+  std::error_code ec;
+  fs::create_directories(path.parent_path(), ec);
+
+  std::ostringstream o;
+  o << "{\"airport\":\"" << airport << "\",\"day\":" << day << ",\"covered\":[";
+  for (size_t i = 0; i < p.covered.size(); i++) {
+    o << "[" << p.covered[i].first << "," << p.covered[i].second << "]";
+    if (i + 1 < p.covered.size()) o << ",";
+  }
+  o << "]}\n";
+  for (const auto& f : p.flights) {
+    o << "{\"icao24\":\"" << f.icao24Hex() << "\","
+      << "\"callsign\":\"" << f.callsignStr() << "\","
+      << "\"estDepartureAirport\":\"" << f.departure() << "\","
+      << "\"estArrivalAirport\":\"" << f.arrival() << "\","
+      << "\"firstSeen\":" << f.firstSeen << ","
+      << "\"lastSeen\":" << f.lastSeen << "}\n";
+  }
+
+  // Write-then-rename so a crash never leaves a half-written partition behind.
+  fs::path tmp = path;
+  tmp += ".tmp";
+  {
+    std::ofstream out(tmp, std::ios::trunc);
+    out << o.str();
+    if (!out) return;
+  }
+  fs::rename(tmp, path, ec);
+}
+
+DepartureCache::Partition& DepartureCache::partition(const std::string& airport, long day) {
+  Key key{airport, day};
+  auto it = partitions_.find(key);
+  if (it != partitions_.end()) {
+    it->second.lastUsed = ++useClock_;
+    return it->second;
+  }
+  Partition& p = partitions_[key];
+  load(airport, day, p);
+  p.lastUsed = ++useClock_;
+  return p;
+}
+
+void DepartureCache::trimLocked() {
+  if (partitions_.size() <= kMaxPartitions) return;
+  std::vector<std::pair<uint64_t, std::map<Key, Partition>::iterator>> clean;
+  for (auto it = partitions_.begin(); it != partitions_.end(); ++it) {
+    if (!it->second.dirty) clean.emplace_back(it->second.lastUsed, it);
+  }
+  size_t excess = partitions_.size() - kMaxPartitions;
+  if (clean.size() > excess) {
+    std::nth_element(clean.begin(), clean.begin() + (long)excess, clean.end(),
+                     [](const auto& a, const auto& b) { return a.first < b.first; });
+    clean.resize(excess);
+  }
+  for (auto& [_, it] : clean) partitions_.erase(it);
+}
+
+std::vector<DepartureCache::Range> DepartureCache::missing(const std::string& airport, long beginUtc, long endUtc) {
+  std::vector<Range> out;
+  std::lock_guard<std::mutex> lock(mu_);
+  for (long d = dayIndex(beginUtc); d <= dayIndex(endUtc); d++) {
+    long b = std::max(beginUtc, d * kDay);
+    long e = std::min(endUtc, (d + 1) * kDay - 1);
+    for (const auto& g : gaps(partition(airport, d).covered, b, e)) {
+      if (!out.empty() && out.back().second + 1 == g.first) {
+        out.back().second = g.second;
+      } else {
+        out.push_back(g);
+      }
+    }
+  }
+  trimLocked();
+  return out;
+}
+
+std::vector<Flight> DepartureCache::merge(const std::string& airport, long beginUtc, long endUtc, Fetched& fetched,
+                                          long openDay, std::exception_ptr error) {
+  std::vector<Flight> out;
+  std::lock_guard<std::mutex> lock(mu_);
+  std::map<long, bool> touched;
+
+  for (auto& [range, flights] : fetched) {
+    for (auto& f : flights) {
+      long d = dayIndex(f.firstSeen);
+      Partition& p = partition(airport, d);
+      p.flights.push_back(std::move(f));
+      p.dirty = true;
+      touched[d] = true;
+    }
+
+    // A day not yet published in full may still gain flights: keep them, but
+    // leave the range uncovered so it is asked for again.
+    for (long d = dayIndex(range.first); d <= dayIndex(range.second) && d < openDay; d++) {
+      long b = std::max(range.first, d * kDay);
+      long e = std::min(range.second, (d + 1) * kDay - 1);
+      Partition& p = partition(airport, d);
+      addCoverage(p.covered, b, e);
+      p.dirty = true;
+      touched[d] = true;
+    }
+  }
+
+  for (const auto& [d, _] : touched) {
+    Partition& p = partition(airport, d);
+    if (!p.dirty) continue;
+    dedupe(p.flights);
+    save(airport, d, p);
+    p.dirty = false;
+  }
+
+  for (long d = dayIndex(beginUtc); d <= dayIndex(endUtc); d++) {
+    for (const auto& f : partition(airport, d).flights) {
+      if (f.firstSeen >= beginUtc && f.firstSeen <= endUtc) out.push_back(f);
+    }
+  }
+  trimLocked();
+
+  // Whatever did arrive is kept; the caller still sees the upstream failure,
+  // along with what is known of the window if it ran out of time.
+  if (error) {
+    try {
+      std::rethrow_exception(error);
+    } catch (const DeadlineExceeded& e) {
+      if (!out.empty()) throw PartialDepartures(e.what(), std::move(out));
+      throw;
+    }
+  }
+  return out;
+}
+
+std::vector<Flight> DepartureCache::getDepartures(const std::string& airportIcao,
+                                                  long beginUtc,
+                                                  long endUtc) {
+  // 1) Work out which parts of the window are missing.
+  std::vector<Range> gapsToFetch = missing(airportIcao, beginUtc, endUtc);
+
+  // 2) Fetch only the delta. The lock is not held while on the network.
+  Fetched fetched;
+  long openDay = firstOpenDay();
+  std::exception_ptr error;
+  for (const auto& g : gapsToFetch) {
+    try {
+      fetched.emplace_back(g, upstream_.getDepartures(airportIcao, g.first, g.second));
+    } catch (...) {
+      error = std::current_exception();
+      break;
+    }
+  }
+
+  // 3) Merge into partitions, persist, and answer from the partitions.
+  return merge(airportIcao, beginUtc, endUtc, fetched, openDay, error);
+}
+
+void DepartureCache::getDeparturesBatch(const std::vector<DepartureRequest>& requests,
+                                        const DepartureCallback& done) {
+  struct Pending {
+    size_t outstanding = 0;
+    Fetched fetched;
+    std::exception_ptr error;
+  };
+  std::vector<Pending> pending(requests.size());
+  long openDay = firstOpenDay();
+
+  auto answer = [&](size_t i) {
+    const DepartureRequest& r = requests[i];
+    std::vector<Flight> flights;
+    std::exception_ptr error;
+    try {
+      flights = merge(r.airport, r.beginUtc, r.endUtc, pending[i].fetched, openDay, pending[i].error);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    done(i, std::move(flights), error);
+  };
+
+  std::vector<DepartureRequest> upstream;
+  std::vector<std::vector<size_t>> waiting; // upstream request -> requests that need it
+  std::map<std::tuple<std::string, long, long>, size_t> seen;
+  for (size_t i = 0; i < requests.size(); i++) {
+    const DepartureRequest& r = requests[i];
+    std::vector<Range> gapsToFetch = missing(r.airport, r.beginUtc, r.endUtc);
+    if (gapsToFetch.empty()) {
+      answer(i);
+      continue;
+    }
+    pending[i].outstanding = gapsToFetch.size();
+    for (const auto& g : gapsToFetch) {
+      auto [it, inserted] = seen.try_emplace({r.airport, g.first, g.second}, upstream.size());
+      if (inserted) {
+        upstream.push_back(DepartureRequest{r.airport, g.first, g.second});
+        waiting.emplace_back();
+      }
+      waiting[it->second].push_back(i);
+    }
+  }
+  if (upstream.empty()) return;
+
+  upstream_.getDeparturesBatch(upstream, [&](size_t k, std::vector<Flight> flights, std::exception_ptr error) {
+    Range range{upstream[k].beginUtc, upstream[k].endUtc};
+    for (size_t n = 0; n < waiting[k].size(); n++) {
+      Pending& p = pending[waiting[k][n]];
+      if (error) {
+        if (!p.error) p.error = error;
+      } else {
+        // The last requester can have the flights; merge() consumes them.
+        p.fetched.emplace_back(range, n + 1 == waiting[k].size() ? std::move(flights) : flights);
+      }
+      if (--p.outstanding == 0) answer(waiting[k][n]);
+    }
+  });
+}
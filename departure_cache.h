@@ -0,0 +1,76 @@
+#pragma once
+#include "departure_source.h"
+
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Read-through, on-disk departure cache.
+//
+// Departures are stored per (airport ICAO, UTC day) partition -- the same day
+// split OpenSky uses -- as <dir>/<ICAO>/<day>.ndjson. Each partition remembers
+// which sub-ranges of its day have already been fetched, so a request only sends
+// the uncovered part of its window upstream. OpenSky publishes a day's
+// flights in a nightly batch, so coverage is only recorded for UTC days that
+// ended at least `publishLagSeconds` before the fetch: anything fetched for a
+// more recent day is stored but asked for again next time, while settled days
+// are served from disk forever. A fetch cut short by the deadline still
+// answers with the cached part of the window, as PartialDepartures.
+//
+// At most kMaxPartitions are kept in memory; the least recently used ones
+// (already on disk) are dropped beyond that and re-read when needed.
+class DepartureCache : public DepartureSource {
+ public:
+  static constexpr size_t kMaxPartitions = 512;
+
+  DepartureCache(DepartureSource& upstream, std::string dir, long publishLagSeconds = kPublishLagSeconds);
+
+  std::vector<Flight> getDepartures(const std::string& airportIcao,
+                                    long beginUtc,
+                                    long endUtc) override;
+
+  // Cached requests are answered at once; the missing pieces of the others go
+  // upstream as one batch (identical gaps fetched once).
+  void getDeparturesBatch(const std::vector<DepartureRequest>& requests, const DepartureCallback& done) override;
+
+ private:
+  struct Partition {
+    std::vector<std::pair<long, long>> covered; // sorted, merged, inclusive
+    std::vector<Flight> flights;                // sorted by firstSeen
+    bool dirty = false;
+    uint64_t lastUsed = 0;
+  };
+  using Key = std::pair<std::string, long>; // (airport, UTC day index)
+  using Range = std::pair<long, long>;
+  using Fetched = std::vector<std::pair<Range, std::vector<Flight>>>;
+
+  DepartureSource& upstream_;
+  std::string dir_;
+  long publishLagSeconds_;
+  std::mutex mu_;
+  std::map<Key, Partition> partitions_;
+  uint64_t useClock_ = 0;
+
+  Partition& partition(const std::string& airport, long day);
+  std::string partitionPath(const std::string& airport, long day) const;
+  void load(const std::string& airport, long day, Partition& p) const;
+  void save(const std::string& airport, long day, const Partition& p) const;
+  // Drops least recently used clean partitions down to kMaxPartitions. Callers
+  // must not hold Partition references across it.
+  void trimLocked();
+  // Days before this index have been published in full.
+  long firstOpenDay() const;
+
+  // Parts of the window not covered yet (merged across day boundaries).
+  std::vector<Range> missing(const std::string& airport, long beginUtc, long endUtc);
+  // Stores what was fetched (coverage only for days before `openDay`), then
+  // answers the window from the partitions;
+  // rethrows `error` once whatever did arrive is kept (a DeadlineExceeded as
+  // PartialDepartures when some of the window is known).
+  std::vector<Flight> merge(const std::string& airport, long beginUtc, long endUtc, Fetched& fetched,
+                            long openDay, std::exception_ptr error);
+};
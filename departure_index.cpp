@@ -0,0 +1,520 @@
+#include "departure_index.h"
+#include "state_io.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char kMagic[8] = {'I', 'T', 'D', 'E', 'P', 'I', 'X', '1'};
+constexpr uint32_t kVersion = 1;
+constexpr size_t kCodeBytes = 8;
+constexpr const char* kExtension = ".depidx";
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t airportCount;
+  uint64_t flightCount;
+  int64_t beginUtc;    // the month this partition covers
+  int64_t endUtc;
+  int64_t firstSeen;   // earliest and latest departure inside it
+  int64_t lastSeen;
+  uint64_t reserved;
+};
+static_assert(sizeof(Header) == 64, "header is one cache line");
+
+struct Layout {
+  size_t codes, offsets, flights, total;
+};
+
+size_t align8(size_t n) { return (n + 7) & ~size_t(7); }
+
+Layout layout(size_t airports, size_t flights) {
+  Layout l{};
+  l.codes = sizeof(Header);
+  l.offsets = align8(l.codes + airports * kCodeBytes);
+  l.flights = align8(l.offsets + (airports + 1) * sizeof(uint64_t));
+  l.total = l.flights + flights * sizeof(IndexedFlight);
+  return l;
+}
+
+std::string_view codeAt(const char* codes, size_t i) {
+  const char* c = codes + i * kCodeBytes;
+  return std::string_view(c, strnlen(c, kCodeBytes));
+}
+
+// A flight between parsing and the partition file; spilled to disk as is.
+struct Row {
+  int64_t firstSeen = 0;
+  int64_t lastSeen = 0;
+  uint32_t icao24 = 0;
+  char callsign[8] = {};
+  char departure[8] = {};
+  char arrival[8] = {};
+
+  std::string_view dep() const { return std::string_view(departure, strnlen(departure, kCodeBytes)); }
+  std::string_view arr() const { return std::string_view(arrival, strnlen(arrival, kCodeBytes)); }
+};
+
+// [begin, end) of the UTC month holding t.
+void monthOf(long t, long& begin, long& end) {
+  time_t tt = (time_t)t;
+  std::tm tm{};
+  gmtime_r(&tt, &tm);
+  tm.tm_mday = 1;
+  tm.tm_hour = tm.tm_min = tm.tm_sec = 0;
+  begin = (long)timegm(&tm);
+  tm.tm_mon++;
+  end = (long)timegm(&tm);
+}
+
+std::string monthName(long begin) {
+  time_t tt = (time_t)begin;
+  std::tm tm{};
+  gmtime_r(&tt, &tm);
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%04d-%02d", tm.tm_year + 1900, tm.tm_mon + 1);
+  return buf;
+}
+
+// Unix seconds, or "YYYY-MM-DD HH:MM:SS" (a 'T' separator and a trailing
+// "+00:00" or "Z" are fine). 0 if neither.
+long parseTime(const std::string& s) {
+  if (s.empty()) return 0;
+  char* end = nullptr;
+  double v = std::strtod(s.c_str(), &end);
+  if (*end == '\0') return (long)v;
+  std::tm tm{};
+  if (std::sscanf(s.c_str(), "%d-%d-%d%*c%d:%d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+                  &tm.tm_hour, &tm.tm_min, &tm.tm_sec) < 3) {
+    return 0;
+  }
+  tm.tm_year -= 1900;
+  tm.tm_mon -= 1;
+  return (long)timegm(&tm);
+}
+
+// Splits one CSV line; double-quoted fields may contain commas and "".
+void splitCsv(const std::string& line, std::vector<std::string>& fields) {
+  fields.clear();
+  std::string cur;
+  bool quoted = false;
+  for (size_t i = 0; i < line.size(); i++) {
+    char c = line[i];
+    if (quoted) {
+      if (c == '"' && i + 1 < line.size() && line[i + 1] == '"') cur += line[++i];
+      else if (c == '"') quoted = false;
+      else cur += c;
+    } else if (c == '"') {
+      quoted = true;
+    } else if (c == ',') {
+      fields.push_back(std::move(cur));
+      cur.clear();
+    } else if (c != '\r') {
+      cur += c;
+    }
+  }
+  fields.push_back(std::move(cur));
+}
+
+Flight toFlight(const IndexedFlight& f, AirportId departure, AirportId arrival) {
+  Flight flight;
+  flight.icao24 = f.icao24;
+  std::memcpy(flight.callsign, f.callsign, sizeof(flight.callsign));
+  flight.estDepartureAirport = departure;
+  flight.estArrivalAirport = arrival;
+  flight.firstSeen = (long)f.firstSeen;
+  flight.lastSeen = (long)f.lastSeen;
+  return flight;
+}
+
+// Codes and callsigns come space-padded in some dumps; stored NUL-padded.
+void copyCode(char (&dst)[8], const std::string& src) {
+  size_t first = src.find_first_not_of(' ');
+  size_t last = src.find_last_not_of(' ');
+  std::memset(dst, 0, sizeof(dst));
+  if (first == std::string::npos) return;
+  std::memcpy(dst, src.data() + first, std::min(last + 1 - first, sizeof(dst)));
+}
+
+} // namespace
+
+struct DepartureIndex::Partition {
+  std::string path;
+  void* base = nullptr;
+  size_t size = 0;
+  Header header{};
+  const char* codes = nullptr;
+  const uint64_t* offsets = nullptr;
+  const IndexedFlight* flights = nullptr;
+
+  std::once_flag internOnce;
+  std::vector<AirportId> ids; // by code index, filled on first query
+
+  explicit Partition(const std::string& file);
+  ~Partition() {
+    if (base) ::munmap(base, size);
+  }
+
+  // Code index, or -1.
+  long airport(std::string_view icao) const {
+    size_t lo = 0, hi = header.airportCount;
+    while (lo < hi) {
+      size_t mid = (lo + hi) / 2;
+      if (codeAt(codes, mid) < icao) lo = mid + 1;
+      else hi = mid;
+    }
+    return lo < header.airportCount && codeAt(codes, lo) == icao ? (long)lo : -1;
+  }
+
+  Run run(long airport, long beginUtc, long endUtc) const {
+    Run r;
+    r.codes = codes;
+    const IndexedFlight* first = flights + offsets[airport];
+    const IndexedFlight* last = flights + offsets[airport + 1];
+    r.begin = std::lower_bound(first, last, beginUtc,
+                               [](const IndexedFlight& f, long t) { return f.firstSeen < t; });
+    r.end = std::upper_bound(r.begin, last, endUtc,
+                             [](long t, const IndexedFlight& f) { return t < f.firstSeen; });
+    return r;
+  }
+
+  const std::vector<AirportId>& airportIds() {
+    std::call_once(internOnce, [this] {
+      ids.resize(header.airportCount);
+      for (size_t i = 0; i < ids.size(); i++) ids[i] = AirportDict::intern(codeAt(codes, i));
+    });
+    return ids;
+  }
+};
+
+DepartureIndex::Partition::Partition(const std::string& file) : path(file) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) throw std::runtime_error("Cannot open departure index " + path + ": " + std::strerror(errno));
+  struct stat st {};
+  if (::fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(Header)) {
+    ::close(fd);
+    throw std::runtime_error("Not a departure index partition: " + path);
+  }
+  size = (size_t)st.st_size;
+  void* p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED) throw std::runtime_error("Cannot map departure index " + path + ": " + std::strerror(errno));
+  base = p;
+
+  const char* b = static_cast<const char*>(base);
+  std::memcpy(&header, b, sizeof(header));
+  Layout l = layout(header.airportCount, header.flightCount);
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion || l.total > size) {
+    ::munmap(base, size);
+    base = nullptr;
+    throw std::runtime_error("Not a departure index partition (or wrong version): " + path);
+  }
+  codes = b + l.codes;
+  offsets = reinterpret_cast<const uint64_t*>(b + l.offsets);
+  flights = reinterpret_cast<const IndexedFlight*>(b + l.flights);
+  if (offsets[header.airportCount] != header.flightCount) {
+    ::munmap(base, size);
+    base = nullptr;
+    throw std::runtime_error("Corrupt departure index partition: " + path);
+  }
+}
+
+namespace {
+
+// Sorts, dedupes and writes one month; returns the flights written.
+size_t writePartition(const std::string& path, long beginUtc, long endUtc, std::vector<Row>& rows) {
+  std::stable_sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) {
+    int c = std::memcmp(a.departure, b.departure, kCodeBytes);
+    if (c != 0) return c < 0;
+    if (a.firstSeen != b.firstSeen) return a.firstSeen < b.firstSeen;
+    return a.icao24 < b.icao24;
+  });
+  // Overlapping dumps repeat flights; the copy already in the index wins.
+  rows.erase(std::unique(rows.begin(), rows.end(), [](const Row& a, const Row& b) {
+    return a.firstSeen == b.firstSeen && a.icao24 == b.icao24 &&
+           std::memcmp(a.departure, b.departure, kCodeBytes) == 0;
+  }), rows.end());
+
+  std::map<std::string_view, uint32_t> index;
+  for (const Row& r : rows) {
+    index.emplace(r.dep(), 0);
+    index.emplace(r.arr(), 0);
+  }
+  uint32_t next = 0;
+  for (auto& [code, i] : index) i = next++;
+  size_t airports = index.size();
+
+  Layout l = layout(airports, rows.size());
+  std::string buf(l.total, '\0');
+  char* base = buf.data();
+
+  Header h{};
+  std::memcpy(h.magic, kMagic, sizeof(kMagic));
+  h.version = kVersion;
+  h.airportCount = (uint32_t)airports;
+  h.flightCount = rows.size();
+  h.beginUtc = beginUtc;
+  h.endUtc = endUtc;
+  for (const Row& r : rows) {
+    if (h.firstSeen == 0 || r.firstSeen < h.firstSeen) h.firstSeen = r.firstSeen;
+    h.lastSeen = std::max(h.lastSeen, r.firstSeen);
+  }
+  std::memcpy(base, &h, sizeof(h));
+
+  for (const auto& [code, i] : index) std::memcpy(base + l.codes + (size_t)i * kCodeBytes, code.data(), code.size());
+
+  // Rows are grouped by departure code, in code order: one pass fills the offsets.
+  uint64_t* offsets = reinterpret_cast<uint64_t*>(base + l.offsets);
+  IndexedFlight* flights = reinterpret_cast<IndexedFlight*>(base + l.flights);
+  size_t a = 0;
+  for (size_t k = 0; k < rows.size(); k++) {
+    uint32_t dep = index[rows[k].dep()];
+    while (a <= dep) offsets[a++] = k;
+    IndexedFlight& f = flights[k];
+    f.firstSeen = rows[k].firstSeen;
+    f.lastSeen = rows[k].lastSeen;
+    f.icao24 = rows[k].icao24;
+    f.arrival = index[rows[k].arr()];
+    std::memcpy(f.callsign, rows[k].callsign, sizeof(f.callsign));
+  }
+  while (a <= airports) offsets[a++] = rows.size();
+
+  writeFileAtomic(path, buf);
+  return rows.size();
+}
+
+} // namespace
+
+DepartureIndexSummary buildDepartureIndex(const std::vector<std::string>& csvPaths, const std::string& dir) {
+  std::error_code ec;
+  fs::create_directories(dir, ec);
+  if (!fs::is_directory(dir)) throw std::runtime_error("Cannot create departure index directory " + dir);
+
+  // Pass 1: parse and spill each row to its month's scratch file.
+  DepartureIndexSummary summary;
+  std::map<long, std::pair<long, std::ofstream>> spills; // month begin -> (end, scratch)
+  auto spillPath = [&dir](long begin) { return (fs::path(dir) / (monthName(begin) + ".spill")).string(); };
+
+  std::vector<std::string> fields;
+  for (const std::string& csv : csvPaths) {
+    std::ifstream file;
+    if (csv != "-") {
+      file.open(csv, std::ios::binary);
+      if (!file) throw std::runtime_error("Cannot read " + csv);
+    }
+    std::istream& in = csv == "-" ? std::cin : file;
+
+    std::string line;
+    if (!std::getline(in, line)) continue;
+    splitCsv(line, fields);
+    int icao = -1, callsign = -1, dep = -1, arr = -1, first = -1, last = -1;
+    for (int i = 0; i < (int)fields.size(); i++) {
+      std::string name = fields[i];
+      for (char& c : name) c = (char)std::tolower((unsigned char)c);
+      if (name == "icao24") icao = i;
+      else if (name == "callsign") callsign = i;
+      else if (name == "estdepartureairport" || name == "origin") dep = i;
+      else if (name == "estarrivalairport" || name == "destination") arr = i;
+      else if (name == "firstseen") first = i;
+      else if (name == "lastseen") last = i;
+    }
+    if (dep < 0 || arr < 0 || first < 0) {
+      throw std::runtime_error("No departure, arrival or firstseen column in " + csv);
+    }
+    int needed = std::max({icao, callsign, dep, arr, first, last}) + 1;
+
+    while (std::getline(in, line)) {
+      if (line.empty() || line == "\r") continue;
+      summary.rows++;
+      splitCsv(line, fields);
+      Row r;
+      if ((int)fields.size() >= needed && fields[dep].size() <= kCodeBytes && fields[arr].size() <= kCodeBytes) {
+        copyCode(r.departure, fields[dep]);
+        copyCode(r.arrival, fields[arr]);
+        r.firstSeen = parseTime(fields[first]);
+      }
+      if (r.departure[0] == '\0' || r.arrival[0] == '\0' || r.firstSeen <= 0) {
+        summary.skipped++;
+        continue;
+      }
+      r.lastSeen = last >= 0 ? parseTime(fields[last]) : 0;
+      if (callsign >= 0) copyCode(r.callsign, fields[callsign]);
+      if (icao >= 0) {
+        Flight f;
+        f.setIcao24(fields[icao]);
+        r.icao24 = f.icao24;
+      }
+
+      long begin = 0, end = 0;
+      monthOf(r.firstSeen, begin, end);
+      auto it = spills.find(begin);
+      if (it == spills.end()) {
+        it = spills.emplace(begin, std::make_pair(end, std::ofstream())).first;
+        it->second.second.open(spillPath(begin), std::ios::binary | std::ios::trunc);
+        if (!it->second.second) throw std::runtime_error("Cannot write " + spillPath(begin));
+      }
+      it->second.second.write(reinterpret_cast<const char*>(&r), sizeof(r));
+    }
+  }
+
+  // Pass 2: one month at a time, merge with the existing partition and write it.
+  for (auto& [begin, spill] : spills) {
+    auto& [end, out] = spill;
+    out.close();
+    if (!out) throw std::runtime_error("Cannot write " + spillPath(begin));
+
+    std::vector<Row> rows;
+    std::string partitionPath = (fs::path(dir) / (monthName(begin) + kExtension)).string();
+    if (fs::exists(partitionPath)) {
+      DepartureIndex::Partition old(partitionPath);
+      rows.reserve(old.header.flightCount);
+      for (uint32_t a = 0; a < old.header.airportCount; a++) {
+        std::string_view code = codeAt(old.codes, a);
+        for (uint64_t k = old.offsets[a]; k < old.offsets[a + 1]; k++) {
+          const IndexedFlight& f = old.flights[k];
+          Row r;
+          r.firstSeen = f.firstSeen;
+          r.lastSeen = f.lastSeen;
+          r.icao24 = f.icao24;
+          std::memcpy(r.callsign, f.callsign, sizeof(r.callsign));
+          std::memcpy(r.departure, code.data(), code.size());
+          std::string_view to = codeAt(old.codes, f.arrival);
+          std::memcpy(r.arrival, to.data(), to.size());
+          rows.push_back(r);
+        }
+      }
+    }
+
+    std::ifstream in(spillPath(begin), std::ios::binary);
+    size_t have = rows.size();
+    in.seekg(0, std::ios::end);
+    rows.resize(have + (size_t)in.tellg() / sizeof(Row));
+    in.seekg(0);
+    in.read(reinterpret_cast<char*>(rows.data() + have), (std::streamsize)((rows.size() - have) * sizeof(Row)));
+    in.close();
+
+    summary.flights += writePartition(partitionPath, begin, end, rows);
+    summary.partitions++;
+    fs::remove(spillPath(begin), ec);
+  }
+  return summary;
+}
+
+bool isDepartureIndex(const std::string& path) {
+  std::error_code ec;
+  if (fs::is_regular_file(path, ec)) return fs::path(path).extension() == kExtension;
+  if (!fs::is_directory(path, ec)) return false;
+  for (const auto& entry : fs::directory_iterator(path, ec)) {
+    if (entry.is_regular_file() && entry.path().extension() == kExtension) return true;
+  }
+  return false;
+}
+
+// ---- DepartureIndex ----
+
+std::string_view DepartureIndex::Run::arrival(const IndexedFlight& f) const {
+  return codeAt(codes, f.arrival);
+}
+
+DepartureIndex::DepartureIndex(const std::string& path) {
+  std::vector<std::string> files;
+  std::error_code ec;
+  if (fs::is_directory(path, ec)) {
+    for (const auto& entry : fs::directory_iterator(path, ec)) {
+      if (entry.is_regular_file() && entry.path().extension() == kExtension) files.push_back(entry.path().string());
+    }
+  } else if (fs::exists(path, ec)) {
+    files.push_back(path);
+  }
+  if (files.empty()) throw std::runtime_error("No departure index at " + path);
+
+  for (const auto& f : files) partitions_.push_back(std::make_unique<Partition>(f));
+  std::sort(partitions_.begin(), partitions_.end(),
+            [](const auto& a, const auto& b) { return a->header.beginUtc < b->header.beginUtc; });
+  for (const auto& p : partitions_) {
+    flightCount_ += p->header.flightCount;
+    if (p->header.flightCount == 0) continue;
+    if (earliest_ == 0 || p->header.firstSeen < earliest_) earliest_ = p->header.firstSeen;
+    latest_ = std::max(latest_, (long)p->header.lastSeen);
+  }
+}
+
+DepartureIndex::~DepartureIndex() = default;
+
+std::vector<DepartureIndex::Run> DepartureIndex::runs(std::string_view icao, long beginUtc, long endUtc) const {
+  std::vector<Run> out;
+  auto it = std::partition_point(partitions_.begin(), partitions_.end(),
+                                 [beginUtc](const auto& p) { return p->header.endUtc <= beginUtc; });
+  for (; it != partitions_.end() && (*it)->header.beginUtc <= endUtc; ++it) {
+    long a = (*it)->airport(icao);
+    if (a < 0) continue;
+    Run r = (*it)->run(a, beginUtc, endUtc);
+    if (r.size() > 0) out.push_back(r);
+  }
+  return out;
+}
+
+std::vector<Flight> DepartureIndex::window(const std::string& airportIcao, long beginUtc, long endUtc) const {
+  std::vector<Flight> out;
+  auto it = std::partition_point(partitions_.begin(), partitions_.end(),
+                                 [beginUtc](const auto& p) { return p->header.endUtc <= beginUtc; });
+  for (; it != partitions_.end() && (*it)->header.beginUtc <= endUtc; ++it) {
+    Partition& p = **it;
+    long a = p.airport(airportIcao);
+    if (a < 0) continue;
+    Run r = p.run(a, beginUtc, endUtc);
+    if (r.size() == 0) continue;
+    const std::vector<AirportId>& ids = p.airportIds();
+    out.reserve(out.size() + r.size());
+    for (const IndexedFlight* f = r.begin; f != r.end; ++f) {
+      out.push_back(toFlight(*f, ids[(size_t)a], ids[f->arrival]));
+    }
+  }
+  return out;
+}
+
+void DepartureIndex::forEach(const std::function<void(const Flight&)>& visit) const {
+  for (const auto& p : partitions_) {
+    const std::vector<AirportId>& ids = p->airportIds();
+    for (uint32_t a = 0; a < p->header.airportCount; a++) {
+      for (uint64_t k = p->offsets[a]; k < p->offsets[a + 1]; k++) {
+        const IndexedFlight& f = p->flights[k];
+        visit(toFlight(f, ids[a], ids[f.arrival]));
+      }
+    }
+  }
+}
+
+std::vector<DepartureIndex::PartitionInfo> DepartureIndex::partitions() const {
+  std::vector<PartitionInfo> out;
+  for (const auto& p : partitions_) {
+    PartitionInfo info;
+    info.path = p->path;
+    info.beginUtc = p->header.beginUtc;
+    info.endUtc = p->header.endUtc;
+    info.airports = p->header.airportCount;
+    info.flights = p->header.flightCount;
+    out.push_back(info);
+  }
+  return out;
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include "recorded_source.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Departures from bulk historical flight-list dumps, kept as a directory of
+// memory-mapped partitions, one per UTC month of firstSeen ("2026-01.depidx").
+//
+// Partition layout (native endianness, every section 8-byte aligned):
+//   header   magic "ITDEPIX1", version, airport/flight counts, month bounds
+//   codes    airportCount x 8-byte ICAO codes, sorted (departures and arrivals)
+//   offsets  (airportCount + 1) x uint64, each airport's first departure
+//   flights  flightCount x IndexedFlight, sorted by (departure, firstSeen)
+//
+// A window query binary-searches the code table, then firstSeen within the
+// airport's run, and reads the records where they are mapped. Opening reads
+// only the partition headers, so years of history open in milliseconds; a
+// partition's codes are interned on its first query.
+
+// 32 bytes on disk; the departure airport is implied by the offset table.
+struct IndexedFlight {
+  int64_t firstSeen;
+  int64_t lastSeen;
+  uint32_t icao24;
+  uint32_t arrival;   // index into the partition's code table
+  char callsign[8];   // NUL-padded, as Flight::callsign
+};
+static_assert(sizeof(IndexedFlight) == 32, "index records are fixed-size");
+
+struct DepartureIndexSummary {
+  size_t rows = 0;        // CSV data rows read
+  size_t skipped = 0;     // rows without both airports or a firstSeen
+  size_t flights = 0;     // in the touched partitions afterwards, duplicates dropped
+  size_t partitions = 0;  // months written
+};
+
+// Merges OpenSky flight-list CSV dumps ("-" reads stdin) into the index in
+// `dir`, creating it if needed. Columns are found by header name: icao24,
+// callsign, firstseen, lastseen and estdepartureairport/estarrivalairport or
+// origin/destination; times are unix seconds or "YYYY-MM-DD HH:MM:SS".
+// Rows are spilled to one scratch file per month first, so memory use is
+// bounded by the largest month, not the size of the dumps. Existing
+// partitions are merged, so monthly dumps can be added one at a time.
+// Throws std::runtime_error on unreadable input or a missing column.
+DepartureIndexSummary buildDepartureIndex(const std::vector<std::string>& csvPaths, const std::string& dir);
+
+// True for an index directory or a single partition file.
+bool isDepartureIndex(const std::string& path);
+
+class DepartureIndex : public ReplaySource {
+ public:
+  // One partition's departures from an airport inside a window, read in
+  // place from the mapping.
+  struct Run {
+    const IndexedFlight* begin = nullptr;
+    const IndexedFlight* end = nullptr;
+    const char* codes = nullptr;
+
+    size_t size() const { return (size_t)(end - begin); }
+    std::string_view arrival(const IndexedFlight& f) const;
+  };
+
+  struct PartitionInfo {
+    std::string path;
+    long beginUtc = 0;   // month covered, [beginUtc, endUtc)
+    long endUtc = 0;
+    size_t airports = 0;
+    size_t flights = 0;
+  };
+
+  // Throws std::runtime_error if `path` holds no index or a partition is malformed.
+  explicit DepartureIndex(const std::string& path);
+  ~DepartureIndex();
+
+  DepartureIndex(const DepartureIndex&) = delete;
+  DepartureIndex& operator=(const DepartureIndex&) = delete;
+
+  // Departures with firstSeen in [beginUtc, endUtc], oldest partition first.
+  // Nothing is copied.
+  std::vector<Run> runs(std::string_view icao, long beginUtc, long endUtc) const;
+
+  std::vector<Flight> window(const std::string& airportIcao, long beginUtc, long endUtc) const override;
+  void forEach(const std::function<void(const Flight&)>& visit) const override;
+
+  size_t flightCount() const override { return flightCount_; }
+  long earliestDeparture() const override { return earliest_; }
+  long latestDeparture() const override { return latest_; }
+  std::vector<PartitionInfo> partitions() const;
+
+  struct Partition;
+
+ private:
+  std::vector<std::unique_ptr<Partition>> partitions_; // by month
+  size_t flightCount_ = 0;
+  long earliest_ = 0;
+  long latest_ = 0;
+};
@@ -0,0 +1,262 @@
+#include "departure_parser.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <utility>
+
+static bool isJsonSpace(char c) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+static std::string trim(const std::string& s) {
+  size_t a = 0, b = s.size();
+  while (a < b && std::isspace((unsigned char)s[a])) a++;
+  while (b > a && std::isspace((unsigned char)s[b - 1])) b--;
+  return s.substr(a, b - a);
+}
+
+static void appendUtf8(std::string& out, unsigned cp) {
+  if (cp < 0x80) {
+    out += (char)cp;
+  } else if (cp < 0x800) {
+    out += (char)(0xC0 | (cp >> 6));
+    out += (char)(0x80 | (cp & 0x3F));
+  } else {
+    out += (char)(0xE0 | (cp >> 12));
+    out += (char)(0x80 | ((cp >> 6) & 0x3F));
+    out += (char)(0x80 | (cp & 0x3F));
+  }
+}
+
+DepartureStreamParser::DepartureStreamParser(std::string departureAirport)
+  : departureAirport_(std::move(departureAirport)) {}
+
+void DepartureStreamParser::beginObject() {
+  objectsSeen_++;
+  cur_ = Flight{};
+  field_ = Field::None;
+}
+
+void DepartureStreamParser::endObject() {
+  bool keep = cur_.estDepartureAirport != kNoAirport &&
+              cur_.estArrivalAirport != kNoAirport && cur_.firstSeen > 0;
+  if (keep) flights_.push_back(cur_);
+  state_ = State::Top;
+}
+
+AirportId DepartureStreamParser::intern(const std::string& icao) {
+  // A response names few distinct airports; remembering them locally keeps the
+  // shared dictionary lock off the per-row path.
+  auto it = localIds_.find(icao);
+  if (it != localIds_.end()) return it->second;
+  AirportId id = AirportDict::intern(icao);
+  localIds_.emplace(icao, id);
+  return id;
+}
+
+void DepartureStreamParser::assignString() {
+  switch (field_) {
+    case Field::Icao24:    cur_.setIcao24(token_); break;
+    case Field::Callsign:  cur_.setCallsign(trim(token_)); break;
+    case Field::Departure:
+      // Only the wanted airport is interned; anything else stays kNoAirport and is rejected.
+      cur_.estDepartureAirport = (departureAirport_.empty() || token_ == departureAirport_)
+                                     ? intern(token_) : kNoAirport;
+      break;
+    case Field::Arrival:   cur_.estArrivalAirport = intern(token_); break;
+    case Field::FirstSeen: cur_.firstSeen = std::strtol(token_.c_str(), nullptr, 10); break;
+    case Field::LastSeen:  cur_.lastSeen = std::strtol(token_.c_str(), nullptr, 10); break;
+    case Field::None: break;
+  }
+}
+
+void DepartureStreamParser::assignScalar() {
+  bool isNull = token_ == "null";
+  switch (field_) {
+    case Field::FirstSeen: cur_.firstSeen = isNull ? 0 : std::strtol(token_.c_str(), nullptr, 10); break;
+    case Field::LastSeen:  cur_.lastSeen = isNull ? 0 : std::strtol(token_.c_str(), nullptr, 10); break;
+    case Field::Departure: cur_.estDepartureAirport = kNoAirport; break;
+    case Field::Arrival:   cur_.estArrivalAirport = kNoAirport; break;
+    default: break;
+  }
+}
+
+bool DepartureStreamParser::appendStringChar(char c) {
+  if (unicodeLeft_ > 0) {
+    unicode_ = (unicode_ << 4) | (unsigned)(std::isdigit((unsigned char)c) ? c - '0' : (std::tolower((unsigned char)c) - 'a' + 10));
+    if (--unicodeLeft_ == 0) appendUtf8(token_, unicode_ & 0xFFFF);
+    return false;
+  }
+  if (escape_) {
+    escape_ = false;
+    switch (c) {
+      case 'n': token_ += '\n'; break;
+      case 't': token_ += '\t'; break;
+      case 'r': token_ += '\r'; break;
+      case 'b': token_ += '\b'; break;
+      case 'f': token_ += '\f'; break;
+      case 'u': unicodeLeft_ = 4; unicode_ = 0; break;
+      default:  token_ += c; break; // \" \\ \/
+    }
+    return false;
+  }
+  if (c == '\\') {
+    escape_ = true;
+    return false;
+  }
+  if (c == '"') return true;
+  token_ += c;
+  return false;
+}
+
+// Appends the run of ordinary string characters starting at `i` to token_ in one
+// go and returns the index of the next quote/backslash (or `len`).
+size_t DepartureStreamParser::scanPlain(const char* data, size_t i, size_t len) {
+  size_t j = i;
+  while (j < len && data[j] != '"' && data[j] != '\\') j++;
+  token_.append(data + i, j - i);
+  return j;
+}
+
+void DepartureStreamParser::feed(const char* data, size_t len) {
+  // A row can be rejected as soon as one of its filter fields is known; the rest
+  // of the object is then skipped without decoding anything.
+  auto rejectRest = [this] {
+    state_ = State::Skip;
+    skipDepth_ = 1;
+    skipIsObject_ = true;
+    inString_ = false;
+    escape_ = false;
+  };
+  auto rejected = [this] {
+    if (field_ == Field::Arrival) return cur_.estArrivalAirport == kNoAirport;
+    if (field_ == Field::Departure) return cur_.estDepartureAirport == kNoAirport;
+    return false;
+  };
+
+  for (size_t i = 0; i < len; i++) {
+    char c = data[i];
+    switch (state_) {
+      case State::Top:
+        if (inString_) {
+          if (escape_) escape_ = false;
+          else if (c == '\\') escape_ = true;
+          else if (c == '"') inString_ = false;
+        } else if (c == '"') {
+          inString_ = true;
+        } else if (c == '[') {
+          topDepth_++;
+        } else if (c == ']') {
+          topDepth_--;
+        } else if (c == '{') {
+          beginObject();
+          state_ = State::Key;
+        }
+        break;
+
+      case State::Key:
+        if (isJsonSpace(c) || c == ',') break;
+        if (c == '"') {
+          token_.clear();
+          state_ = State::KeyStr;
+        } else if (c == '}') {
+          endObject();
+        } else {
+          rejectRest();
+          if (c == '{' || c == '[') skipDepth_++;
+        }
+        break;
+
+      case State::KeyStr:
+        if (!escape_ && unicodeLeft_ == 0) {
+          i = scanPlain(data, i, len);
+          if (i == len) break;
+          c = data[i];
+        }
+        if (appendStringChar(c)) {
+          if (token_ == "icao24") field_ = Field::Icao24;
+          else if (token_ == "callsign") field_ = Field::Callsign;
+          else if (token_ == "estDepartureAirport") field_ = Field::Departure;
+          else if (token_ == "estArrivalAirport") field_ = Field::Arrival;
+          else if (token_ == "firstSeen") field_ = Field::FirstSeen;
+          else if (token_ == "lastSeen") field_ = Field::LastSeen;
+          else field_ = Field::None;
+          state_ = State::Colon;
+        }
+        break;
+
+      case State::Colon:
+        if (isJsonSpace(c)) break;
+        if (c == ':') state_ = State::Value;
+        else rejectRest();
+        break;
+
+      case State::Value:
+        if (isJsonSpace(c)) break;
+        token_.clear();
+        if (c == '"') {
+          state_ = State::ValStr;
+        } else if (c == '{' || c == '[') {
+          state_ = State::Skip;
+          skipDepth_ = 1;
+          skipIsObject_ = false;
+          inString_ = false;
+        } else {
+          token_ += c;
+          state_ = State::Scalar;
+        }
+        break;
+
+      case State::ValStr:
+        if (!escape_ && unicodeLeft_ == 0) {
+          i = scanPlain(data, i, len);
+          if (i == len) break;
+          c = data[i];
+        }
+        if (appendStringChar(c)) {
+          assignString();
+          if (rejected()) rejectRest();
+          else state_ = State::Key;
+        }
+        break;
+
+      case State::Scalar:
+        if (c == ',' || c == '}' || isJsonSpace(c)) {
+          assignScalar();
+          if (c == '}') {
+            endObject();
+          } else if (rejected()) {
+            rejectRest();
+          } else {
+            state_ = State::Key;
+          }
+        } else {
+          token_ += c;
+        }
+        break;
+
+      case State::Skip:
+        if (inString_) {
+          if (escape_) escape_ = false;
+          else if (c == '\\') escape_ = true;
+          else if (c == '"') inString_ = false;
+          break;
+        }
+        if (c == '"') {
+          inString_ = true;
+        } else if (c == '{' || c == '[') {
+          skipDepth_++;
+        } else if (c == '}' || c == ']') {
+          if (--skipDepth_ == 0) {
+            if (skipIsObject_) state_ = State::Top; // rejected row: nothing emitted
+            else state_ = State::Key;
+          }
+        }
+        break;
+    }
+  }
+}
+
+bool DepartureStreamParser::finish() const {
+  return state_ == State::Top && !inString_ && topDepth_ == 0;
+}
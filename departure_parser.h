@@ -0,0 +1,70 @@
+#pragma once
+#include "departure_source.h"
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Incremental parser for OpenSky flight lists.
+//
+// Bytes can be fed in arbitrary chunks as they arrive (e.g. straight from the
+// curl write callback); each flight object is decoded field by field without
+// buffering the document. Accepts a JSON array of objects (the API response)
+// or a stream of top-level objects (NDJSON). Nested objects/arrays are skipped,
+// and escapes or braces inside strings are handled.
+//
+// Rows are filtered while they are being read: objects whose
+// estDepartureAirport differs from `departureAirport` (when set) or whose
+// estArrivalAirport is null are dropped without ever producing a Flight.
+class DepartureStreamParser {
+ public:
+  explicit DepartureStreamParser(std::string departureAirport = "");
+
+  void feed(const char* data, size_t len);
+
+  // True if the input ended cleanly (not inside an object or string).
+  bool finish() const;
+
+  std::vector<Flight>& flights() { return flights_; }
+  size_t objectsSeen() const { return objectsSeen_; }
+
+ private:
+  enum class State {
+    Top,        // outside any flight object
+    Key,        // inside an object, before a key (skipping ws and ',')
+    KeyStr,     // reading a key
+    Colon,      // after a key, before ':'
+    Value,      // before a value
+    ValStr,     // reading a string value
+    Scalar,     // reading a number / true / false / null
+    Skip,       // skipping a nested value, or the rest of a rejected object
+  };
+  enum class Field { None, Icao24, Callsign, Departure, Arrival, FirstSeen, LastSeen };
+
+  std::string departureAirport_;
+  std::vector<Flight> flights_;
+  size_t objectsSeen_ = 0;
+
+  State state_ = State::Top;
+  int topDepth_ = 0;      // open arrays around the records
+  int skipDepth_ = 0;     // nesting inside a skipped value
+  bool skipIsObject_ = false; // Skip swallows the rest of the current object
+  bool inString_ = false; // string state for Top/Skip
+  bool escape_ = false;
+  int unicodeLeft_ = 0;   // hex digits left in a \uXXXX escape
+  unsigned unicode_ = 0;
+
+  std::string token_;
+  Field field_ = Field::None;
+  Flight cur_;
+  std::unordered_map<std::string, AirportId> localIds_;
+
+  void beginObject();
+  void endObject();
+  AirportId intern(const std::string& icao);
+  void assignString();
+  void assignScalar();
+  bool appendStringChar(char c); // returns true when the closing quote is reached
+  size_t scanPlain(const char* data, size_t i, size_t len);
+};
@@ -0,0 +1,237 @@
+#pragma once
+#include "airport_dict.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <future>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// One departure, 32 bytes: airports are interned IDs, the transponder address
+// is its 24-bit value and the callsign a fixed 8-byte field.
+struct Flight {
+  uint32_t icao24 = 0;                       // 24-bit ICAO address
+  char callsign[8] = {};                     // NUL-padded, not terminated when 8 long
+  AirportId estDepartureAirport = kNoAirport;
+  AirportId estArrivalAirport = kNoAirport;
+  long firstSeen = 0; // unix seconds UTC
+  long lastSeen  = 0; // unix seconds UTC
+
+  std::string_view departure() const { return AirportDict::name(estDepartureAirport); }
+  std::string_view arrival() const { return AirportDict::name(estArrivalAirport); }
+
+  std::string callsignStr() const {
+    return std::string(callsign, strnlen(callsign, sizeof(callsign)));
+  }
+  void setCallsign(std::string_view s) {
+    std::memset(callsign, 0, sizeof(callsign));
+    std::memcpy(callsign, s.data(), s.size() < sizeof(callsign) ? s.size() : sizeof(callsign));
+  }
+
+  std::string icao24Hex() const {
+    static const char* digits = "0123456789abcdef";
+    std::string out(6, '0');
+    for (int i = 5, v = (int)icao24; i >= 0; i--, v >>= 4) out[i] = digits[v & 0xF];
+    return out;
+  }
+  void setIcao24(std::string_view hex) {
+    icao24 = 0;
+    for (char c : hex) {
+      int d = (c >= '0' && c <= '9') ? c - '0'
+            : (c >= 'a' && c <= 'f') ? c - 'a' + 10
+            : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+      if (d >= 0) icao24 = ((icao24 << 4) | (uint32_t)d) & 0xFFFFFF;
+    }
+  }
+};
+
+static_assert(sizeof(Flight) <= 32, "Flight should stay a compact record");
+
+// Why a fetch is being made. A scheduler in front of a rate-limited API serves
+// the traveler's own tick first and drops speculative work when credits run low.
+enum class FetchPriority : uint8_t { Tick, Lookahead, Prefetch };
+
+// Sets the priority of fetches made by this thread while in scope. Decorators
+// call upstream on the caller's thread, so it reaches the scheduler unchanged.
+class FetchPriorityScope {
+ public:
+  explicit FetchPriorityScope(FetchPriority p) : saved_(current_) { current_ = p; }
+  ~FetchPriorityScope() { current_ = saved_; }
+
+  FetchPriorityScope(const FetchPriorityScope&) = delete;
+  FetchPriorityScope& operator=(const FetchPriorityScope&) = delete;
+
+  static FetchPriority current() { return current_; }
+
+ private:
+  FetchPriority saved_;
+  static inline thread_local FetchPriority current_ = FetchPriority::Tick;
+};
+
+// Network-side cost of the fetches one thread makes; see FetchMetricsScope.
+struct FetchMetrics {
+  long requests = 0;         // HTTP requests sent, retries included
+  long retries = 0;
+  long hedges = 0;           // duplicates sent for slow requests
+  long bytesDownloaded = 0;  // on the wire (compressed if encoded)
+  long flightsParsed = 0;
+  double creditsCharged = 0; // estimated API credits
+  double dnsMs = 0;
+  double connectMs = 0;      // TCP
+  double tlsMs = 0;
+  double waitMs = 0;         // request sent to first byte
+  double transferMs = 0;     // first byte to last, parsing included
+  double parseMs = 0;        // inside the parser (overlaps transferMs)
+};
+
+// Collects FetchMetrics for fetches made by this thread while in scope.
+class FetchMetricsScope {
+ public:
+  explicit FetchMetricsScope(FetchMetrics& m) : saved_(current_) { current_ = &m; }
+  ~FetchMetricsScope() { current_ = saved_; }
+
+  FetchMetricsScope(const FetchMetricsScope&) = delete;
+  FetchMetricsScope& operator=(const FetchMetricsScope&) = delete;
+
+  static FetchMetrics* current() { return current_; }
+
+ private:
+  FetchMetrics* saved_;
+  static inline thread_local FetchMetrics* current_ = nullptr;
+};
+
+// A failed fetch, with enough detail to decide what to do next.
+class FetchError : public std::runtime_error {
+ public:
+  // status: HTTP status, 0 for a transport failure.
+  // retryAfterSeconds: how long the server (or quota) says to wait; 0 = unknown.
+  FetchError(const std::string& what, long status, long retryAfterSeconds = 0)
+    : std::runtime_error(what), status_(status), retryAfterSeconds_(retryAfterSeconds) {}
+
+  long status() const { return status_; }
+  long retryAfterSeconds() const { return retryAfterSeconds_; }
+  bool rateLimited() const { return status_ == 429; }
+  // Worth retrying later: transport failures, rate limits and server errors.
+  bool transient() const { return status_ == 0 || status_ == 429 || status_ >= 500; }
+
+ private:
+  long status_;
+  long retryAfterSeconds_;
+};
+
+// A fetch given up because the deadline in force (FetchDeadlineScope) passed.
+class DeadlineExceeded : public FetchError {
+ public:
+  explicit DeadlineExceeded(const std::string& what) : FetchError(what, 0) {}
+};
+
+// The deadline cut a fetch short, but part of the window was already known
+// (e.g. cached): flights() are real departures, just maybe not all of them.
+// Callers that cannot use a partial window treat it as the failure it derives from.
+class PartialDepartures : public DeadlineExceeded {
+ public:
+  PartialDepartures(const std::string& what, std::vector<Flight> flights)
+    : DeadlineExceeded(what), flights_(std::move(flights)) {}
+
+  const std::vector<Flight>& flights() const { return flights_; }
+
+ private:
+  std::vector<Flight> flights_;
+};
+
+// Bounds the fetches this thread makes while in scope. The client caps its
+// timeouts at the time left, the scheduler neither backs off nor waits past
+// it, and waits on fetches shared with other callers give up at it. A nested
+// scope can only shorten the deadline.
+class FetchDeadlineScope {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit FetchDeadlineScope(Clock::time_point deadline) : saved_(current_) {
+    current_ = std::min(current_, deadline);
+  }
+  ~FetchDeadlineScope() { current_ = saved_; }
+
+  FetchDeadlineScope(const FetchDeadlineScope&) = delete;
+  FetchDeadlineScope& operator=(const FetchDeadlineScope&) = delete;
+
+  static Clock::time_point deadline() { return current_; }
+  static bool active() { return current_ != Clock::time_point::max(); }
+
+  // Milliseconds left (0 once passed); LONG_MAX without a deadline.
+  static long remainingMs() {
+    if (!active()) return std::numeric_limits<long>::max();
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(current_ - Clock::now()).count();
+    return std::max(0L, (long)left);
+  }
+
+  // Waits for `result` (computed by someone else) until the deadline.
+  template <class T>
+  static void wait(const std::shared_future<T>& result, const char* what) {
+    if (active() && result.wait_until(current_) != std::future_status::ready) {
+      throw DeadlineExceeded(std::string("Deadline passed waiting for ") + what);
+    }
+  }
+
+ private:
+  Clock::time_point saved_;
+  static inline thread_local Clock::time_point current_ = Clock::time_point::max();
+};
+
+// OpenSky publishes a UTC day's flights in a nightly batch, up to this long
+// after the day ends; until then a window in that day may come back short.
+constexpr long kPublishLagSeconds = 6 * 3600;
+
+// One window of a batch fetch.
+struct DepartureRequest {
+  std::string airport;
+  long beginUtc = 0;
+  long endUtc = 0;
+};
+
+// Called once per request of a batch, as each completes, on the calling thread:
+// its flights, or the error it failed with.
+using DepartureCallback = std::function<void(size_t index, std::vector<Flight> flights, std::exception_ptr error)>;
+
+// Anything that can answer "which flights left this airport in [begin,end]".
+// OpenSkyClient is the live implementation; caches and replays wrap or replace it.
+class DepartureSource {
+ public:
+  virtual ~DepartureSource() = default;
+
+  // Flights whose firstSeen lies in [beginUtc,endUtc] (unix seconds UTC).
+  virtual std::vector<Flight> getDepartures(const std::string& airportIcao,
+                                            long beginUtc,
+                                            long endUtc) = 0;
+
+  // Hint that getDepartures(airportIcao, beginUtc, endUtc) will be asked for
+  // soon. Sources that can fetch ahead (PrefetchingSource) start now; the rest
+  // ignore it.
+  virtual void prefetch(const std::string& airportIcao, long beginUtc, long endUtc) {
+    (void)airportIcao; (void)beginUtc; (void)endUtc;
+  }
+
+  // Fetches several windows and returns once done() has been called for each.
+  // Errors are per request. OpenSkyClient (and the decorators in front of it)
+  // keep the requests in flight together, so a batch takes about as long as
+  // its slowest request; this default asks one at a time.
+  virtual void getDeparturesBatch(const std::vector<DepartureRequest>& requests, const DepartureCallback& done) {
+    for (size_t i = 0; i < requests.size(); i++) {
+      std::vector<Flight> flights;
+      std::exception_ptr error;
+      try {
+        flights = getDepartures(requests[i].airport, requests[i].beginUtc, requests[i].endUtc);
+      } catch (...) {
+        error = std::current_exception();
+      }
+      done(i, std::move(flights), error);
+    }
+  }
+};
@@ -0,0 +1,226 @@
+#include "fleet.h"
+#include "state_io.h"
+#include "state_store.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <thread>
+#include <tuple>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Member {
+  std::string name;
+  std::string dir;
+  TravelerState st;
+  long hopCount = 0;
+  bool due = false;
+  long windowBegin = 0;
+  long windowEnd = 0;
+  std::string error; // set if the traveler was skipped
+};
+
+// (airport, first UTC day, last UTC day) of a query window.
+using GroupKey = std::tuple<std::string, long, long>;
+
+struct Group {
+  long begin = 0;
+  long end = 0;
+  std::vector<Flight> flights;
+  std::exception_ptr error;
+};
+
+GroupKey groupKey(const std::string& airport, long begin, long end) {
+  return {airport, begin / 86400, end / 86400};
+}
+
+// Answers each traveler's window from the shared group fetch; anything outside
+// a fetched group goes to the real source.
+class SharedWindows : public DepartureSource {
+ public:
+  SharedWindows(const std::map<GroupKey, Group>& groups, DepartureSource& fallback)
+    : groups_(groups), fallback_(fallback) {}
+
+  std::vector<Flight> getDepartures(const std::string& airportIcao,
+                                    long beginUtc,
+                                    long endUtc) override {
+    auto it = groups_.find(groupKey(airportIcao, beginUtc, endUtc));
+    if (it == groups_.end() || beginUtc < it->second.begin || endUtc > it->second.end) {
+      return fallback_.getDepartures(airportIcao, beginUtc, endUtc);
+    }
+    if (it->second.error) {
+      try {
+        std::rethrow_exception(it->second.error);
+      } catch (const PartialDepartures& e) {
+        throw PartialDepartures(e.what(), within(e.flights(), beginUtc, endUtc));
+      }
+    }
+    return within(it->second.flights, beginUtc, endUtc);
+  }
+
+ private:
+  const std::map<GroupKey, Group>& groups_;
+  DepartureSource& fallback_;
+
+  static std::vector<Flight> within(const std::vector<Flight>& flights, long beginUtc, long endUtc) {
+    std::vector<Flight> out;
+    for (const auto& f : flights) {
+      if (f.firstSeen >= beginUtc && f.firstSeen <= endUtc) out.push_back(f);
+    }
+    return out;
+  }
+};
+
+template <typename Fn>
+void parallelFor(size_t n, unsigned workers, Fn fn) {
+  std::atomic<size_t> next{0};
+  auto worker = [&] {
+    for (size_t i; (i = next++) < n;) fn(i);
+  };
+  std::vector<std::thread> pool;
+  for (unsigned w = 1; w < workers && w < n; w++) pool.emplace_back(worker);
+  worker();
+  for (auto& t : pool) t.join();
+}
+
+} // namespace
+
+FleetRunner::FleetRunner(DepartureSource& source, FleetOptions options)
+  : source_(source), options_(std::move(options)) {
+  if (options_.workers == 0) options_.workers = std::max(1u, std::thread::hardware_concurrency());
+}
+
+FleetReport FleetRunner::run(long nowUtc) {
+  auto t0 = std::chrono::steady_clock::now();
+  FleetReport report;
+  // One deadline for the whole run: the shared fetch and every tick's own.
+  auto deadline = options_.tickBudgetMs > 0 ? t0 + std::chrono::milliseconds(options_.tickBudgetMs)
+                                            : std::chrono::steady_clock::time_point::max();
+
+  // Travelers: every sub-directory with a state.json, plus (with a store) every
+  // traveler in the store. A store record wins over the directory's JSON.
+  std::unique_ptr<StateStore> store;
+  if (!options_.store.empty()) store = std::make_unique<StateStore>(options_.store);
+
+  std::vector<std::string> names;
+  std::error_code ec;
+  for (const auto& entry : fs::directory_iterator(options_.dir, ec)) {
+    if (entry.is_directory() && fs::exists(entry.path() / "state.json")) names.push_back(entry.path().filename().string());
+  }
+  if (store) {
+    for (auto& n : store->names()) names.push_back(std::move(n));
+  }
+  std::sort(names.begin(), names.end());
+  names.erase(std::unique(names.begin(), names.end()), names.end());
+
+  std::vector<Member> members(names.size());
+  for (size_t i = 0; i < names.size(); i++) {
+    members[i].name = names[i];
+    members[i].dir = (fs::path(options_.dir) / names[i]).string();
+    if (store && names[i].size() > StateStore::kMaxName) {
+      members[i].error = "name longer than " + std::to_string(StateStore::kMaxName) + " characters";
+    }
+  }
+  report.travelers = members.size();
+
+  // Workers must not throw (parallelFor would terminate): a failure skips that
+  // traveler and is reported.
+  auto guarded = [&](Member& m, const auto& fn) {
+    try {
+      fn();
+    } catch (const std::exception& e) {
+      m.error = e.what();
+      m.due = false;
+    }
+  };
+
+  // 1) Load states and work out who is due and which window they will ask for.
+  parallelFor(members.size(), options_.workers, [&](size_t i) {
+    Member& m = members[i];
+    if (!m.error.empty()) return;
+    guarded(m, [&] {
+      if (!store || !store->load(m.name, m.st, m.hopCount)) {
+        m.st = loadState((fs::path(m.dir) / "state.json").string(), m.hopCount);
+        if (store) store->save(m.name, m.st, m.hopCount); // migrate on first sight
+      }
+      m.due = TravelerEngine::nextWindow(m.st, nowUtc, m.windowBegin, m.windowEnd);
+    });
+  });
+
+  // 2) One fetch per (airport, window partition), covering every member's window.
+  std::map<GroupKey, Group> groups;
+  for (const auto& m : members) {
+    if (!m.due) continue;
+    report.due++;
+    auto key = groupKey(m.st.current_airport, m.windowBegin, m.windowEnd);
+    auto [it, inserted] = groups.try_emplace(key);
+    Group& g = it->second;
+    if (inserted) {
+      g.begin = m.windowBegin;
+      g.end = m.windowEnd;
+    } else {
+      g.begin = std::min(g.begin, m.windowBegin);
+      g.end = std::max(g.end, m.windowEnd);
+    }
+  }
+  report.groups = groups.size();
+
+  std::vector<Group*> pending;
+  std::vector<DepartureRequest> batch;
+  for (auto& [key, g] : groups) {
+    pending.push_back(&g);
+    batch.push_back(DepartureRequest{std::get<0>(key), g.begin, g.end});
+  }
+  {
+    FetchDeadlineScope budget(deadline);
+    source_.getDeparturesBatch(batch, [&](size_t i, std::vector<Flight> flights, std::exception_ptr error) {
+      pending[i]->flights = std::move(flights);
+      pending[i]->error = error;
+    });
+  }
+  for (const auto& [key, g] : groups) {
+    if (g.error) report.fetchErrors++;
+  }
+
+  // 3) Tick the due travelers against the shared results; each writes only its own files.
+  SharedWindows shared(groups, source_);
+  std::atomic<size_t> hops{0};
+  parallelFor(members.size(), options_.workers, [&](size_t i) {
+    Member& m = members[i];
+    if (!m.due) return;
+
+    guarded(m, [&] {
+      TravelerEngine engine(shared, options_.routes);
+      TravelerState before = m.st;
+      HopResult hop = engine.tick(m.st, nowUtc, deadline);
+      if (hop.didHop) m.hopCount += 1;
+      // State first: if it cannot be saved, nothing is logged and the next run
+      // simply tries again, instead of logging the same hop twice.
+      if (store) {
+        store->save(m.name, m.st, m.hopCount); // one record rewritten, crash-safe
+      } else {
+        fs::create_directories(m.dir);
+        writeFileAtomic((fs::path(m.dir) / "state.json").string(), toJson(m.st, m.hopCount));
+      }
+      if (hop.didHop) {
+        fs::create_directories(m.dir);
+        writeHopOutputs(m.dir, nowUtc, before, hop, m.st, m.hopCount);
+        hops++;
+      }
+    });
+  });
+  report.hops = hops;
+  for (const auto& m : members) {
+    if (!m.error.empty()) report.errors.push_back(m.name + ": " + m.error);
+  }
+
+  report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  return report;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "departure_source.h"
+#include "traveler.h"
+
+#include <string>
+#include <vector>
+
+// Runs many travelers in one process.
+//
+// A fleet directory holds one sub-directory per traveler, each with its own
+// state.json, trip_log.ndjson and latest_* files. On every run the due
+// travelers (by next_event_utc) are grouped by (airport, UTC-day pair of their
+// query window); each group's departures are fetched once and shared, so API
+// calls grow with the number of distinct airports rather than travelers.
+// The group fetches go out as one batch; loading and ticking run on a worker pool.
+//
+// With options.store set, states live in a StateStore instead: travelers found
+// only as state.json are migrated into it when first seen, and the
+// directories then only receive the logs and latest_* files.
+//
+// A traveler whose state cannot be loaded or saved (corrupt record, name too
+// long for the store, disk error) is skipped and listed in the report; the
+// others still tick.
+
+struct FleetOptions {
+  std::string dir = "fleet";
+  unsigned workers = 0; // 0 = hardware concurrency
+  std::string store;    // StateStore file for states; "" = each dir's state.json
+  const RouteGraph* routes = nullptr; // dead-end prediction for scoring; optional
+  long tickBudgetMs = 90 * 1000;      // deadline for the run's fetches and ticks; 0 = none
+};
+
+struct FleetReport {
+  size_t travelers = 0;
+  size_t due = 0;
+  size_t groups = 0;   // distinct (airport, window partition) fetches
+  size_t hops = 0;
+  size_t fetchErrors = 0;
+  std::vector<std::string> errors; // "name: what", one per traveler skipped
+  double seconds = 0;
+};
+
+class FleetRunner {
+ public:
+  FleetRunner(DepartureSource& source, FleetOptions options);
+
+  FleetReport run(long nowUtc);
+
+ private:
+  DepartureSource& source_;
+  FleetOptions options_;
+};
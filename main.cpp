@@ -1,241 +1,523 @@
+#include "daemon.h"
+#include "departure_cache.h"
+#include "departure_index.h"
+#include "fleet.h"
+#include "montecarlo.h"
 #include "opensky_client.h"
+#include "prefetch_source.h"
+#include "quota_scheduler.h"
+#include "recorded_source.h"
+#include "route_graph.h"
+#include "simulation.h"
+#include "state_io.h"
+#include "state_store.h"
+#include "tick_lease.h"
 #include "traveler.h"
+#include "trip_log.h"
 
+#include <cctype>
+#include <cstring>
+#include <chrono>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
-#include <sstream>
+#include <memory>
+#include <string>
+#include <vector>
 #include <ctime>
-#include <cctype>
 #include <cstdlib>
 
 static long nowUtc() { return (long)std::time(nullptr); }
 
-static std::string readFile(const std::string& path) {
-  std::ifstream in(path);
-  std::ostringstream ss;
-  ss << in.rdbuf();
-  return ss.str();
+static void usage() {
+  std::cout << "usage: traveler [tick] [--wait SECONDS]   one tick of ./state.json\n"
+            << "       traveler fleet [dir] [--workers N] [--store FILE] [--wait SECONDS]\n"
+            << "                                         one tick of every traveler in dir (default: fleet)\n"
+            << "       traveler sim --data <file|dir> [--state state.json] [--days 14] [--seed 1]\n"
+            << "                    [--start UTC] [--log sim_trip_log.ndjson] [--state-out PATH]\n"
+            << "                                         replay recorded departures on a virtual clock\n"
+            << "       traveler daemon [--state state.json] [--token-file PATH]\n"
+            << "                                         keep running, ticking at each next_event_utc\n"
+            << "       traveler log <query> [--dir trip_log]\n"
+            << "         hop N | airport ICAO | range FROM [TO] query the binary trip log (NDJSON out);\n"
+            << "                                         FROM/TO: 2026-03, 2026-03-14 or unix seconds\n"
+            << "         export [--out PATH] | import [--ndjson trip_log.ndjson] | compact | stats\n"
+            << "       traveler state list|export NAME|import NAME FILE [--store fleet.tstate]\n"
+            << "                                         inspect or edit a fleet state store as JSON\n"
+            << "       traveler index build [--out departure_index] DUMP.csv... ('-' = stdin)\n"
+            << "       traveler index show [ICAO FROM [TO]] [--index departure_index]\n"
+            << "                                         build or query the flight-list departure index;\n"
+            << "                                         sim, mc and graph build take it as --data\n"
+            << "       traveler graph build --data <file|dir> [--out route_graph.bin] [--complete]\n"
+            << "       traveler graph show ICAO [--graph route_graph.bin]\n"
+            << "                                         build or inspect the dead-end route graph\n"
+            << "  tick, fleet and daemon score with ./route_graph.bin when it exists (--graph PATH);\n"
+            << "  their fetches give up after --budget SECONDS (default 90, 0 = no limit).\n"
+            << "  tick and fleet exit if another run holds the state's lock, or wait --wait SECONDS for it.\n"
+            << "  sim only with --graph.\n";
 }
 
-static void writeFile(const std::string& path, const std::string& data) {
-  std::ofstream out(path, std::ios::trunc);
-  out << data;
+// Value following `flag` in argv, or `def`.
+static std::string argValue(int argc, char** argv, const std::string& flag, const std::string& def = "") {
+  for (int i = 2; i + 1 < argc; i++) {
+    if (argv[i] == flag) return argv[i + 1];
+  }
+  return def;
 }
 
-static std::string extractJsonString(const std::string& json, const std::string& key, const std::string& def="") {
-  std::string pattern = "\"" + key + "\":";
-  auto p = json.find(pattern);
-  if (p == std::string::npos) return def;
-  p += pattern.size();
-  while (p < json.size() && std::isspace((unsigned char)json[p])) p++;
-  if (p >= json.size()) return def;
-  if (json.compare(p, 4, "null") == 0) return def;
-  if (json[p] != '"') return def;
-  p++;
-  auto q = json.find('"', p);
-  if (q == std::string::npos) return def;
-  return json.substr(p, q - p);
+static std::string readToken(const std::string& path) {
+  std::string t = readFile(path);
+  while (!t.empty() && std::isspace((unsigned char)t.back())) t.pop_back();
+  return t;
 }
 
-static long extractJsonLong(const std::string& json, const std::string& key, long def=0) {
-  std::string pattern = "\"" + key + "\":";
-  auto p = json.find(pattern);
-  if (p == std::string::npos) return def;
-  p += pattern.size();
-  while (p < json.size() && std::isspace((unsigned char)json[p])) p++;
-  if (p >= json.size()) return def;
-  if (json.compare(p, 4, "null") == 0) return def;
-  size_t q = p;
-  while (q < json.size() && (std::isdigit((unsigned char)json[q]) || json[q] == '-')) q++;
-  try { return std::stol(json.substr(p, q - p)); } catch (...) { return def; }
+static double msSince(std::chrono::steady_clock::time_point t0) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
 }
 
-static int extractJsonInt(const std::string& json, const std::string& key, int def=0) {
-  return (int)extractJsonLong(json, key, def);
+// The route graph is optional: without it scoring ignores connectivity.
+static std::unique_ptr<RouteGraph> loadRouteGraph(const std::string& path) {
+  if (path.empty() || !std::filesystem::exists(path)) return nullptr;
+  try {
+    return std::make_unique<RouteGraph>(path);
+  } catch (const std::exception& e) {
+    std::cerr << "route graph: " << e.what() << "\n";
+    return nullptr;
+  }
 }
 
-static std::vector<std::string> extractRecentAirports(const std::string& json) {
-  std::vector<std::string> out;
-  std::string key = "\"recent_airports\":";
-  auto p = json.find(key);
-  if (p == std::string::npos) return out;
-  p = json.find('[', p);
-  auto q = json.find(']', p);
-  if (p == std::string::npos || q == std::string::npos || q <= p) return out;
-  std::string arr = json.substr(p + 1, q - p - 1);
-
-  size_t i = 0;
-  while (true) {
-    auto a = arr.find('"', i);
-    if (a == std::string::npos) break;
-    auto b = arr.find('"', a + 1);
-    if (b == std::string::npos) break;
-    out.push_back(arr.substr(a + 1, b - a - 1));
-    i = b + 1;
-  }
-  return out;
+static int runSingle(DepartureSource& source, const RouteGraph* routes, long now, long budgetMs, long waitMs) {
+  const std::string statePath = "state.json";
+  // One fetch and hop per state generation: an overlapping run leaves it to
+  // the one holding the lease. After --wait it ticks the state that run left
+  // (usually "not time yet"), with its departures already in the cache.
+  TickLease lease(statePath + ".lock", waitMs, [&statePath] { return stateFence(statePath); });
+  if (!lease.held()) {
+    std::cout << "NO HOP: another tick is running (" << lease.describeHolder() << ").\n";
+    return 0;
+  }
+
+  auto t0 = std::chrono::steady_clock::now();
+  long hopCount = 0;
+  TravelerState st = loadState(statePath, hopCount);
+  double loadMs = msSince(t0);
+
+  TravelerEngine engine(source, routes);
+
+  TravelerState before = st;
+  bool due = TravelerEngine::isDue(st, now);
+  auto deadline = budgetMs > 0 ? t0 + std::chrono::milliseconds(budgetMs) : std::chrono::steady_clock::time_point::max();
+  HopResult hop = engine.tick(st, now, deadline);
+  hop.metrics.stateLoadMs = loadMs;
+
+  t0 = std::chrono::steady_clock::now();
+  if (!stateIsCurrent(statePath, before, lease.token())) {
+    // Written by a run that did not take the lease (or took it after ours lapsed).
+    std::cout << "NO HOP: " << statePath << " changed during this tick; keeping the other run's hop.\n";
+    return 0;
+  }
+  if (hop.didHop) {
+    hopCount += 1;
+    writeHopOutputs("", now, before, hop, st, hopCount);
+  }
+  std::cout << describeTick(before, hop, st) << "\n";
+
+  commitState(statePath, st, hopCount, lease.token());
+  hop.metrics.stateWriteMs = msSince(t0);
+  if (due) appendTickMetrics("tick_metrics.ndjson", now, before.current_airport, hop);
+  return 0;
 }
 
-static long extractJsonHopCount(const std::string& json) {
-  return extractJsonLong(json, "hop_count", 0);
+static int runFleet(DepartureSource& source, long now, const FleetOptions& options, long waitMs) {
+  std::string lockPath = options.store.empty() ? (std::filesystem::path(options.dir) / "fleet.lock").string()
+                                               : options.store + ".lock";
+  // Without a fleet directory there is nothing to tick, and nowhere to put the lock.
+  std::unique_ptr<TickLease> lease;
+  if (!options.store.empty() || std::filesystem::is_directory(options.dir)) {
+    lease = std::make_unique<TickLease>(lockPath, waitMs);
+  }
+  if (lease && !lease->held()) {
+    std::cout << "FLEET: another run is ticking (" << lease->describeHolder() << ").\n";
+    return 0;
+  }
+
+  FleetRunner runner(source, options);
+  FleetReport r = runner.run(now);
+  std::cout << "FLEET: travelers=" << r.travelers
+            << " due=" << r.due
+            << " fetch_groups=" << r.groups
+            << " fetch_errors=" << r.fetchErrors
+            << " hops=" << r.hops
+            << " errors=" << r.errors.size()
+            << " seconds=" << r.seconds
+            << "\n";
+  for (const auto& e : r.errors) std::cout << "FLEET: skipped " << e << "\n";
+  return 0;
 }
 
-static TravelerState loadState(const std::string& path, long& hopCount) {
-  TravelerState st;
-  std::string json = readFile(path);
+static int runSim(int argc, char** argv) {
+  std::string data = argValue(argc, argv, "--data");
+  if (data.empty()) {
+    usage();
+    return 1;
+  }
 
-  st.current_airport = extractJsonString(json, "current_airport", "KCVG");
-  st.sim_time_utc    = extractJsonLong(json, "sim_time_utc", 0);
-  st.next_event_utc  = extractJsonLong(json, "next_event_utc", 0);
-  st.lag_seconds     = extractJsonLong(json, "lag_seconds", 86400);
-  st.lookback_hours  = extractJsonInt(json, "lookback_hours", 36);
-  st.avoid_recent_n  = extractJsonInt(json, "avoid_recent_n", 10);
-  st.recent_airports = extractRecentAirports(json);
+  std::unique_ptr<ReplaySource> replay = openReplay(data);
+  ReplaySource& source = *replay;
 
-  st.personality     = extractJsonString(json, "personality", "chaotic");
-  hopCount           = extractJsonHopCount(json);
+  long hopCount = 0;
+  TravelerState st = loadState(argValue(argc, argv, "--state", "state.json"), hopCount);
 
-  return st;
+  SimOptions options;
+  options.days = std::atof(argValue(argc, argv, "--days", "14").c_str());
+  options.seed = (uint32_t)std::strtoul(argValue(argc, argv, "--seed", "1").c_str(), nullptr, 10);
+  options.startUtc = std::atol(argValue(argc, argv, "--start", "0").c_str());
+  options.logPath = argValue(argc, argv, "--log", options.logPath);
+  std::unique_ptr<RouteGraph> routes = loadRouteGraph(argValue(argc, argv, "--graph"));
+  options.routes = routes.get();
+  if (options.startUtc == 0 && st.sim_time_utc == 0) {
+    // Fresh state: begin where the recording begins.
+    options.startUtc = source.earliestDeparture() + st.lag_seconds;
+  }
+
+  SimReport r = runSimulation(source, st, hopCount, options);
+
+  std::string stateOut = argValue(argc, argv, "--state-out");
+  if (!stateOut.empty()) writeFile(stateOut, toJson(st, hopCount));
+
+  std::cout << "SIM: flights=" << source.flightCount()
+            << " story_days=" << (r.endUtc - r.startUtc) / 86400.0
+            << " ticks=" << r.ticks
+            << " hops=" << r.hops
+            << " source_calls=" << source.calls()
+            << " wall_seconds=" << r.wallSeconds
+            << " ticks_per_sec=" << r.ticksPerSec
+            << " hops_per_sec=" << r.hopsPerSec
+            << " final_airport=" << st.current_airport
+            << "\n";
+  return 0;
 }
 
-static std::string toJson(const TravelerState& st, long hopCount) {
-  std::ostringstream o;
-  o << "{\n";
-  o << "  \"current_airport\": \"" << st.current_airport << "\",\n";
-  o << "  \"sim_time_utc\": " << st.sim_time_utc << ",\n";
-  o << "  \"next_event_utc\": " << st.next_event_utc << ",\n";
-  o << "  \"lag_seconds\": " << st.lag_seconds << ",\n";
-  o << "  \"lookback_hours\": " << st.lookback_hours << ",\n";
-  o << "  \"avoid_recent_n\": " << st.avoid_recent_n << ",\n";
-  o << "  \"hop_count\": " << hopCount << ",\n";
-  o << "  \"personality\": \"" << st.personality << "\",\n";
-  o << "  \"recent_airports\": [";
-  for (size_t i = 0; i < st.recent_airports.size(); i++) {
-    o << "\"" << st.recent_airports[i] << "\"";
-    if (i + 1 < st.recent_airports.size()) o << ", ";
-  }
-  o << "]\n";
-  o << "}\n";
-  return o.str();
+static int runMc(int argc, char** argv) {
+  std::string data = argValue(argc, argv, "--data");
+  if (data.empty()) {
+    usage();
+    return 1;
+  }
+
+  std::vector<ParamSet> sets;
+  try {
+    for (int i = 2; i + 1 < argc; i++) {
+      if (std::string(argv[i]) == "--set") sets.push_back(parseParamSet(argv[++i]));
+    }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  if (sets.empty()) sets = personalityParamSets();
+
+  std::unique_ptr<ReplaySource> source = openReplay(data);
+  long hopCount = 0;
+  TravelerState st = loadState(argValue(argc, argv, "--state", "state.json"), hopCount);
+
+  MonteCarloOptions options;
+  options.runs = std::atoi(argValue(argc, argv, "--runs", "1000").c_str());
+  options.threads = std::atoi(argValue(argc, argv, "--threads", "0").c_str());
+  options.days = std::atof(argValue(argc, argv, "--days", "14").c_str());
+  options.seed = (uint32_t)std::strtoul(argValue(argc, argv, "--seed", "1").c_str(), nullptr, 10);
+  options.startUtc = std::atol(argValue(argc, argv, "--start", "0").c_str());
+  std::unique_ptr<RouteGraph> routes = loadRouteGraph(argValue(argc, argv, "--graph"));
+  options.routes = routes.get();
+  if (options.startUtc == 0 && st.sim_time_utc == 0) {
+    options.startUtc = source->earliestDeparture() + st.lag_seconds;
+  }
+
+  MonteCarloReport r = runMonteCarlo(*source, st, sets, options);
+  for (const auto& set : r.sets) std::cout << paramSetReportJson(set, options.days) << "\n";
+  std::cout << "MC: sets=" << r.sets.size()
+            << " journeys=" << r.journeys
+            << " threads=" << r.threads
+            << " ticks=" << r.ticks
+            << " wall_seconds=" << r.wallSeconds
+            << " journeys_per_sec=" << r.journeysPerSec
+            << " ticks_per_sec=" << r.ticksPerSec
+            << "\n";
+  return 0;
 }
 
-static void appendLogNdjson(const std::string& path,
-                            long loggedAtUtc,
-                            const TravelerState& before,
-                            const HopResult& hop,
-                            const TravelerState& after,
-                            long hopNumber) {
-  std::ofstream out(path, std::ios::app);
-  out << "{";
-  out << "\"hop\":" << hopNumber << ",";
-  out << "\"logged_at_utc\":" << loggedAtUtc << ",";
-  out << "\"from\":\"" << before.current_airport << "\",";
-  out << "\"to\":\"" << after.current_airport << "\",";
-  out << "\"depart_utc\":" << hop.depart_utc << ",";
-  out << "\"arrive_utc\":" << hop.arrive_utc << ",";
-  out << "\"icao24\":\"" << hop.flight.icao24 << "\",";
-  out << "\"callsign\":\"" << hop.flight.callsign << "\",";
-  out << "\"reason\":\"" << hop.reason << "\"";
-  out << "}\n";
+static int runLog(int argc, char** argv) {
+  std::string cmd = argc > 2 ? argv[2] : "";
+  std::string arg = argc > 3 ? argv[3] : "";
+  TripLog log(argValue(argc, argv, "--dir", "trip_log"));
+
+  auto t0 = std::chrono::steady_clock::now();
+  std::vector<TripRecord> rows;
+  if (cmd == "hop" && !arg.empty()) {
+    if (auto r = log.findHop(std::atol(arg.c_str()))) rows.push_back(*r);
+  } else if (cmd == "airport" && !arg.empty()) {
+    rows = log.throughAirport(arg);
+  } else if (cmd == "range" && !arg.empty()) {
+    long begin = 0, end = 0, toBegin = 0;
+    std::string to = argc > 4 && argv[4][0] != '-' ? argv[4] : "";
+    if (!parseUtcPeriod(arg, begin, end) || (!to.empty() && !parseUtcPeriod(to, toBegin, end))) {
+      usage();
+      return 1;
+    }
+    rows = log.departedBetween(begin, end);
+  } else if (cmd == "export") {
+    std::string out = argValue(argc, argv, "--out");
+    std::ofstream file;
+    if (!out.empty()) file.open(out, std::ios::trunc);
+    std::ostream& o = out.empty() ? std::cout : file;
+    log.forEach([&o](const TripRecord& r) { o << tripRecordJson(r) << "\n"; });
+    return 0;
+  } else if (cmd == "import") {
+    size_t n = importTripNdjson(log, argValue(argc, argv, "--ndjson", "trip_log.ndjson"));
+    std::cout << "LOG: imported=" << n << " hops=" << log.hopCount() << "\n";
+    return 0;
+  } else if (cmd == "compact") {
+    CompactReport r = log.compact();
+    std::cout << "LOG: segments " << r.segmentsBefore << " -> " << r.segmentsAfter << "\n";
+    return 0;
+  } else if (cmd == "stats") {
+    std::cout << "LOG: hops=" << log.hopCount() << " last_hop=" << log.lastHop()
+              << " segments=" << log.segmentCount() << "\n";
+    return 0;
+  } else {
+    usage();
+    return 1;
+  }
+
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+  for (const auto& r : rows) std::cout << tripRecordJson(r) << "\n";
+  std::cerr << rows.size() << " hops in " << ms << " ms\n";
+  return 0;
 }
 
-static std::string formatUtc(long t) {
-  std::time_t tt = (std::time_t)t;
-  std::tm g{};
-#if defined(_WIN32)
-  gmtime_s(&g, &tt);
-#else
-  g = *std::gmtime(&tt);
-#endif
-  char buf[64];
-  std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M UTC", &g);
-  return std::string(buf);
+static int runStateStore(int argc, char** argv) {
+  std::string cmd = argc > 2 ? argv[2] : "";
+  StateStore store(argValue(argc, argv, "--store", "fleet.tstate"));
+  long hopCount = 0;
+  TravelerState st;
+
+  if (cmd == "list") {
+    for (const auto& name : store.names()) {
+      store.load(name, st, hopCount);
+      std::cout << name << " " << st.current_airport << " hops=" << hopCount
+                << " next_event_utc=" << st.next_event_utc << "\n";
+    }
+    return 0;
+  }
+  if (cmd == "export" && argc > 3) {
+    if (!store.load(argv[3], st, hopCount)) {
+      std::cout << "No traveler " << argv[3] << "\n";
+      return 1;
+    }
+    std::cout << toJson(st, hopCount);
+    return 0;
+  }
+  if (cmd == "import" && argc > 4) {
+    st = loadState(argv[4], hopCount);
+    store.save(argv[3], st, hopCount);
+    return 0;
+  }
+  usage();
+  return 1;
 }
 
-static void writeLatestCaption(const std::string& from,
-                               const std::string& to,
-                               long hopNumber,
-                               long departUtc,
-                               long arriveUtc,
-                               const std::string& callsign,
-                               const std::string& personality,
-                               const std::string& vibeLine) {
-  std::ostringstream c;
-  c << "Hop #" << hopNumber << " ✈️\n";
-  c << from << " → " << to << "\n";
-  if (!callsign.empty()) c << "Flight: " << callsign << "\n";
-  c << "Depart: " << formatUtc(departUtc) << "\n";
-  c << "Arrive: " << formatUtc(arriveUtc) << "\n\n";
-  c << "Personality: " << personality << "\n";
-  c << vibeLine << "\n\n";
-  c << "#airport #travel #aviation #wanderlust #planespotting\n";
-  writeFile("latest_caption.txt", c.str());
+static int runIndex(int argc, char** argv) {
+  std::string cmd = argc > 2 ? argv[2] : "";
+  if (cmd == "build") {
+    std::vector<std::string> dumps;
+    for (int i = 3; i < argc; i++) {
+      if (std::string(argv[i]) == "--out") i++;
+      else dumps.push_back(argv[i]);
+    }
+    if (dumps.empty()) {
+      usage();
+      return 1;
+    }
+    std::string out = argValue(argc, argv, "--out", "departure_index");
+    auto t0 = std::chrono::steady_clock::now();
+    DepartureIndexSummary s;
+    try {
+      s = buildDepartureIndex(dumps, out);
+    } catch (const std::exception& e) {
+      std::cerr << e.what() << "\n";
+      return 1;
+    }
+    std::cout << "INDEX: " << out << " rows=" << s.rows << " skipped=" << s.skipped
+              << " partitions=" << s.partitions << " flights=" << s.flights
+              << " seconds=" << msSince(t0) / 1000.0 << "\n";
+    return 0;
+  }
+  if (cmd == "show") {
+    auto t0 = std::chrono::steady_clock::now();
+    DepartureIndex index(argValue(argc, argv, "--index", "departure_index"));
+    double openMs = msSince(t0);
+    std::string airport = argc > 3 && argv[3][0] != '-' ? argv[3] : "";
+    if (airport.empty()) {
+      for (const auto& p : index.partitions()) {
+        std::cout << p.path << " from=" << p.beginUtc << " to=" << p.endUtc
+                  << " airports=" << p.airports << " flights=" << p.flights << "\n";
+      }
+      std::cout << "INDEX: flights=" << index.flightCount() << " earliest=" << index.earliestDeparture()
+                << " latest=" << index.latestDeparture() << " open_ms=" << openMs << "\n";
+      return 0;
+    }
+
+    // ICAO FROM [TO], as the log range query: departures as NDJSON.
+    long from = 0, to = 0, toBegin = 0;
+    if (argc <= 4 || !parseUtcPeriod(argv[4], from, to) ||
+        (argc > 5 && argv[5][0] != '-' && !parseUtcPeriod(argv[5], toBegin, to))) {
+      usage();
+      return 1;
+    }
+    t0 = std::chrono::steady_clock::now();
+    std::vector<DepartureIndex::Run> runs = index.runs(airport, from, to);
+    double queryUs = msSince(t0) * 1000.0;
+    size_t n = 0;
+    for (const auto& run : runs) {
+      for (const IndexedFlight* f = run.begin; f != run.end; ++f, ++n) {
+        Flight flight;
+        flight.icao24 = f->icao24;
+        std::memcpy(flight.callsign, f->callsign, sizeof(flight.callsign));
+        std::cout << "{\"icao24\":\"" << flight.icao24Hex() << "\","
+                  << "\"callsign\":\"" << flight.callsignStr() << "\","
+                  << "\"estDepartureAirport\":\"" << airport << "\","
+                  << "\"estArrivalAirport\":\"" << run.arrival(*f) << "\","
+                  << "\"firstSeen\":" << f->firstSeen << ","
+                  << "\"lastSeen\":" << f->lastSeen << "}\n";
+      }
+    }
+    std::cerr << "INDEX: " << airport << " departures=" << n << " open_ms=" << openMs
+              << " query_us=" << queryUs << "\n";
+    return 0;
+  }
+  usage();
+  return 1;
 }
 
-static void writeLatestPostJson(const TravelerState& before,
-                                const TravelerState& after,
-                                const HopResult& hop,
-                                long hopNumber) {
-  std::ostringstream j;
-  j << "{\n";
-  j << "  \"hop\": " << hopNumber << ",\n";
-  j << "  \"from\": \"" << before.current_airport << "\",\n";
-  j << "  \"to\": \"" << after.current_airport << "\",\n";
-  j << "  \"depart_utc\": " << hop.depart_utc << ",\n";
-  j << "  \"arrive_utc\": " << hop.arrive_utc << ",\n";
-  j << "  \"icao24\": \"" << hop.flight.icao24 << "\",\n";
-  j << "  \"callsign\": \"" << hop.flight.callsign << "\",\n";
-  j << "  \"reason\": \"" << hop.reason << "\"\n";
-  j << "}\n";
-  writeFile("latest_post.json", j.str());
+static int runGraph(int argc, char** argv) {
+  std::string cmd = argc > 2 ? argv[2] : "";
+  if (cmd == "build") {
+    std::string data = argValue(argc, argv, "--data");
+    if (data.empty()) {
+      usage();
+      return 1;
+    }
+    bool complete = false;
+    for (int i = 3; i < argc; i++) complete = complete || std::string(argv[i]) == "--complete";
+    std::string out = argValue(argc, argv, "--out", "route_graph.bin");
+    std::unique_ptr<ReplaySource> recording = openReplay(data);
+    RouteGraphSummary s = buildRouteGraph(*recording, out, complete);
+    std::cout << "GRAPH: " << out << " nodes=" << s.nodes << " edges=" << s.edges
+              << " flights=" << s.flights << " days=" << s.days << "\n";
+    return 0;
+  }
+  if (cmd == "show" && argc > 3) {
+    RouteGraph g(argValue(argc, argv, "--graph", "route_graph.bin"));
+    long n = g.node(argv[3]);
+    if (n < 0) {
+      std::cout << argv[3] << " is not in the graph\n";
+      return 1;
+    }
+    RouteGraph::Edges e = g.edges((uint32_t)n);
+    std::cout << argv[3] << " departures_per_day=" << g.outboundPerDay((uint32_t)n)
+              << " sink=" << g.sink(AirportDict::find(argv[3])) << " destinations=" << e.size << "\n";
+    for (size_t i = 0; i < e.size && i < 10; i++) {
+      std::cout << "  " << g.code(e.targets[i]) << " " << e.counts[i] << "\n";
+    }
+    return 0;
+  }
+  usage();
+  return 1;
 }
 
-int main() {
+int main(int argc, char** argv) {
   long now = nowUtc();
 
-  long hopCount = 0;
-  TravelerState st = loadState("state.json", hopCount);
-
-  const char* token = std::getenv("OPENSKY_TOKEN");
-  if (!token || std::string(token).empty()) {
-    std::cout << "NO HOP: Missing OPENSKY_TOKEN env var.\n";
+  std::string mode = argc > 1 ? argv[1] : "tick";
+  if (mode == "-h" || mode == "--help") {
+    usage();
     return 0;
   }
 
-  OpenSkyClient client(token);
-  TravelerEngine engine(client);
-
-  TravelerState before = st;
-  HopResult hop = engine.tick(st, now);
+  // `tick` is optional, also with flags (`traveler --wait 30`): put it back so
+  // every parser below can keep reading its flags from argv[2] on.
+  static char tickMode[] = "tick";
+  std::vector<char*> args(argv, argv + argc);
+  if (mode.rfind("--", 0) == 0) {
+    args.insert(args.begin() + 1, tickMode);
+    mode = "tick";
+    argc = (int)args.size();
+    argv = args.data();
+  }
 
-  if (hop.didHop) {
-    hopCount += 1;
-    appendLogNdjson("trip_log.ndjson", now, before, hop, st, hopCount);
+  if (mode == "sim") return runSim(argc, argv);
+  if (mode == "mc") return runMc(argc, argv);
+  if (mode == "log") return runLog(argc, argv);
+  if (mode == "state") return runStateStore(argc, argv);
+  if (mode == "index") return runIndex(argc, argv);
+  if (mode == "graph") return runGraph(argc, argv);
 
-    std::string vibe;
-    if (st.personality == "chaotic") vibe = "Current mood: unhinged boarding pass energy.";
-    else if (st.personality == "budget") vibe = "Current mood: saving money like it’s a sport.";
-    else if (st.personality == "scenic") vibe = "Current mood: window seat supremacy.";
-    else vibe = "Current mood: gate snacks + main character energy.";
+  std::unique_ptr<RouteGraph> routes = loadRouteGraph(argValue(argc, argv, "--graph", "route_graph.bin"));
 
-    writeLatestCaption(before.current_airport, st.current_airport, hopCount,
-                       hop.depart_utc, hop.arrive_utc, hop.flight.callsign,
-                       st.personality, vibe);
+  long budgetMs = (long)(std::atof(argValue(argc, argv, "--budget", "90").c_str()) * 1000);
+  long waitMs = (long)(std::atof(argValue(argc, argv, "--wait", "0").c_str()) * 1000);
 
-    writeLatestPostJson(before, st, hop, hopCount);
+  FleetOptions fleet;
+  fleet.routes = routes.get();
+  fleet.tickBudgetMs = budgetMs;
+  for (int i = 2; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--workers" && i + 1 < argc) fleet.workers = (unsigned)std::atoi(argv[++i]);
+    else if (arg == "--store" && i + 1 < argc) fleet.store = argv[++i];
+    else if ((arg == "--graph" || arg == "--budget" || arg == "--wait") && i + 1 < argc) ++i;
+    else fleet.dir = arg;
+  }
 
-    std::cout << "HOP: " << before.current_airport << " -> " << st.current_airport
-              << " depart=" << hop.depart_utc
-              << " arrive=" << hop.arrive_utc
-              << " next_event_utc=" << st.next_event_utc
-              << "\n";
-  } else {
-    std::cout << "NO HOP: " << hop.reason
-              << " next_event_utc=" << st.next_event_utc
-              << " sim_time_utc=" << st.sim_time_utc
-              << "\n";
+  // A daemon outlives the OAuth token, so it can read it from a file that an
+  // external refresher keeps current.
+  std::string tokenFile = mode == "daemon" ? argValue(argc, argv, "--token-file") : "";
+  const char* envToken = std::getenv("OPENSKY_TOKEN");
+  std::string token = tokenFile.empty() ? (envToken ? envToken : "") : readToken(tokenFile);
+  if (token.empty()) {
+    std::cout << "NO HOP: Missing OPENSKY_TOKEN env var.\n";
+    return 0;
   }
 
-  writeFile("state.json", toJson(st, hopCount));
-  return 0;
-}
\ No newline at end of file
+  OpenSkyClient client(token);
+  // Only cache misses reach the scheduler, so only they are charged to the quota.
+  QuotaOptions quota;
+  quota.statePath = "opensky_quota.json";
+  quota.serverRemaining = [&client] { return client.stats().creditsRemaining; };
+  QuotaScheduler scheduler(client, quota);
+  DepartureCache cache(scheduler, "departure_cache");
+
+  if (mode == "fleet") return runFleet(cache, now, fleet, waitMs);
+  if (mode == "daemon") {
+    DaemonOptions options;
+    options.statePath = argValue(argc, argv, "--state", options.statePath);
+    options.routes = routes.get();
+    options.tickBudgetMs = budgetMs;
+    if (!tokenFile.empty()) {
+      options.beforeTick = [&client, &token, tokenFile] {
+        std::string fresh = readToken(tokenFile);
+        if (!fresh.empty() && fresh != token) {
+          client.setBearerToken(fresh);
+          token = fresh;
+        }
+      };
+    }
+    // Fetches the next airport's departures while the traveler is in the air.
+    PrefetchingSource prefetcher(cache);
+    runDaemon(prefetcher, options);
+    return 0;
+  }
+  if (mode != "tick") {
+    usage();
+    return 1;
+  }
+  return runSingle(cache, routes.get(), now, budgetMs, waitMs);
+}
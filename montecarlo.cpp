@@ -0,0 +1,215 @@
+#include "montecarlo.h"
+#include "recorded_source.h"
+#include "simulation.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+// A thread's view of the shared recording, with its own call counter.
+class ReplayView : public DepartureSource {
+ public:
+  explicit ReplayView(const ReplaySource& recording) : recording_(recording) {}
+
+  std::vector<Flight> getDepartures(const std::string& airportIcao, long beginUtc, long endUtc) override {
+    calls++;
+    return recording_.window(airportIcao, beginUtc, endUtc);
+  }
+
+  long calls = 0;
+
+ private:
+  const ReplaySource& recording_;
+};
+
+struct Journey {
+  size_t set = 0;
+  double hopsPerDay = 0;
+  double strandedHours = 0;
+  double airports = 0;
+  double apiCalls = 0;
+  long ticks = 0;
+};
+
+double parseNumber(const std::string& key, const std::string& value) {
+  char* end = nullptr;
+  double v = std::strtod(value.c_str(), &end);
+  if (value.empty() || *end != '\0') throw std::runtime_error("Bad number for " + key + ": " + value);
+  return v;
+}
+
+Distribution summarise(std::vector<double> v) {
+  Distribution d;
+  if (v.empty()) return d;
+  std::sort(v.begin(), v.end());
+  double sum = 0;
+  for (double x : v) sum += x;
+  d.mean = sum / (double)v.size();
+  auto rank = [&v](double q) { return v[std::min(v.size() - 1, (size_t)(q * (double)v.size()))]; };
+  d.p10 = rank(0.10);
+  d.p50 = rank(0.50);
+  d.p90 = rank(0.90);
+  return d;
+}
+
+void writeDistribution(std::ostream& o, const char* name, const Distribution& d) {
+  o << ",\"" << name << "\":{\"mean\":" << d.mean << ",\"p10\":" << d.p10 << ",\"p50\":" << d.p50
+    << ",\"p90\":" << d.p90 << "}";
+}
+
+} // namespace
+
+ParamSet parseParamSet(const std::string& spec) {
+  std::vector<std::pair<std::string, std::string>> fields;
+  std::stringstream in(spec);
+  std::string item;
+  while (std::getline(in, item, ',')) {
+    if (item.empty()) continue;
+    size_t eq = item.find('=');
+    if (eq == std::string::npos) throw std::runtime_error("Expected key=value in parameter set: " + item);
+    fields.emplace_back(item.substr(0, eq), item.substr(eq + 1));
+  }
+
+  // The personality goes first: its weights are the base the others override.
+  ParamSet set;
+  for (const auto& [key, value] : fields) {
+    if (key == "personality") set.personality = value;
+  }
+  set.params = scoringParams(parsePersonality(set.personality));
+  set.name = set.personality;
+
+  for (const auto& [key, value] : fields) {
+    if (key == "personality") continue;
+    if (key == "name") set.name = value;
+    else if (key == "novel") set.params.wNovel = parseNumber(key, value);
+    else if (key == "short") set.params.wShort = parseNumber(key, value);
+    else if (key == "long") set.params.wLong = parseNumber(key, value);
+    else if (key == "jitter") set.params.wJit = parseNumber(key, value);
+    else if (key == "sink") set.params.wSink = parseNumber(key, value);
+    else if (key == "far") set.params.wFar = parseNumber(key, value);
+    else if (key == "hub") set.params.wHub = parseNumber(key, value);
+    else if (key == "explore") set.params.exploreRate = parseNumber(key, value);
+    else if (key == "topn") set.params.exploreTopN = (int)parseNumber(key, value);
+    else throw std::runtime_error("Unknown parameter: " + key);
+  }
+  return set;
+}
+
+std::vector<ParamSet> personalityParamSets() {
+  std::vector<ParamSet> sets;
+  for (const char* name : {"chaotic", "budget", "scenic", "explorer"}) {
+    ParamSet set;
+    set.name = name;
+    set.personality = name;
+    set.params = scoringParams(parsePersonality(name));
+    sets.push_back(set);
+  }
+  return sets;
+}
+
+MonteCarloReport runMonteCarlo(const ReplaySource& recording,
+                               const TravelerState& start,
+                               const std::vector<ParamSet>& sets,
+                               const MonteCarloOptions& options) {
+  MonteCarloReport report;
+  size_t runs = (size_t)std::max(0, options.runs);
+  size_t total = sets.size() * runs;
+  int threads = options.threads > 0 ? options.threads : (int)std::max(1u, std::thread::hardware_concurrency());
+  threads = (int)std::min<size_t>((size_t)threads, std::max<size_t>(1, total));
+  report.threads = threads;
+
+  // Journey j is set j / runs, run j % runs. Threads take every threads-th
+  // journey and keep their results to themselves until joined.
+  std::vector<std::vector<Journey>> results((size_t)threads);
+  auto worker = [&](size_t t) {
+    ReplayView view(recording);
+    std::vector<Journey>& out = results[t];
+    for (size_t j = t; j < total; j += (size_t)threads) {
+      const ParamSet& set = sets[j / runs];
+      TravelerState st = start;
+      st.personality = set.personality;
+      long hopCount = 0;
+
+      SimOptions sim;
+      sim.days = options.days;
+      sim.seed = options.seed + (uint32_t)(j % runs);
+      sim.startUtc = options.startUtc;
+      sim.logPath.clear();
+      sim.routes = options.routes;
+      sim.scoring = &set.params;
+
+      long callsBefore = view.calls;
+      SimReport r = runSimulation(view, st, hopCount, sim);
+
+      Journey journey;
+      journey.set = j / runs;
+      journey.hopsPerDay = options.days > 0 ? (double)r.hops / options.days : 0;
+      journey.strandedHours = r.strandedHours;
+      journey.airports = (double)r.airports;
+      journey.apiCalls = (double)(view.calls - callsBefore);
+      journey.ticks = r.ticks;
+      out.push_back(journey);
+    }
+  };
+
+  auto t0 = std::chrono::steady_clock::now();
+  std::vector<std::thread> pool;
+  for (int t = 1; t < threads; t++) pool.emplace_back(worker, (size_t)t);
+  worker(0);
+  for (auto& th : pool) th.join();
+  report.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+  std::vector<std::vector<Journey>> bySet(sets.size());
+  for (const auto& list : results) {
+    for (const Journey& j : list) {
+      bySet[j.set].push_back(j);
+      report.ticks += j.ticks;
+      report.journeys++;
+    }
+  }
+  for (size_t s = 0; s < sets.size(); s++) {
+    ParamSetReport r;
+    r.set = sets[s];
+    r.runs = (long)bySet[s].size();
+    std::vector<double> hops, stranded, airports, calls;
+    for (const Journey& j : bySet[s]) {
+      hops.push_back(j.hopsPerDay);
+      stranded.push_back(j.strandedHours);
+      airports.push_back(j.airports);
+      calls.push_back(j.apiCalls);
+    }
+    r.hopsPerDay = summarise(std::move(hops));
+    r.strandedHours = summarise(std::move(stranded));
+    r.airports = summarise(std::move(airports));
+    r.apiCalls = summarise(std::move(calls));
+    report.sets.push_back(r);
+  }
+  if (report.wallSeconds > 0) {
+    report.journeysPerSec = (double)report.journeys / report.wallSeconds;
+    report.ticksPerSec = (double)report.ticks / report.wallSeconds;
+  }
+  return report;
+}
+
+std::string paramSetReportJson(const ParamSetReport& r, double days) {
+  const ScoringParams& p = r.set.params;
+  std::ostringstream o;
+  o.setf(std::ios::fixed);
+  o.precision(3);
+  o << "{\"set\":\"" << r.set.name << "\",\"personality\":\"" << r.set.personality << "\""
+    << ",\"runs\":" << r.runs << ",\"days\":" << days
+    << ",\"params\":{\"novel\":" << p.wNovel << ",\"short\":" << p.wShort << ",\"long\":" << p.wLong
+    << ",\"jitter\":" << p.wJit << ",\"sink\":" << p.wSink << ",\"far\":" << p.wFar << ",\"hub\":" << p.wHub << ",\"explore\":" << p.exploreRate
+    << ",\"topn\":" << p.exploreTopN << "}";
+  writeDistribution(o, "hops_per_day", r.hopsPerDay);
+  writeDistribution(o, "stranded_hours", r.strandedHours);
+  writeDistribution(o, "airports", r.airports);
+  writeDistribution(o, "api_calls", r.apiCalls);
+  o << "}";
+  return o.str();
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "scoring.h"
+#include "traveler.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Monte Carlo evaluation of scoring parameters: thousands of independent
+// simulated journeys per parameter set over a local recording, spread across
+// threads. Each thread owns its engines, states and call counters; the only
+// shared data is the read-only recording (and route graph).
+
+class ReplaySource;
+class RouteGraph;
+
+struct ParamSet {
+  std::string name;
+  std::string personality = "chaotic"; // still decides novelty rules (explorer = lifetime)
+  ScoringParams params;
+};
+
+// "name=x,personality=budget,novel=0.5,short=0.6,long=0,jitter=0.08,sink=0.4,
+// far=0,hub=0.2,explore=0.1,topn=5". Weights not given are the personality's own; throws
+// std::runtime_error on an unknown key or bad number.
+ParamSet parseParamSet(const std::string& spec);
+
+// One set per personality, with its built-in weights.
+std::vector<ParamSet> personalityParamSets();
+
+struct MonteCarloOptions {
+  int runs = 1000;          // journeys per parameter set
+  int threads = 0;          // 0 = one per core
+  double days = 14;         // virtual time per journey
+  uint32_t seed = 1;        // journey i is seeded seed + i in every set, so sets see the same draws
+  long startUtc = 0;        // as SimOptions::startUtc
+  const RouteGraph* routes = nullptr;
+};
+
+struct Distribution {
+  double mean = 0;
+  double p10 = 0;
+  double p50 = 0;
+  double p90 = 0;
+};
+
+struct ParamSetReport {
+  ParamSet set;
+  long runs = 0;
+  Distribution hopsPerDay;
+  Distribution strandedHours;
+  Distribution airports;    // distinct airports visited
+  Distribution apiCalls;    // departure window requests
+};
+
+struct MonteCarloReport {
+  std::vector<ParamSetReport> sets;
+  long journeys = 0;
+  long ticks = 0;
+  int threads = 0;
+  double wallSeconds = 0;
+  double journeysPerSec = 0;
+  double ticksPerSec = 0;
+};
+
+MonteCarloReport runMonteCarlo(const ReplaySource& recording,
+                               const TravelerState& start,
+                               const std::vector<ParamSet>& sets,
+                               const MonteCarloOptions& options);
+
+// One JSON line per parameter set.
+std::string paramSetReportJson(const ParamSetReport& r, double days);
@@ -1,141 +1,515 @@
 #include "opensky_client.h"
+#include "departure_parser.h"
 
 #include <curl/curl.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <map>
 #include <stdexcept>
 #include <sstream>
-#include <cctype>
+#include <mutex>
 #include <utility>
 
+// Body bytes of a 200 are handed to the caller as they arrive; anything else is
+// kept (bounded) for the error message. The callbacks run inside libcurl's C
+// frames, so nothing may be thrown through them: a failure is parked in `error`,
+// the transfer aborted, and finishTransfer() rethrows it.
+struct BodyContext {
+  CURL* curl = nullptr;
+  const std::function<void(const char*, size_t)>* onBody = nullptr;
+  long status = 0;
+  std::string errorBody;
+  size_t bytes = 0;
+  long retryAfterSeconds = 0;
+  long creditsRemaining = -1;
+  std::exception_ptr error;
+};
+
 static size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp) {
   size_t total = size * nmemb;
-  std::string* s = static_cast<std::string*>(userp);
-  s->append(static_cast<char*>(contents), total);
+  BodyContext* ctx = static_cast<BodyContext*>(userp);
+  if (ctx->status == 0) curl_easy_getinfo(ctx->curl, CURLINFO_RESPONSE_CODE, &ctx->status);
+  ctx->bytes += total;
+  try {
+    if (ctx->status == 200) {
+      (*ctx->onBody)(static_cast<char*>(contents), total);
+    } else if (ctx->errorBody.size() < 4096) {
+      ctx->errorBody.append(static_cast<char*>(contents), std::min<size_t>(total, 4096));
+    }
+  } catch (...) {
+    ctx->error = std::current_exception();
+    return 0; // CURLE_WRITE_ERROR
+  }
+  return total;
+}
+
+// Rate-limit headers: OpenSky sends X-Rate-Limit-Remaining on every response and
+// X-Rate-Limit-Retry-After-Seconds on a 429; plain Retry-After is honoured too.
+static size_t HeaderCallback(char* buffer, size_t size, size_t nitems, void* userp) {
+  size_t total = size * nitems;
+  BodyContext* ctx = static_cast<BodyContext*>(userp);
+  std::string_view line(buffer, total);
+  size_t colon = line.find(':');
+  if (colon == std::string_view::npos) return total;
+
+  std::string_view rawName = line.substr(0, colon);
+  std::string_view rawValue = line.substr(colon + 1);
+  // Fixed buffers, so nothing here can throw (see BodyContext).
+  char lower[40] = {};
+  if (rawName.size() >= sizeof(lower)) return total;
+  for (size_t i = 0; i < rawName.size(); i++) lower[i] = (char)std::tolower((unsigned char)rawName[i]);
+  std::string_view name(lower, rawName.size());
+  char digits[24] = {};
+  rawValue.copy(digits, std::min(rawValue.size(), sizeof(digits) - 1));
+  long value = std::strtol(digits, nullptr, 10);
+  if (name == "x-rate-limit-retry-after-seconds" || (name == "retry-after" && ctx->retryAfterSeconds == 0)) {
+    ctx->retryAfterSeconds = std::max(0L, value);
+  } else if (name == "x-rate-limit-remaining") {
+    ctx->creditsRemaining = std::max(0L, value);
+  }
   return total;
 }
 
-OpenSkyClient::OpenSkyClient(std::string bearerToken)
-  : bearerToken_(std::move(bearerToken)) {}
+// ---- transport: pooled easy handles over one shared connection/DNS/TLS cache ----
+struct OpenSkyClient::Transport {
+  CURLSH* share = nullptr;
+  std::mutex shareLocks[CURL_LOCK_DATA_LAST];
+
+  mutable std::mutex mu;
+  std::vector<CURL*> idle;
+  // Swapped whole by setBearerToken(); requests in flight keep their copy alive.
+  std::shared_ptr<curl_slist> headers;
+  TransferStats stats;
+
+  static void lock(CURL*, curl_lock_data data, curl_lock_access, void* userp) {
+    static_cast<Transport*>(userp)->shareLocks[data].lock();
+  }
+  static void unlock(CURL*, curl_lock_data data, void* userp) {
+    static_cast<Transport*>(userp)->shareLocks[data].unlock();
+  }
+};
+
+static void globalInitOnce() {
+  static std::once_flag once;
+  std::call_once(once, [] { curl_global_init(CURL_GLOBAL_DEFAULT); });
+}
 
-std::string OpenSkyClient::httpGet(const std::string& url) {
-  CURL* curl = curl_easy_init();
-  if (!curl) throw std::runtime_error("curl_easy_init failed");
+OpenSkyClient::OpenSkyClient(std::string bearerToken, OpenSkyOptions options)
+  : bearerToken_(std::move(bearerToken)),
+    options_(std::move(options)),
+    transport_(std::make_unique<Transport>()) {
+  globalInitOnce();
 
-  std::string response;
+  Transport& t = *transport_;
+  t.share = curl_share_init();
+  if (!t.share) throw std::runtime_error("curl_share_init failed");
+  curl_share_setopt(t.share, CURLSHOPT_LOCKFUNC, &Transport::lock);
+  curl_share_setopt(t.share, CURLSHOPT_UNLOCKFUNC, &Transport::unlock);
+  curl_share_setopt(t.share, CURLSHOPT_USERDATA, &t);
+  curl_share_setopt(t.share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+  curl_share_setopt(t.share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+  curl_share_setopt(t.share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
 
-  curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-  curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-  curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+  setBearerToken(bearerToken_);
+}
 
-  struct curl_slist* headers = nullptr;
-  if (!bearerToken_.empty()) {
-    std::string auth = "Authorization: Bearer " + bearerToken_;
-    headers = curl_slist_append(headers, auth.c_str());
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+void OpenSkyClient::setBearerToken(std::string bearerToken) {
+  std::shared_ptr<curl_slist> headers;
+  if (!bearerToken.empty()) {
+    std::string auth = "Authorization: Bearer " + bearerToken;
+    headers.reset(curl_slist_append(nullptr, auth.c_str()), curl_slist_free_all);
+    if (!headers) throw std::runtime_error("curl_slist_append failed");
   }
+  std::lock_guard<std::mutex> lock(transport_->mu);
+  bearerToken_ = std::move(bearerToken);
+  transport_->headers = std::move(headers);
+}
+
+OpenSkyClient::~OpenSkyClient() {
+  Transport& t = *transport_;
+  for (CURL* h : t.idle) curl_easy_cleanup(h);
+  if (t.share) curl_share_cleanup(t.share);
+}
+
+TransferStats OpenSkyClient::stats() const {
+  std::lock_guard<std::mutex> lock(transport_->mu);
+  return transport_->stats;
+}
+
+struct OpenSkyClient::Transfer {
+  CURL* curl = nullptr;
+  std::string url;
+  std::function<void(const char*, size_t)> onBody;
+  std::shared_ptr<curl_slist> headers; // kept alive while the handle points at it
+  BodyContext body;
+  bool deadlineBound = false;          // the fetch deadline, not timeoutMs, limits it
+
+  Transfer() = default;
+  Transfer(const Transfer&) = delete;
+  Transfer& operator=(const Transfer&) = delete;
+  // finishTransfer()/abandonTransfer() take the handle; this only runs when an
+  // exception skipped both. It must be off any multi handle by then.
+  ~Transfer() {
+    if (curl) curl_easy_cleanup(curl);
+  }
+};
+
+std::unique_ptr<OpenSkyClient::Transfer> OpenSkyClient::startTransfer(
+    const std::string& url, std::function<void(const char*, size_t)> onBody, bool fresh) {
+  Transport& t = *transport_;
+  long remainingMs = FetchDeadlineScope::remainingMs();
+  if (remainingMs <= 0) throw DeadlineExceeded("Deadline passed before the OpenSky request was sent");
+
+  auto tr = std::make_unique<Transfer>();
+  tr->url = url;
+  tr->onBody = std::move(onBody);
+
+  {
+    std::lock_guard<std::mutex> lock(t.mu);
+    tr->headers = t.headers;
+    if (!t.idle.empty()) {
+      tr->curl = t.idle.back();
+      t.idle.pop_back();
+    }
+  }
+  CURL* curl = tr->curl;
+  if (!curl) {
+    curl = curl_easy_init();
+    if (!curl) throw std::runtime_error("curl_easy_init failed");
+    curl_easy_setopt(curl, CURLOPT_SHARE, t.share);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, options_.acceptEncoding.c_str());
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, HeaderCallback);
+    tr->curl = curl;
+  }
+  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, tr->headers.get());
+  tr->deadlineBound = remainingMs < options_.timeoutMs;
+  curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, std::min(options_.connectTimeoutMs, remainingMs));
+  curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, std::min(options_.timeoutMs, remainingMs));
+  // In a batch, wait for a connection that can multiplex rather than open
+  // another; a hedge wants its own, away from whatever stalled the first.
+  curl_easy_setopt(curl, CURLOPT_PIPEWAIT, fresh ? 0L : 1L);
+  curl_easy_setopt(curl, CURLOPT_FRESH_CONNECT, fresh ? 1L : 0L);
+
+  tr->body.curl = curl;
+  tr->body.onBody = &tr->onBody;
+  curl_easy_setopt(curl, CURLOPT_URL, tr->url.c_str());
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, &tr->body);
+  curl_easy_setopt(curl, CURLOPT_HEADERDATA, &tr->body);
+  return tr;
+}
+
+void OpenSkyClient::finishTransfer(Transfer& tr, int curlCode) {
+  Transport& t = *transport_;
+  CURL* curl = tr.curl;
+  const BodyContext& body = tr.body;
+  CURLcode res = (CURLcode)curlCode;
 
-  CURLcode res = curl_easy_perform(curl);
   long http_code = 0;
+  long connects = 0;
+  curl_off_t wire = 0;
   curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+  curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects);
+  curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &wire);
+
+  if (FetchMetrics* m = FetchMetricsScope::current()) {
+    // libcurl's times are cumulative from the start of the request, in
+    // microseconds. Batched requests overlap, so their sum can exceed the wall time.
+    curl_off_t dns = 0, connect = 0, tls = 0, firstByte = 0, total = 0;
+    curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &dns);
+    curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &tls);
+    curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &firstByte);
+    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
+    curl_off_t sent = std::max(connect, tls);
+    m->requests++;
+    m->bytesDownloaded += (long)wire;
+    m->dnsMs += (double)dns / 1000.0;
+    m->connectMs += (double)std::max<curl_off_t>(0, connect - dns) / 1000.0;
+    m->tlsMs += tls > 0 ? (double)std::max<curl_off_t>(0, tls - connect) / 1000.0 : 0.0;
+    m->waitMs += (double)std::max<curl_off_t>(0, firstByte - sent) / 1000.0;
+    m->transferMs += (double)std::max<curl_off_t>(0, total - firstByte) / 1000.0;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(t.mu);
+    t.stats.requests++;
+    if (res == CURLE_OK) {
+      if (connects > 0) t.stats.newConnections += connects;
+      else t.stats.reusedConnections++;
+    }
+    t.stats.bytesOnWire += (long)wire;
+    t.stats.bytesDecoded += (long)body.bytes;
+    if (http_code == 429) t.stats.rateLimited++;
+    if (body.creditsRemaining >= 0) t.stats.creditsRemaining = body.creditsRemaining;
 
-  if (headers) curl_slist_free_all(headers);
-  curl_easy_cleanup(curl);
+    // A handle that failed mid-transfer is not trusted for reuse.
+    if (res == CURLE_OK && t.idle.size() < options_.maxIdleHandles) {
+      t.idle.push_back(curl);
+      curl = nullptr;
+    }
+  }
+  if (curl) curl_easy_cleanup(curl);
+  tr.curl = nullptr;
 
+  // The body callback failed (a parser error, out of memory) and cut the
+  // transfer short; that, not CURLE_WRITE_ERROR, is the error to report.
+  if (body.error) std::rethrow_exception(body.error);
+  if (res == CURLE_OPERATION_TIMEDOUT && tr.deadlineBound) {
+    throw DeadlineExceeded("OpenSky request cut off at the deadline");
+  }
   if (res != CURLE_OK) {
     std::ostringstream oss;
     oss << "curl_easy_perform failed: " << curl_easy_strerror(res);
-    throw std::runtime_error(oss.str());
+    throw FetchError(oss.str(), 0);
   }
 
   // ✅ Treat 404 as "no data" (OpenSky sometimes returns 404 with [])
   if (http_code == 404) {
-    return "[]";
+    return;
   }
 
   if (http_code != 200) {
     std::ostringstream oss;
-    oss << "HTTP " << http_code << " from OpenSky. Response: " << response;
-    throw std::runtime_error(oss.str());
-  }
-
-  return response;
-}
-
-// ---- ultra-light parsing helpers ----
-static std::string trim(const std::string& s) {
-  size_t a = 0, b = s.size();
-  while (a < b && std::isspace((unsigned char)s[a])) a++;
-  while (b > a && std::isspace((unsigned char)s[b - 1])) b--;
-  return s.substr(a, b - a);
-}
-
-static std::string extractStringField(const std::string& obj, const std::string& key) {
-  std::string pattern = "\"" + key + "\":";
-  size_t p = obj.find(pattern);
-  if (p == std::string::npos) return "";
-  p += pattern.size();
-  while (p < obj.size() && std::isspace((unsigned char)obj[p])) p++;
-  if (p >= obj.size()) return "";
-  if (obj.compare(p, 4, "null") == 0) return "";
-  if (obj[p] != '"') return "";
-  p++;
-  size_t q = obj.find('"', p);
-  if (q == std::string::npos) return "";
-  return obj.substr(p, q - p);
-}
-
-static long extractLongField(const std::string& obj, const std::string& key) {
-  std::string pattern = "\"" + key + "\":";
-  size_t p = obj.find(pattern);
-  if (p == std::string::npos) return 0;
-  p += pattern.size();
-  while (p < obj.size() && std::isspace((unsigned char)obj[p])) p++;
-  if (p >= obj.size()) return 0;
-  if (obj.compare(p, 4, "null") == 0) return 0;
-  size_t q = p;
-  while (q < obj.size() && (std::isdigit((unsigned char)obj[q]) || obj[q] == '-')) q++;
-  try {
-    return std::stol(obj.substr(p, q - p));
-  } catch (...) {
-    return 0;
+    oss << "HTTP " << http_code << " from OpenSky. Response: " << body.errorBody;
+    throw FetchError(oss.str(), http_code, body.retryAfterSeconds);
   }
 }
 
-std::vector<Flight> OpenSkyClient::getDepartures(const std::string& airportIcao,
-                                                 long beginUtc,
-                                                 long endUtc) {
+void OpenSkyClient::abandonTransfer(Transfer& tr) {
+  curl_off_t wire = 0;
+  curl_easy_getinfo(tr.curl, CURLINFO_SIZE_DOWNLOAD_T, &wire);
+  {
+    std::lock_guard<std::mutex> lock(transport_->mu);
+    transport_->stats.requests++;
+    transport_->stats.bytesOnWire += (long)wire;
+  }
+  if (FetchMetrics* m = FetchMetricsScope::current()) {
+    m->requests++;
+    m->bytesDownloaded += (long)wire;
+  }
+  // Cut off mid-response, so not reused.
+  curl_easy_cleanup(tr.curl);
+  tr.curl = nullptr;
+}
+
+void OpenSkyClient::httpGet(const std::string& url,
+                            const std::function<void(const char*, size_t)>& onBody) {
+  std::unique_ptr<Transfer> tr = startTransfer(url, onBody);
+  CURLcode res = curl_easy_perform(tr->curl);
+  finishTransfer(*tr, res);
+}
+
+std::string OpenSkyClient::departuresUrl(const std::string& airportIcao, long beginUtc, long endUtc) const {
   std::ostringstream url;
-  url << "https://opensky-network.org/api/flights/departure"
+  url << options_.baseUrl << "/flights/departure"
       << "?airport=" << airportIcao
       << "&begin=" << beginUtc
       << "&end=" << endUtc;
+  return url.str();
+}
 
-  std::string json = httpGet(url.str());
+// Parse while downloading; rows from other airports or without an arrival
+// airport are dropped inside the parser.
+static std::function<void(const char*, size_t)> parseInto(DepartureStreamParser& parser) {
+  FetchMetrics* metrics = FetchMetricsScope::current();
+  return [&parser, metrics](const char* data, size_t len) {
+    if (!metrics) {
+      parser.feed(data, len);
+      return;
+    }
+    auto t0 = std::chrono::steady_clock::now();
+    parser.feed(data, len);
+    metrics->parseMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+  };
+}
 
-  std::vector<Flight> flights;
-  size_t pos = 0;
-  while (true) {
-    size_t a = json.find('{', pos);
-    if (a == std::string::npos) break;
-    size_t b = json.find('}', a);
-    if (b == std::string::npos) break;
+static std::vector<Flight> parsedFlights(DepartureStreamParser& parser) {
+  if (!parser.finish()) throw std::runtime_error("Truncated or malformed OpenSky response");
+  if (FetchMetrics* metrics = FetchMetricsScope::current()) metrics->flightsParsed += (long)parser.flights().size();
+  return std::move(parser.flights());
+}
 
-    std::string obj = json.substr(a, b - a + 1);
+std::vector<Flight> OpenSkyClient::getDepartures(const std::string& airportIcao,
+                                                 long beginUtc,
+                                                 long endUtc) {
+  if (options_.hedgeAfterMs > 0 && FetchPriorityScope::current() == FetchPriority::Tick) {
+    // Through the multi loop, which can hedge it.
+    std::vector<Flight> out;
+    std::exception_ptr error;
+    getDeparturesBatch({DepartureRequest{airportIcao, beginUtc, endUtc}},
+                       [&](size_t, std::vector<Flight> flights, std::exception_ptr e) {
+                         out = std::move(flights);
+                         error = e;
+                       });
+    if (error) std::rethrow_exception(error);
+    return out;
+  }
+  DepartureStreamParser parser(airportIcao);
+  httpGet(departuresUrl(airportIcao, beginUtc, endUtc), parseInto(parser));
+  return parsedFlights(parser);
+}
+
+void OpenSkyClient::getDeparturesBatch(const std::vector<DepartureRequest>& requests,
+                                       const DepartureCallback& done) {
+  using Clock = std::chrono::steady_clock;
+  // One copy of a request on the wire: attempt 0, or its hedge (attempt 1).
+  struct Attempt {
+    std::unique_ptr<DepartureStreamParser> parser;
+    std::unique_ptr<Transfer> transfer;
+  };
+  struct Job {
+    Clock::time_point started;
+    Attempt attempts[2];
+    int live = 0;              // attempts on the wire
+    bool hedged = false;
+    std::exception_ptr error;  // first failure, reported if the other attempt fails too
+  };
 
-    Flight f;
-    f.icao24 = extractStringField(obj, "icao24");
-    f.callsign = trim(extractStringField(obj, "callsign"));
-    f.estDepartureAirport = extractStringField(obj, "estDepartureAirport");
-    f.estArrivalAirport = extractStringField(obj, "estArrivalAirport");
-    f.firstSeen = extractLongField(obj, "firstSeen");
-    f.lastSeen = extractLongField(obj, "lastSeen");
+  std::unique_ptr<CURLM, CURLMcode (*)(CURLM*)> multi(curl_multi_init(), curl_multi_cleanup);
+  if (!multi) throw std::runtime_error("curl_multi_init failed");
+  curl_multi_setopt(multi.get(), CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
 
-    if (!f.estDepartureAirport.empty() && !f.estArrivalAirport.empty() && f.firstSeen > 0) {
-      flights.push_back(std::move(f));
+  auto hedgeAfter = std::chrono::milliseconds(options_.hedgeAfterMs);
+  bool hedging = options_.hedgeAfterMs > 0 && FetchPriorityScope::current() == FetchPriority::Tick;
+
+  std::map<size_t, Job> jobs;                    // by request index
+  std::map<CURL*, std::pair<size_t, int>> running; // handle -> (request, attempt)
+  // If a callback throws, detach what is still on the wire before the
+  // transfers (which free the handles) and then the multi handle go.
+  struct Detach {
+    CURLM* multi;
+    std::map<CURL*, std::pair<size_t, int>>& running;
+    ~Detach() {
+      for (auto& entry : running) curl_multi_remove_handle(multi, entry.first);
     }
+  } detach{multi.get(), running};
+  size_t next = 0;
+  size_t limit = std::max<size_t>(1, options_.maxConcurrent);
 
-    pos = b + 1;
-  }
+  // Puts one attempt of request i on the wire; throws if it cannot be sent.
+  auto launch = [&](size_t i, int a) {
+    const DepartureRequest& r = requests[i];
+    Attempt& at = jobs[i].attempts[a];
+    at.parser = std::make_unique<DepartureStreamParser>(r.airport);
+    at.transfer = startTransfer(departuresUrl(r.airport, r.beginUtc, r.endUtc), parseInto(*at.parser), a == 1);
+    CURL* curl = at.transfer->curl;
+    if (curl_multi_add_handle(multi.get(), curl) != CURLM_OK) {
+      finishTransfer(*at.transfer, CURLE_FAILED_INIT); // throws
+    }
+    running.emplace(curl, std::make_pair(i, a));
+    jobs[i].live++;
+  };
+
+  auto startMore = [&] {
+    while (next < requests.size() && jobs.size() < limit) {
+      size_t i = next++;
+      jobs[i].started = Clock::now();
+      try {
+        launch(i, 0);
+      } catch (...) {
+        jobs.erase(i);
+        done(i, {}, std::current_exception());
+      }
+    }
+  };
 
-  return flights;
-}
\ No newline at end of file
+  // Duplicates the requests that have waited past the threshold; returns how
+  // long until the next one is due.
+  auto hedgeSlow = [&]() -> long {
+    long untilNext = 1000;
+    if (!hedging) return untilNext;
+    auto now = Clock::now();
+    for (auto& [i, job] : jobs) {
+      if (job.hedged) continue;
+      auto due = job.started + hedgeAfter;
+      if (now < due) {
+        untilNext = std::min(untilNext, (long)std::chrono::ceil<std::chrono::milliseconds>(due - now).count());
+        continue;
+      }
+      job.hedged = true;
+      try {
+        launch(i, 1);
+        std::lock_guard<std::mutex> lock(transport_->mu);
+        transport_->stats.hedges++;
+        if (FetchMetrics* m = FetchMetricsScope::current()) m->hedges++;
+      } catch (...) {
+        // Out of time, or no handle: the original is still running.
+      }
+    }
+    return untilNext;
+  };
+
+  startMore();
+  while (!running.empty()) {
+    int active = 0;
+    CURLMcode mc = curl_multi_perform(multi.get(), &active);
+    if (mc != CURLM_OK) {
+      // The multi handle is unusable: fail whatever has not finished.
+      FetchError error(std::string("curl_multi_perform failed: ") + curl_multi_strerror(mc), 0);
+      for (auto& [curl, slot] : running) {
+        curl_multi_remove_handle(multi.get(), curl);
+        try {
+          finishTransfer(*jobs[slot.first].attempts[slot.second].transfer, CURLE_FAILED_INIT);
+        } catch (...) {
+        }
+      }
+      running.clear();
+      for (auto& [i, job] : jobs) done(i, {}, std::make_exception_ptr(error));
+      jobs.clear();
+      for (; next < requests.size(); next++) done(next, {}, std::make_exception_ptr(error));
+      return;
+    }
+
+    int queued = 0;
+    while (CURLMsg* msg = curl_multi_info_read(multi.get(), &queued)) {
+      if (msg->msg != CURLMSG_DONE) continue;
+      CURL* curl = msg->easy_handle;
+      CURLcode res = msg->data.result;
+      curl_multi_remove_handle(multi.get(), curl);
+      auto it = running.find(curl);
+      if (it == running.end()) continue;
+      auto [i, a] = it->second;
+      running.erase(it);
+      Job& job = jobs[i];
+      job.live--;
+
+      std::vector<Flight> flights;
+      std::exception_ptr error;
+      try {
+        finishTransfer(*job.attempts[a].transfer, res);
+        flights = parsedFlights(*job.attempts[a].parser);
+      } catch (...) {
+        error = std::current_exception();
+      }
+      if (error && job.live > 0) {
+        if (!job.error) job.error = error;
+        continue; // the other attempt may still answer
+      }
+      if (!error && job.live > 0) {
+        // First answer wins; the other copy is dropped.
+        Attempt& other = job.attempts[1 - a];
+        curl_multi_remove_handle(multi.get(), other.transfer->curl);
+        running.erase(other.transfer->curl);
+        abandonTransfer(*other.transfer);
+      }
+      if (!error && a == 1) {
+        std::lock_guard<std::mutex> lock(transport_->mu);
+        transport_->stats.hedgeWins++;
+      }
+      if (error && job.error) error = job.error;
+      jobs.erase(i);
+      startMore(); // keep the pipe full before handing this one over
+      done(i, std::move(flights), error);
+    }
+
+    long pollMs = hedgeSlow();
+    if (!running.empty()) curl_multi_poll(multi.get(), nullptr, 0, (int)std::max(1L, pollMs), nullptr);
+  }
+}
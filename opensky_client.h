@@ -1,26 +1,87 @@
 #pragma once
+#include "departure_source.h"
+#include <cstddef>
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
-struct Flight {
-  std::string icao24;
-  std::string callsign;
-  std::string estDepartureAirport;
-  std::string estArrivalAirport;
-  long firstSeen = 0; // unix seconds UTC
-  long lastSeen  = 0; // unix seconds UTC
+struct OpenSkyOptions {
+  std::string baseUrl = "https://opensky-network.org/api";
+  long connectTimeoutMs = 10000;  // TCP + TLS handshake
+  long timeoutMs = 60000;         // whole request, including transfer
+  std::string acceptEncoding;     // "" = every encoding libcurl supports (gzip, br, zstd...)
+  size_t maxIdleHandles = 4;      // kept warm for reuse
+  size_t maxConcurrent = 6;       // batch requests in flight at once
+  long hedgeAfterMs = 4000;       // a tick request unanswered this long is sent again; 0 = never
 };
 
-class OpenSkyClient {
+// Cumulative transport counters since the client was created.
+struct TransferStats {
+  long requests = 0;
+  long newConnections = 0;   // TCP/TLS connects actually made
+  long reusedConnections = 0;
+  long bytesOnWire = 0;      // body bytes as received (compressed if encoded)
+  long bytesDecoded = 0;     // body bytes after content decoding
+  long rateLimited = 0;      // 429 responses
+  long hedges = 0;           // duplicates sent for slow tick requests
+  long hedgeWins = 0;        // duplicates that answered first
+  long creditsRemaining = -1; // last X-Rate-Limit-Remaining seen; -1 = never reported
+};
+
+// OpenSky REST client. Owns a small pool of curl handles that share one
+// connection, DNS and TLS-session cache, so consecutive requests reuse the
+// same keep-alive connection instead of paying DNS + TCP + TLS each time.
+// Not copyable; safe to call from several threads at once.
+//
+// Timeouts are capped by the caller's FetchDeadlineScope; a request cut off by
+// it fails with DeadlineExceeded. A tick-priority request still unanswered
+// after hedgeAfterMs gets a duplicate on a fresh connection and the first
+// answer wins, so one stalled connection does not cost the whole timeout. Each
+// duplicate is charged by OpenSky like any request; the quota scheduler picks
+// that up from X-Rate-Limit-Remaining.
+class OpenSkyClient : public DepartureSource {
  public:
-  explicit OpenSkyClient(std::string bearerToken = "");
+  explicit OpenSkyClient(std::string bearerToken = "", OpenSkyOptions options = {});
+  ~OpenSkyClient() override;
+
+  OpenSkyClient(const OpenSkyClient&) = delete;
+  OpenSkyClient& operator=(const OpenSkyClient&) = delete;
 
   // Fetch departures from an airport in [begin,end] unix seconds (UTC).
   std::vector<Flight> getDepartures(const std::string& airportIcao,
                                    long beginUtc,
-                                   long endUtc);
+                                   long endUtc) override;
+
+  // Runs up to maxConcurrent requests at once on one curl multi handle (over
+  // the same connection pool), calling done() as each finishes. Tick requests
+  // are hedged as described above.
+  void getDeparturesBatch(const std::vector<DepartureRequest>& requests, const DepartureCallback& done) override;
+
+  TransferStats stats() const;
+
+  // Replace the bearer token (e.g. after an OAuth refresh); later requests use it.
+  void setBearerToken(std::string bearerToken);
 
  private:
+  struct Transport;
+  struct Transfer; // one request's handle and response state
+
   std::string bearerToken_;
-  std::string httpGet(const std::string& url);
-};
\ No newline at end of file
+  OpenSkyOptions options_;
+  std::unique_ptr<Transport> transport_;
+
+  std::string departuresUrl(const std::string& airportIcao, long beginUtc, long endUtc) const;
+
+  // Streams the body of a 200 response to `onBody`; 404 means "no data".
+  // Failures throw FetchError (429 carries the server's retry delay).
+  void httpGet(const std::string& url, const std::function<void(const char*, size_t)>& onBody);
+
+  // A pooled handle set up for `url` (on a new connection if `fresh`);
+  // finishTransfer() records the outcome, returns the handle to the pool and
+  // throws like httpGet(). abandonTransfer() drops one still in progress.
+  std::unique_ptr<Transfer> startTransfer(const std::string& url, std::function<void(const char*, size_t)> onBody,
+                                          bool fresh = false);
+  void finishTransfer(Transfer& t, int curlCode);
+  void abandonTransfer(Transfer& t);
+};
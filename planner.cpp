@@ -0,0 +1,152 @@
+#include "planner.h"
+#include "airport_db.h"
+#include "traveler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <map>
+
+namespace {
+
+struct Path {
+  size_t root = 0;        // committed first-hop candidate
+  TravelerState st;       // traveler as it would be after the path so far
+  double score = 0;
+  int hops = 1;
+};
+
+struct Fetched {
+  long begin = 0;
+  long end = 0;
+  std::vector<Flight> flights;
+  bool ok = false;
+};
+
+void arriveAt(TravelerState& st, const Flight& f) {
+  st.sim_time_utc = estimatedArrival(f);
+  st.current_airport = std::string(f.arrival());
+  if (st.recent_airports.capacity() != st.avoid_recent_n) st.recent_airports.setCapacity(st.avoid_recent_n);
+  st.recent_airports.push(f.estArrivalAirport);
+  st.visited_airports.insert(f.estArrivalAirport);
+}
+
+} // namespace
+
+LookaheadPlanner::LookaheadPlanner(DepartureSource& source, Scorer scorer, Window window, PlannerOptions options)
+  : source_(source), scorer_(std::move(scorer)), window_(std::move(window)), options_(options) {
+  options_.depth = std::clamp(options_.depth, 1, 4);
+  options_.beam = std::clamp(options_.beam, 1, 8);
+}
+
+PlannerResult LookaheadPlanner::plan(const TravelerState& st,
+                                     const std::vector<Flight>& candidates,
+                                     const std::vector<double>& scores) {
+  PlannerResult result;
+  if (candidates.empty()) return result;
+
+  std::vector<Path> beam;
+  for (size_t i = 0; i < candidates.size() && (int)beam.size() < options_.beam; i++) {
+    Path p;
+    p.root = i;
+    p.st = st;
+    arriveAt(p.st, candidates[i]);
+    p.score = scores[i];
+    beam.push_back(std::move(p));
+  }
+
+  std::vector<Path> finished;
+  std::map<std::string, Fetched> memo; // per airport, for the rest of this tick
+
+  for (int level = 1; level < options_.depth && !beam.empty(); level++) {
+    double weight = std::pow(options_.discount, level);
+
+    // Union window per destination airport; one batch of fetches for the new ones.
+    std::map<std::string, std::pair<long, long>> wanted;
+    for (const auto& p : beam) {
+      long b = 0, e = 0;
+      window_(p.st.sim_time_utc, b, e);
+      auto [it, inserted] = wanted.try_emplace(p.st.current_airport, b, e);
+      if (!inserted) {
+        long ub = std::min(it->second.first, b);
+        long ue = std::max(it->second.second, e);
+        // Keep within the two-UTC-day limit; later paths fall back to the first window.
+        if (ue / 86400 - ub / 86400 <= 1) it->second = {ub, ue};
+      }
+    }
+
+    std::vector<DepartureRequest> batch;
+    for (const auto& [airport, range] : wanted) {
+      auto m = memo.find(airport);
+      if (m != memo.end() && m->second.begin <= range.first && range.second <= m->second.end) continue;
+      batch.push_back(DepartureRequest{airport, range.first, range.second});
+      memo[airport] = Fetched{range.first, range.second, {}, false};
+      result.requests++;
+    }
+    if (!batch.empty()) {
+      FetchPriorityScope priority(FetchPriority::Lookahead);
+      source_.getDeparturesBatch(batch, [&](size_t i, std::vector<Flight> flights, std::exception_ptr error) {
+        // Unknown is not the same as empty: no dead-end penalty for failed lookups.
+        if (error) return;
+        Fetched& f = memo[batch[i].airport];
+        f.flights = std::move(flights);
+        f.ok = true;
+      });
+    }
+
+    std::vector<Path> next;
+    for (auto& p : beam) {
+      const Fetched& f = memo[p.st.current_airport];
+      if (!f.ok) {
+        finished.push_back(std::move(p));
+        continue;
+      }
+
+      long b = 0, e = 0;
+      window_(p.st.sim_time_utc, b, e);
+      AirportId here = AirportDict::find(p.st.current_airport);
+      std::vector<std::pair<double, const Flight*>> options;
+      for (const auto& g : f.flights) {
+        if (g.firstSeen < b || g.firstSeen > e) continue;
+        if (g.estDepartureAirport != here) continue;
+        if (g.estArrivalAirport == kNoAirport || g.estArrivalAirport == here) continue;
+        options.emplace_back(scorer_(p.st, g), &g);
+      }
+
+      if (options.empty()) {
+        // Only a fully fetched window proves a dead end.
+        if (f.begin <= b && e <= f.end) p.score -= weight * options_.deadEndPenalty;
+        finished.push_back(std::move(p));
+        continue;
+      }
+
+      size_t keep = std::min<size_t>(options_.beam, options.size());
+      std::partial_sort(options.begin(), options.begin() + keep, options.end(),
+                        [](const auto& a, const auto& b) { return a.first > b.first; });
+      for (size_t i = 0; i < keep; i++) {
+        Path child = p;
+        child.score += weight * options[i].first;
+        child.hops++;
+        arriveAt(child.st, *options[i].second);
+        next.push_back(std::move(child));
+      }
+    }
+
+    size_t keep = std::min<size_t>(options_.beam, next.size());
+    std::partial_sort(next.begin(), next.begin() + keep, next.end(),
+                      [](const Path& a, const Path& b) { return a.score > b.score; });
+    next.resize(keep);
+    beam = std::move(next);
+  }
+
+  for (auto& p : beam) finished.push_back(std::move(p));
+
+  const Path* best = nullptr;
+  for (const auto& p : finished) {
+    if (!best || p.score > best->score) best = &p;
+  }
+  result.candidateIndex = best->root;
+  result.pathScore = best->score;
+  result.pathHops = best->hops;
+  return result;
+}
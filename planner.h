@@ -0,0 +1,55 @@
+#pragma once
+#include "departure_source.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+struct TravelerState;
+
+// Multi-hop lookahead (beam search) over departures.
+//
+// Starting from the already-scored candidates at the current airport, the
+// planner keeps the best `beam` partial paths, expands each one hop further
+// using departures from its destination, and scores whole paths: hop scores are
+// summed with a per-level discount, and a path whose destination has no
+// onward departure in its window takes a dead-end penalty. Only the first hop
+// of the best path is committed.
+//
+// Each level fetches every distinct destination once, as one batch, and the
+// results are memoised for the rest of the tick, so the extra cost is at most
+// beam * (depth - 1) window requests.
+
+struct PlannerOptions {
+  int depth = 3;                 // hops considered, including the committed one
+  int beam = 3;                  // partial paths kept per level
+  double discount = 0.7;         // weight of each further level
+  double deadEndPenalty = 1.5;   // subtracted (discounted) for a stranded path
+};
+
+struct PlannerResult {
+  size_t candidateIndex = 0;     // index into the candidates passed to plan()
+  double pathScore = 0;
+  int pathHops = 1;
+  int requests = 0;              // window fetches issued for the lookahead
+};
+
+class LookaheadPlanner {
+ public:
+  using Scorer = std::function<double(const TravelerState&, const Flight&)>;
+  using Window = std::function<void(long storyTime, long& begin, long& end)>;
+
+  LookaheadPlanner(DepartureSource& source, Scorer scorer, Window window, PlannerOptions options);
+
+  // `candidates` are departures from st.current_airport, best first, with
+  // their scores in `scores`.
+  PlannerResult plan(const TravelerState& st,
+                     const std::vector<Flight>& candidates,
+                     const std::vector<double>& scores);
+
+ private:
+  DepartureSource& source_;
+  Scorer scorer_;
+  Window window_;
+  PlannerOptions options_;
+};
@@ -0,0 +1,133 @@
+#include "prefetch_source.h"
+
+#include <algorithm>
+#include <ctime>
+
+PrefetchingSource::PrefetchingSource(DepartureSource& upstream, size_t maxPending)
+  : upstream_(upstream), maxPending_(std::max<size_t>(1, maxPending)) {}
+
+void PrefetchingSource::prefetch(const std::string& airportIcao, long beginUtc, long endUtc) {
+  // Destroying a dropped in-flight prefetch waits for it, so do that after unlocking.
+  std::list<Pending> dropped;
+  std::lock_guard<std::mutex> lock(mu_);
+  for (const auto& p : pending_) {
+    if (p.airport == airportIcao && p.begin <= beginUtc && endUtc <= p.end) return; // already on its way
+  }
+
+  Pending p;
+  p.airport = airportIcao;
+  p.begin = beginUtc;
+  p.end = endUtc;
+  p.fetchedUtc = (long)std::time(nullptr);
+  p.result = std::async(std::launch::async, [this, airportIcao, beginUtc, endUtc] {
+    FetchPriorityScope priority(FetchPriority::Prefetch);
+    return upstream_.getDepartures(airportIcao, beginUtc, endUtc);
+  }).share();
+  pending_.push_back(std::move(p));
+  stats_.issued++;
+
+  // Unclaimed prefetches (the traveler went somewhere else) are dropped oldest first.
+  while (pending_.size() > maxPending_) dropped.splice(dropped.end(), pending_, pending_.begin());
+}
+
+bool PrefetchingSource::claim(const std::string& airportIcao, long beginUtc, long endUtc, Pending& out) {
+  Pending stale; // released after unlocking, like prefetch()'s drops
+  std::lock_guard<std::mutex> lock(mu_);
+  auto it = std::find_if(pending_.begin(), pending_.end(), [&](const Pending& p) {
+    return p.airport == airportIcao && p.begin <= beginUtc && endUtc <= p.end;
+  });
+  if (it == pending_.end()) {
+    stats_.misses++;
+    return false;
+  }
+  if (endUtc + kPublishLagSeconds > it->fetchedUtc) {
+    stale = std::move(*it);
+    pending_.erase(it);
+    stats_.stale++;
+    stats_.misses++;
+    return false;
+  }
+  out = std::move(*it);
+  pending_.erase(it);
+  return true;
+}
+
+bool PrefetchingSource::collect(Pending& claimed, long beginUtc, long endUtc, std::vector<Flight>& out) {
+  try {
+    FetchDeadlineScope::wait(claimed.result, "a prefetch");
+  } catch (const DeadlineExceeded&) {
+    // Dropping the last reference would block until it lands.
+    std::lock_guard<std::mutex> lock(mu_);
+    pending_.push_front(std::move(claimed));
+    stats_.late++;
+    return false;
+  }
+  try {
+    const std::vector<Flight>& all = claimed.result.get();
+    out.clear();
+    out.reserve(all.size());
+    for (const auto& f : all) {
+      if (f.firstSeen >= beginUtc && f.firstSeen <= endUtc) out.push_back(f);
+    }
+    std::lock_guard<std::mutex> lock(mu_);
+    stats_.hits++;
+    return true;
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(mu_);
+    stats_.failed++;
+    return false;
+  }
+}
+
+std::vector<Flight> PrefetchingSource::getDepartures(const std::string& airportIcao,
+                                                     long beginUtc,
+                                                     long endUtc) {
+  Pending claimed;
+  std::vector<Flight> out;
+  if (claim(airportIcao, beginUtc, endUtc, claimed) && collect(claimed, beginUtc, endUtc, out)) return out;
+  return upstream_.getDepartures(airportIcao, beginUtc, endUtc);
+}
+
+void PrefetchingSource::getDeparturesBatch(const std::vector<DepartureRequest>& requests,
+                                           const DepartureCallback& done) {
+  std::vector<Pending> claimed(requests.size());
+  std::vector<bool> has(requests.size(), false);
+  std::vector<DepartureRequest> upstream;
+  std::vector<size_t> index;
+  for (size_t i = 0; i < requests.size(); i++) {
+    has[i] = claim(requests[i].airport, requests[i].beginUtc, requests[i].endUtc, claimed[i]);
+    if (!has[i]) {
+      upstream.push_back(requests[i]);
+      index.push_back(i);
+    }
+  }
+  if (!upstream.empty()) {
+    upstream_.getDeparturesBatch(upstream, [&](size_t k, std::vector<Flight> flights, std::exception_ptr error) {
+      done(index[k], std::move(flights), error);
+    });
+  }
+
+  // Failed (or late) prefetches are fetched again, together.
+  upstream.clear();
+  index.clear();
+  for (size_t i = 0; i < requests.size(); i++) {
+    if (!has[i]) continue;
+    std::vector<Flight> out;
+    if (collect(claimed[i], requests[i].beginUtc, requests[i].endUtc, out)) {
+      done(i, std::move(out), nullptr);
+    } else {
+      upstream.push_back(requests[i]);
+      index.push_back(i);
+    }
+  }
+  if (!upstream.empty()) {
+    upstream_.getDeparturesBatch(upstream, [&](size_t k, std::vector<Flight> flights, std::exception_ptr error) {
+      done(index[k], std::move(flights), error);
+    });
+  }
+}
+
+PrefetchStats PrefetchingSource::stats() const {
+  std::lock_guard<std::mutex> lock(mu_);
+  return stats_;
+}
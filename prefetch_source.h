@@ -0,0 +1,72 @@
+#pragma once
+#include "departure_source.h"
+
+#include <future>
+#include <list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct PrefetchStats {
+  long issued = 0;   // background fetches started
+  long hits = 0;     // getDepartures answered from a prefetch
+  long misses = 0;   // went upstream (nothing prefetched, or window not covered)
+  long failed = 0;   // prefetch threw; the request went upstream instead
+  long late = 0;     // still in flight at the caller's deadline; kept for a later call
+  long stale = 0;    // fetched before the window was published; dropped, went upstream
+};
+
+// Fetches ahead in the background.
+//
+// After a hop the engine already knows where the traveler lands and which
+// window its next tick will ask for, so it calls prefetch() and the fetch +
+// parse happens while the traveler is "in the air". The result is kept until
+// a getDepartures() for that airport whose window it covers consumes it, so
+// the next tick is a memory lookup instead of an HTTP round trip.
+//
+// A prefetch can be claimed hours after it was fetched (at the end of a long
+// flight). If the window it answers had not been published for
+// kPublishLagSeconds when the fetch started, the snapshot may be missing
+// flights, so it is dropped and the window goes upstream (through the cache,
+// which knows what to ask again) instead.
+//
+// Only worth it in a long-lived process (daemon mode): destroying the source
+// waits for fetches still in flight.
+class PrefetchingSource : public DepartureSource {
+ public:
+  explicit PrefetchingSource(DepartureSource& upstream, size_t maxPending = 16);
+
+  std::vector<Flight> getDepartures(const std::string& airportIcao,
+                                    long beginUtc,
+                                    long endUtc) override;
+
+  void prefetch(const std::string& airportIcao, long beginUtc, long endUtc) override;
+
+  // Requests without a prefetch go upstream as one batch; prefetched ones are
+  // collected after it, by which time they have usually landed.
+  void getDeparturesBatch(const std::vector<DepartureRequest>& requests, const DepartureCallback& done) override;
+
+  PrefetchStats stats() const;
+
+ private:
+  struct Pending {
+    std::string airport;
+    long begin = 0;
+    long end = 0;
+    long fetchedUtc = 0;
+    std::shared_future<std::vector<Flight>> result;
+  };
+
+  DepartureSource& upstream_;
+  size_t maxPending_;
+
+  // Takes the pending prefetch covering the window, if any (counted as a miss
+  // if not). One fetched before the window was published is dropped.
+  bool claim(const std::string& airportIcao, long beginUtc, long endUtc, Pending& out);
+  // The window's flights from a claimed prefetch; false if it failed, or if it
+  // is still in flight at the caller's deadline (it is then put back).
+  bool collect(Pending& claimed, long beginUtc, long endUtc, std::vector<Flight>& out);
+  mutable std::mutex mu_;
+  std::list<Pending> pending_; // oldest first
+  PrefetchStats stats_;
+};
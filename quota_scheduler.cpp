@@ -0,0 +1,434 @@
+#include "quota_scheduler.h"
+#include "state_io.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+static long nowSeconds() { return (long)std::time(nullptr); }
+
+static double jsonNumber(const std::string& json, const std::string& key, double def) {
+  std::string pattern = "\"" + key + "\":";
+  auto p = json.find(pattern);
+  if (p == std::string::npos) return def;
+  const char* start = json.c_str() + p + pattern.size();
+  char* end = nullptr;
+  double v = std::strtod(start, &end);
+  return end == start ? def : v;
+}
+
+QuotaScheduler::QuotaScheduler(DepartureSource& upstream, QuotaOptions options)
+  : upstream_(upstream),
+    options_(std::move(options)),
+    creditsPerDay_(options_.creditsPerDay),
+    rng_(std::random_device{}()) {
+  quotaDay_ = nowSeconds() / 86400;
+  load();
+}
+
+long QuotaScheduler::partitions(long beginUtc, long endUtc) {
+  return std::max(1L, endUtc / 86400 - beginUtc / 86400 + 1);
+}
+
+double QuotaScheduler::remainingCredits() const {
+  std::lock_guard<std::mutex> lock(mu_);
+  return std::max(0.0, (double)options_.dailyCredits - used_);
+}
+
+QuotaStats QuotaScheduler::stats() const {
+  std::lock_guard<std::mutex> lock(mu_);
+  QuotaStats s = stats_;
+  s.creditsUsed = used_;
+  return s;
+}
+
+void QuotaScheduler::rollDayLocked(long now) {
+  long day = now / 86400;
+  if (day == quotaDay_) return;
+  quotaDay_ = day;
+  used_ = 0;
+  lastReported_ = -1;
+}
+
+void QuotaScheduler::admitLocked(double cost, FetchPriority priority, long now) {
+  double remaining = (double)options_.dailyCredits - used_;
+  double reserve = 0;
+  if (priority == FetchPriority::Lookahead) reserve = options_.lookaheadReserve * (double)options_.dailyCredits;
+  if (priority == FetchPriority::Prefetch) reserve = options_.prefetchReserve * (double)options_.dailyCredits;
+
+  // A tick may spend the last credit (the estimate can be pessimistic); the
+  // speculative fetches leave their reserve for it.
+  bool ok = priority == FetchPriority::Tick ? remaining > 0 : remaining - cost >= reserve;
+  if (ok) return;
+
+  stats_.refused++;
+  long untilReset = (quotaDay_ + 1) * 86400 - now;
+  std::ostringstream oss;
+  oss << "OpenSky credits " << (priority == FetchPriority::Tick ? "used up" : "reserved for ticks")
+      << " (" << (long)std::max(0.0, remaining) << " of " << options_.dailyCredits << " left)";
+  throw FetchError(oss.str(), 429, priority == FetchPriority::Tick ? untilReset : 0);
+}
+
+long QuotaScheduler::backoffMsLocked(int attempt) {
+  // Full jitter: uniform in [0, min(max, base * 2^attempt)].
+  double cap = std::min((double)options_.maxBackoffMs, (double)options_.baseBackoffMs * std::ldexp(1.0, attempt));
+  std::uniform_real_distribution<double> u(0.0, cap);
+  return (long)u(rng_);
+}
+
+std::vector<Flight> QuotaScheduler::getDepartures(const std::string& airportIcao,
+                                                  long beginUtc,
+                                                  long endUtc) {
+  FetchPriority priority = FetchPriorityScope::current();
+
+  std::promise<std::vector<Flight>> promise;
+  std::shared_future<std::vector<Flight>> shared;
+  std::list<InFlight>::iterator mine;
+  bool owner = false;
+  FetchPriority ownerPriority = priority;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    auto it = std::find_if(inFlight_.begin(), inFlight_.end(), [&](const InFlight& f) {
+      return f.airport == airportIcao && f.begin <= beginUtc && endUtc <= f.end;
+    });
+    if (it != inFlight_.end()) {
+      shared = it->result;
+      ownerPriority = it->priority;
+      stats_.coalesced++;
+    } else {
+      shared = promise.get_future().share();
+      mine = inFlight_.insert(inFlight_.end(), InFlight{airportIcao, beginUtc, endUtc, priority, shared});
+      owner = true;
+    }
+  }
+
+  if (!owner) {
+    FetchDeadlineScope::wait(shared, "a shared OpenSky request");
+    try {
+      std::vector<Flight> out;
+      for (const Flight& f : shared.get()) {
+        if (f.firstSeen >= beginUtc && f.firstSeen <= endUtc) out.push_back(f);
+      }
+      return out;
+    } catch (const FetchError&) {
+      // A lower-priority request may have been refused, or given up without retrying.
+      if (priority >= ownerPriority) throw;
+      return fetch(airportIcao, beginUtc, endUtc, priority);
+    }
+  }
+
+  auto finish = [this, mine] {
+    std::lock_guard<std::mutex> lock(mu_);
+    inFlight_.erase(mine);
+  };
+  try {
+    std::vector<Flight> flights = fetch(airportIcao, beginUtc, endUtc, priority);
+    promise.set_value(flights);
+    finish();
+    return flights;
+  } catch (...) {
+    promise.set_exception(std::current_exception());
+    finish();
+    throw;
+  }
+}
+
+long QuotaScheduler::gateLocked(FetchPriority priority, int attempt, long days, double& cost) {
+  if (FetchDeadlineScope::remainingMs() <= 0) throw DeadlineExceeded("Deadline passed before the OpenSky request was sent");
+  long now = nowSeconds();
+  rollDayLocked(now);
+  if (blockedUntil_ > now) {
+    long wait = blockedUntil_ - now;
+    if (priority != FetchPriority::Tick || wait > options_.maxWaitSeconds || attempt > options_.maxAttempts ||
+        wait * 1000 >= FetchDeadlineScope::remainingMs()) {
+      stats_.refused++;
+      throw FetchError("OpenSky rate limit; retry in " + std::to_string(wait) + "s", 429, wait);
+    }
+    return wait * 1000;
+  }
+  cost = (double)days * creditsPerDay_;
+  admitLocked(cost, priority, now);
+  stats_.requests++;
+  active_++;
+  return 0;
+}
+
+void QuotaScheduler::succeededLocked(double cost, long days) {
+  active_--;
+  used_ += cost;
+  if (FetchMetrics* m = FetchMetricsScope::current()) m->creditsCharged += cost;
+  long reported = options_.serverRemaining ? options_.serverRemaining() : -1;
+  if (reported >= 0) {
+    // The server's count wins; with nothing else in flight the drop since
+    // the last report is this request's price, which refines the estimate.
+    if (lastReported_ >= 0 && active_ == 0 && reported < lastReported_) {
+      double observed = (double)(lastReported_ - reported) / (double)days;
+      creditsPerDay_ = 0.7 * creditsPerDay_ + 0.3 * observed;
+    }
+    lastReported_ = reported;
+    used_ = (double)(options_.dailyCredits - reported);
+  }
+  saveLocked();
+}
+
+std::exception_ptr QuotaScheduler::failedLocked(const FetchError& e, double cost, int attempt, FetchPriority priority,
+                                                long& sleepMs) {
+  long retryAfter = e.retryAfterSeconds();
+  active_--;
+  if (e.rateLimited()) {
+    stats_.rateLimited++;
+    long wait = retryAfter > 0 ? retryAfter : (backoffMsLocked(attempt) + 999) / 1000;
+    blockedUntil_ = std::max(blockedUntil_, nowSeconds() + wait);
+    retryAfter = wait;
+  } else if (!e.transient()) {
+    used_ += cost; // answered, so presumably billed
+  }
+  saveLocked();
+  bool outOfTime = dynamic_cast<const DeadlineExceeded*>(&e) != nullptr;
+  if (!e.transient() || priority != FetchPriority::Tick || attempt >= options_.maxAttempts || outOfTime) {
+    return std::current_exception();
+  }
+  if (e.rateLimited() && retryAfter > options_.maxWaitSeconds) {
+    return std::make_exception_ptr(FetchError(e.what(), e.status(), retryAfter));
+  }
+  sleepMs = e.rateLimited() ? 0 : backoffMsLocked(attempt); // a 429 waits at the gate
+  if (sleepMs >= FetchDeadlineScope::remainingMs()) {
+    // No time left for another attempt after the backoff.
+    return std::current_exception();
+  }
+  stats_.retries++;
+  if (FetchMetrics* m = FetchMetricsScope::current()) m->retries++;
+  return nullptr;
+}
+
+std::vector<Flight> QuotaScheduler::fetch(const std::string& airportIcao,
+                                          long beginUtc,
+                                          long endUtc,
+                                          FetchPriority priority) {
+  long days = partitions(beginUtc, endUtc);
+  for (int attempt = 1;; attempt++) {
+    double cost = 0;
+    long sleepMs = 0;
+    {
+      std::lock_guard<std::mutex> lock(mu_);
+      sleepMs = gateLocked(priority, attempt, days, cost);
+    }
+    if (sleepMs > 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(sleepMs));
+      continue;
+    }
+
+    try {
+      std::vector<Flight> flights = upstream_.getDepartures(airportIcao, beginUtc, endUtc);
+      std::lock_guard<std::mutex> lock(mu_);
+      succeededLocked(cost, days);
+      return flights;
+    } catch (const FetchError& e) {
+      std::lock_guard<std::mutex> lock(mu_);
+      if (std::exception_ptr error = failedLocked(e, cost, attempt, priority, sleepMs)) std::rethrow_exception(error);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mu_);
+      active_--;
+      used_ += cost;
+      saveLocked();
+      throw;
+    }
+    if (sleepMs > 0) std::this_thread::sleep_for(std::chrono::milliseconds(sleepMs));
+  }
+}
+
+void QuotaScheduler::getDeparturesBatch(const std::vector<DepartureRequest>& requests,
+                                        const DepartureCallback& done) {
+  FetchPriority priority = FetchPriorityScope::current();
+
+  struct Own {
+    size_t index = 0;
+    long days = 1;
+    double cost = 0;
+    std::promise<std::vector<Flight>> promise;
+    std::list<InFlight>::iterator slot;
+    std::vector<size_t> followers; // later requests of this batch it covers
+  };
+  struct Waiter {
+    size_t index = 0;
+    FetchPriority ownerPriority = FetchPriority::Tick;
+    std::shared_future<std::vector<Flight>> result;
+  };
+  std::vector<Own> own;
+  std::vector<Waiter> waiters;
+  own.reserve(requests.size());
+
+  // Coalesce as getDepartures() does, with earlier requests of this batch too.
+  auto covers = [](const DepartureRequest& a, const DepartureRequest& b) {
+    return a.airport == b.airport && a.beginUtc <= b.beginUtc && b.endUtc <= a.endUtc;
+  };
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    for (size_t i = 0; i < requests.size(); i++) {
+      const DepartureRequest& r = requests[i];
+      auto sibling = std::find_if(own.begin(), own.end(), [&](const Own& o) { return covers(requests[o.index], r); });
+      if (sibling != own.end()) {
+        sibling->followers.push_back(i);
+        stats_.coalesced++;
+        continue;
+      }
+      auto it = std::find_if(inFlight_.begin(), inFlight_.end(), [&](const InFlight& f) {
+        return f.airport == r.airport && f.begin <= r.beginUtc && r.endUtc <= f.end;
+      });
+      if (it != inFlight_.end()) {
+        waiters.push_back(Waiter{i, it->priority, it->result});
+        stats_.coalesced++;
+        continue;
+      }
+      Own& o = own.emplace_back();
+      o.index = i;
+      o.days = partitions(r.beginUtc, r.endUtc);
+      o.slot = inFlight_.insert(inFlight_.end(),
+                                InFlight{r.airport, r.beginUtc, r.endUtc, priority, o.promise.get_future().share()});
+    }
+  }
+
+  auto settle = [&](Own& o, std::vector<Flight> flights, std::exception_ptr error) {
+    if (error) o.promise.set_exception(error);
+    else o.promise.set_value(flights);
+    {
+      std::lock_guard<std::mutex> lock(mu_);
+      inFlight_.erase(o.slot);
+    }
+    for (size_t i : o.followers) {
+      const DepartureRequest& r = requests[i];
+      std::vector<Flight> part;
+      for (const Flight& f : flights) {
+        if (f.firstSeen >= r.beginUtc && f.firstSeen <= r.endUtc) part.push_back(f);
+      }
+      done(i, std::move(part), error);
+    }
+    done(o.index, std::move(flights), error);
+  };
+
+  std::vector<size_t> todo(own.size());
+  for (size_t k = 0; k < own.size(); k++) todo[k] = k;
+  for (int attempt = 1; !todo.empty(); attempt++) {
+    std::vector<size_t> send, later;
+    std::vector<std::pair<size_t, std::exception_ptr>> refused;
+    long sleepMs = 0;
+    {
+      std::lock_guard<std::mutex> lock(mu_);
+      for (size_t k : todo) {
+        try {
+          long wait = gateLocked(priority, attempt, own[k].days, own[k].cost);
+          if (wait > 0) {
+            later.push_back(k);
+            sleepMs = std::max(sleepMs, wait);
+          } else {
+            send.push_back(k);
+          }
+        } catch (...) {
+          refused.emplace_back(k, std::current_exception());
+        }
+      }
+    }
+    for (auto& [k, error] : refused) settle(own[k], {}, error);
+
+    if (!send.empty()) {
+      std::vector<DepartureRequest> batch;
+      for (size_t k : send) batch.push_back(requests[own[k].index]);
+      upstream_.getDeparturesBatch(batch, [&](size_t n, std::vector<Flight> flights, std::exception_ptr error) {
+        Own& o = own[send[n]];
+        if (!error) {
+          {
+            std::lock_guard<std::mutex> lock(mu_);
+            succeededLocked(o.cost, o.days);
+          }
+          settle(o, std::move(flights), nullptr);
+          return;
+        }
+        try {
+          std::rethrow_exception(error);
+        } catch (const FetchError& e) {
+          long backoff = 0;
+          {
+            std::lock_guard<std::mutex> lock(mu_);
+            error = failedLocked(e, o.cost, attempt, priority, backoff);
+          }
+          if (!error) {
+            later.push_back(send[n]);
+            sleepMs = std::max(sleepMs, backoff);
+            return;
+          }
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(mu_);
+          active_--;
+          used_ += o.cost;
+          saveLocked();
+        }
+        settle(o, {}, error);
+      });
+    }
+
+    todo.swap(later);
+    if (!todo.empty() && sleepMs > 0) std::this_thread::sleep_for(std::chrono::milliseconds(sleepMs));
+  }
+
+  for (Waiter& w : waiters) {
+    const DepartureRequest& r = requests[w.index];
+    std::vector<Flight> out;
+    std::exception_ptr error;
+    try {
+      FetchDeadlineScope::wait(w.result, "a shared OpenSky request");
+      for (const Flight& f : w.result.get()) {
+        if (f.firstSeen >= r.beginUtc && f.firstSeen <= r.endUtc) out.push_back(f);
+      }
+    } catch (const FetchError&) {
+      error = std::current_exception();
+      // As in getDepartures(): a lower-priority owner may have given up early.
+      if (priority < w.ownerPriority && FetchDeadlineScope::remainingMs() > 0) {
+        try {
+          out = fetch(r.airport, r.beginUtc, r.endUtc, priority);
+          error = nullptr;
+        } catch (...) {
+          error = std::current_exception();
+        }
+      }
+    } catch (...) {
+      error = std::current_exception();
+    }
+    done(w.index, std::move(out), error);
+  }
+}
+
+void QuotaScheduler::load() {
+  if (options_.statePath.empty() || !std::filesystem::exists(options_.statePath)) return;
+  std::string json = readFile(options_.statePath);
+  long day = (long)jsonNumber(json, "quota_day", 0);
+  blockedUntil_ = (long)jsonNumber(json, "blocked_until", 0);
+  creditsPerDay_ = std::max(0.01, jsonNumber(json, "credits_per_day", creditsPerDay_));
+  if (day == quotaDay_) {
+    used_ = jsonNumber(json, "credits_used", 0);
+    lastReported_ = (long)jsonNumber(json, "server_remaining", -1);
+  }
+}
+
+void QuotaScheduler::saveLocked() const {
+  if (options_.statePath.empty()) return;
+  std::ostringstream out;
+  out << "{\n";
+  out << "  \"quota_day\": " << quotaDay_ << ",\n";
+  out << "  \"credits_used\": " << used_ << ",\n";
+  out << "  \"credits_per_day\": " << creditsPerDay_ << ",\n";
+  out << "  \"server_remaining\": " << lastReported_ << ",\n";
+  out << "  \"blocked_until\": " << blockedUntil_ << "\n";
+  out << "}\n";
+  try {
+    writeFileAtomic(options_.statePath, out.str());
+  } catch (const std::exception& e) {
+    // Losing the quota file costs accuracy, not correctness.
+    std::cerr << "quota: " << e.what() << "\n";
+  }
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include "departure_source.h"
+
+#include <exception>
+#include <functional>
+#include <future>
+#include <list>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+struct QuotaOptions {
+  long dailyCredits = 4000;          // OpenSky's allowance for a registered user
+  double creditsPerDay = 1.0;        // first guess at the cost of each UTC day a window spans
+  double lookaheadReserve = 0.10;    // lookahead stops when less than this share is left
+  double prefetchReserve = 0.25;     // prefetch stops when less than this share is left
+  int maxAttempts = 4;               // per tick request; lookahead and prefetch fail fast
+  long baseBackoffMs = 1000;
+  long maxBackoffMs = 60000;
+  long maxWaitSeconds = 30;          // a tick waits out a shorter Retry-After instead of failing
+  std::string statePath;             // where the quota survives restarts; "" = memory only
+  std::function<long()> serverRemaining; // latest X-Rate-Limit-Remaining, -1 if unknown
+};
+
+struct QuotaStats {
+  long requests = 0;       // sent upstream, retries included
+  long coalesced = 0;      // answered by an identical request already in flight
+  long retries = 0;
+  long rateLimited = 0;    // 429s seen
+  long refused = 0;        // not sent: quota reserve or rate-limit block
+  double creditsUsed = 0;  // estimated, this quota day
+};
+
+// Spends OpenSky credits carefully.
+//
+// Sits between the departure cache and OpenSkyClient, so only real network
+// requests pass through it. Each request is charged an estimated cost (UTC days
+// spanned × creditsPerDay, corrected from X-Rate-Limit-Remaining whenever the
+// server reports it) against the daily allowance, which resets at 00:00 UTC.
+//
+//  - Priority (FetchPriorityScope): tick requests may spend the last credit;
+//    lookahead and prefetch are refused once the remaining share falls under
+//    their reserve.
+//  - Coalescing: a request whose window is covered by one already in flight
+//    waits for that one instead of paying again.
+//  - 429: the Retry-After delay blocks every request until it passes. A tick
+//    request waits if the delay is short, otherwise it fails with a FetchError
+//    carrying the delay so the engine reschedules for then.
+//  - Transport and 5xx errors: tick requests retry with exponential backoff and
+//    full jitter.
+//  - Deadline (FetchDeadlineScope): no retry, backoff or wait runs past it.
+//
+// The quota day, credits used and any block are persisted to statePath, so
+// cron-style runs (one process per tick) share one budget.
+class QuotaScheduler : public DepartureSource {
+ public:
+  explicit QuotaScheduler(DepartureSource& upstream, QuotaOptions options = {});
+
+  std::vector<Flight> getDepartures(const std::string& airportIcao,
+                                    long beginUtc,
+                                    long endUtc) override;
+
+  // The same rules per request; the admitted ones go upstream together and a
+  // retry round resends only the ones that failed transiently.
+  void getDeparturesBatch(const std::vector<DepartureRequest>& requests, const DepartureCallback& done) override;
+
+  // Credits left today (estimated).
+  double remainingCredits() const;
+  QuotaStats stats() const;
+
+  // UTC day partitions the window [beginUtc,endUtc] touches.
+  static long partitions(long beginUtc, long endUtc);
+
+ private:
+  struct InFlight {
+    std::string airport;
+    long begin = 0;
+    long end = 0;
+    FetchPriority priority = FetchPriority::Tick;
+    std::shared_future<std::vector<Flight>> result;
+  };
+
+  DepartureSource& upstream_;
+  QuotaOptions options_;
+
+  mutable std::mutex mu_;
+  std::list<InFlight> inFlight_;
+  long quotaDay_ = 0;
+  double used_ = 0;
+  long blockedUntil_ = 0;
+  double creditsPerDay_;
+  long lastReported_ = -1; // server's remaining count at the last report
+  int active_ = 0;         // requests upstream right now
+  QuotaStats stats_;
+  std::mt19937 rng_;
+
+  std::vector<Flight> fetch(const std::string& airportIcao, long beginUtc, long endUtc, FetchPriority priority);
+
+  // One attempt's bookkeeping, shared by fetch() and the batch path.
+  // gateLocked: admits the attempt (setting its cost) and returns 0, returns
+  // how many ms to wait before trying again, or throws if it may not be sent.
+  long gateLocked(FetchPriority priority, int attempt, long days, double& cost);
+  void succeededLocked(double cost, long days);
+  // Called from the handler: null to retry after `sleepMs`, else what to throw.
+  std::exception_ptr failedLocked(const FetchError& e, double cost, int attempt, FetchPriority priority,
+                                  long& sleepMs);
+  void admitLocked(double cost, FetchPriority priority, long now);
+  void rollDayLocked(long now);
+  long backoffMsLocked(int attempt);
+  void load();
+  void saveLocked() const;
+};
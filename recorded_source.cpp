@@ -0,0 +1,77 @@
+#include "recorded_source.h"
+#include "departure_index.h"
+#include "departure_parser.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+std::unique_ptr<ReplaySource> openReplay(const std::string& path) {
+  if (isDepartureIndex(path)) return std::make_unique<DepartureIndex>(path);
+  return std::make_unique<RecordedDepartures>(path);
+}
+
+RecordedDepartures::RecordedDepartures(const std::string& path) {
+  std::error_code ec;
+  if (fs::is_directory(path, ec)) {
+    std::vector<std::string> files;
+    for (const auto& entry : fs::recursive_directory_iterator(path, ec)) {
+      auto ext = entry.path().extension();
+      if (entry.is_regular_file() && (ext == ".json" || ext == ".ndjson")) files.push_back(entry.path().string());
+    }
+    std::sort(files.begin(), files.end());
+    for (const auto& f : files) loadFile(f);
+  } else if (fs::exists(path, ec)) {
+    loadFile(path);
+  } else {
+    throw std::runtime_error("No recorded departures at " + path);
+  }
+
+  for (auto& [airport, flights] : byAirport_) {
+    std::sort(flights.begin(), flights.end(), [](const Flight& a, const Flight& b) {
+      if (a.firstSeen != b.firstSeen) return a.firstSeen < b.firstSeen;
+      return a.icao24 < b.icao24;
+    });
+    // The same flight can appear in overlapping recordings.
+    flights.erase(std::unique(flights.begin(), flights.end(), [](const Flight& a, const Flight& b) {
+      return a.firstSeen == b.firstSeen && a.icao24 == b.icao24;
+    }), flights.end());
+
+    flightCount_ += flights.size();
+    if (!flights.empty()) {
+      if (earliest_ == 0 || flights.front().firstSeen < earliest_) earliest_ = flights.front().firstSeen;
+      latest_ = std::max(latest_, flights.back().firstSeen);
+    }
+  }
+}
+
+void RecordedDepartures::loadFile(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  DepartureStreamParser parser;
+  char buf[64 * 1024];
+  while (in.read(buf, sizeof(buf)) || in.gcount() > 0) parser.feed(buf, (size_t)in.gcount());
+  for (auto& f : parser.flights()) {
+    byAirport_[f.estDepartureAirport].push_back(f);
+  }
+}
+
+std::vector<Flight> RecordedDepartures::window(const std::string& airportIcao, long beginUtc, long endUtc) const {
+  auto it = byAirport_.find(AirportDict::find(airportIcao));
+  if (it == byAirport_.end()) return {};
+
+  const auto& flights = it->second;
+  auto lo = std::lower_bound(flights.begin(), flights.end(), beginUtc,
+                             [](const Flight& f, long t) { return f.firstSeen < t; });
+  auto hi = std::upper_bound(lo, flights.end(), endUtc,
+                             [](long t, const Flight& f) { return t < f.firstSeen; });
+  return std::vector<Flight>(lo, hi);
+}
+
+void RecordedDepartures::forEach(const std::function<void(const Flight&)>& visit) const {
+  for (const auto& [airport, flights] : byAirport_) {
+    for (const Flight& f : flights) visit(f);
+  }
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "departure_source.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A read-only local recording of departures: sim, mc and graph build replay
+// these instead of asking OpenSky. window() is const and safe to call from
+// many threads at once.
+class ReplaySource : public DepartureSource {
+ public:
+  std::vector<Flight> getDepartures(const std::string& airportIcao,
+                                    long beginUtc,
+                                    long endUtc) override {
+    calls_++;
+    return window(airportIcao, beginUtc, endUtc);
+  }
+
+  // getDepartures without the shared call counter, for callers that count
+  // their own (one thread per journey must not bounce a common cache line).
+  virtual std::vector<Flight> window(const std::string& airportIcao, long beginUtc, long endUtc) const = 0;
+
+  // Every recorded flight, grouped by departure airport.
+  virtual void forEach(const std::function<void(const Flight&)>& visit) const = 0;
+
+  virtual size_t flightCount() const = 0;
+  virtual long earliestDeparture() const = 0;
+  virtual long latestDeparture() const = 0;
+  long calls() const { return calls_; }
+
+ private:
+  std::atomic<long> calls_{0};
+};
+
+// A departure index (see departure_index.h) if `path` is one, else recordings.
+std::unique_ptr<ReplaySource> openReplay(const std::string& path);
+
+// Departures replayed from local files instead of OpenSky.
+//
+// Accepts OpenSky JSON responses (arrays) or NDJSON flight objects, either a
+// single file or a directory searched recursively -- so a departure_cache/
+// directory filled by live runs doubles as a recording. Flights are indexed by
+// departure airport and sorted by firstSeen; window queries are binary searches.
+class RecordedDepartures : public ReplaySource {
+ public:
+  explicit RecordedDepartures(const std::string& path);
+
+  std::vector<Flight> window(const std::string& airportIcao, long beginUtc, long endUtc) const override;
+  void forEach(const std::function<void(const Flight&)>& visit) const override;
+
+  size_t flightCount() const override { return flightCount_; }
+  long earliestDeparture() const override { return earliest_; }
+  long latestDeparture() const override { return latest_; }
+
+ private:
+  std::unordered_map<AirportId, std::vector<Flight>> byAirport_;
+  size_t flightCount_ = 0;
+  long earliest_ = 0;
+  long latest_ = 0;
+
+  void loadFile(const std::string& path);
+};
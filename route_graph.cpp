@@ -0,0 +1,224 @@
+#include "route_graph.h"
+#include "recorded_source.h"
+#include "state_io.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+constexpr char kMagic[8] = {'I', 'T', 'R', 'O', 'U', 'T', 'E', '1'};
+constexpr uint32_t kVersion = 1;
+constexpr size_t kCodeBytes = 8;
+// Outbound departures per day at which the sink score falls to 1/e.
+constexpr double kSinkScale = 2.0;
+// In a partial recording, an airport seen departing on fewer UTC days than
+// this has no usable rate and is left unknown.
+constexpr size_t kMinObservedDays = 2;
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t nodeCount;
+  uint64_t edgeCount;
+  uint64_t flights;
+  int64_t firstSeen;   // span the rates were measured over
+  int64_t lastSeen;
+  uint64_t reserved[2];
+};
+static_assert(sizeof(Header) == 64, "header is one cache line");
+
+struct Layout {
+  size_t codes, rate, offsets, targets, counts, total;
+};
+
+size_t align8(size_t n) { return (n + 7) & ~size_t(7); }
+
+Layout layout(size_t nodes, size_t edges) {
+  Layout l{};
+  l.codes = sizeof(Header);
+  l.rate = align8(l.codes + nodes * kCodeBytes);
+  l.offsets = align8(l.rate + nodes * sizeof(float));
+  l.targets = align8(l.offsets + (nodes + 1) * sizeof(uint32_t));
+  l.counts = align8(l.targets + edges * sizeof(uint32_t));
+  l.total = align8(l.counts + edges * sizeof(uint32_t));
+  return l;
+}
+
+double sinkScore(double perDay) {
+  return perDay < 0 ? 0.0 : std::exp(-perDay / kSinkScale);
+}
+
+} // namespace
+
+RouteGraphSummary buildRouteGraph(const ReplaySource& recording, const std::string& path,
+                                  bool completeCoverage) {
+  // Sorted node list first, so node indices follow code order.
+  std::map<std::string_view, uint32_t> index;
+  recording.forEach([&](const Flight& f) {
+    if (f.departure().size() <= kCodeBytes) index.emplace(f.departure(), 0);
+    if (f.arrival().size() <= kCodeBytes) index.emplace(f.arrival(), 0);
+  });
+  index.erase(std::string_view());
+  uint32_t next = 0;
+  for (auto& [code, i] : index) i = next++;
+  size_t nodes = index.size();
+
+  std::vector<uint64_t> departures(nodes, 0);
+  std::vector<std::vector<long>> activeDays(nodes); // UTC days each node was seen departing
+  std::unordered_map<uint64_t, uint32_t> edgeCounts; // (from << 32 | to) -> flights
+  RouteGraphSummary summary;
+  long firstSeen = 0, lastSeen = 0;
+  recording.forEach([&](const Flight& f) {
+    auto from = index.find(f.departure());
+    auto to = index.find(f.arrival());
+    if (from == index.end() || to == index.end() || from->second == to->second) return;
+    departures[from->second]++;
+    activeDays[from->second].push_back(f.firstSeen / 86400);
+    edgeCounts[((uint64_t)from->second << 32) | to->second]++;
+    if (firstSeen == 0 || f.firstSeen < firstSeen) firstSeen = f.firstSeen;
+    lastSeen = std::max(lastSeen, f.firstSeen);
+    summary.flights++;
+  });
+  double days = std::max(1.0, (double)(lastSeen - firstSeen) / 86400.0);
+
+  // CSR: edges grouped by source, most frequent first.
+  std::vector<std::vector<std::pair<uint32_t, uint32_t>>> out(nodes); // (count, target)
+  for (const auto& [key, count] : edgeCounts) out[key >> 32].emplace_back(count, (uint32_t)key);
+  size_t edges = edgeCounts.size();
+
+  Layout l = layout(nodes, edges);
+  std::string buf(l.total, '\0');
+  char* base = buf.data();
+
+  Header h{};
+  std::memcpy(h.magic, kMagic, sizeof(kMagic));
+  h.version = kVersion;
+  h.nodeCount = (uint32_t)nodes;
+  h.edgeCount = edges;
+  h.flights = summary.flights;
+  h.firstSeen = firstSeen;
+  h.lastSeen = lastSeen;
+  std::memcpy(base, &h, sizeof(h));
+
+  float* rate = reinterpret_cast<float*>(base + l.rate);
+  uint32_t* offsets = reinterpret_cast<uint32_t*>(base + l.offsets);
+  uint32_t* targets = reinterpret_cast<uint32_t*>(base + l.targets);
+  uint32_t* counts = reinterpret_cast<uint32_t*>(base + l.counts);
+  uint32_t e = 0;
+  for (const auto& [code, i] : index) {
+    std::memcpy(base + l.codes + (size_t)i * kCodeBytes, code.data(), code.size());
+    if (completeCoverage) {
+      rate[i] = (float)((double)departures[i] / days);
+    } else {
+      // Only the airports (and days) someone queried are in the recording, so
+      // the whole span would read a partly covered airport as a near-sink.
+      // Divide by the days it was actually seen departing instead.
+      std::vector<long>& seen = activeDays[i];
+      std::sort(seen.begin(), seen.end());
+      size_t observedDays = (size_t)(std::unique(seen.begin(), seen.end()) - seen.begin());
+      rate[i] = observedDays >= kMinObservedDays ? (float)((double)departures[i] / (double)observedDays) : -1.0f;
+    }
+
+    auto& list = out[i];
+    std::sort(list.begin(), list.end(), [](const auto& a, const auto& b) {
+      if (a.first != b.first) return a.first > b.first;
+      return a.second < b.second;
+    });
+    offsets[i] = e;
+    for (const auto& [count, target] : list) {
+      targets[e] = target;
+      counts[e] = count;
+      e++;
+    }
+  }
+  offsets[nodes] = e;
+
+  writeFileAtomic(path, buf);
+  summary.nodes = nodes;
+  summary.edges = edges;
+  summary.days = days;
+  return summary;
+}
+
+RouteGraph::RouteGraph(const std::string& path) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) throw std::runtime_error("Cannot open route graph " + path + ": " + std::strerror(errno));
+  struct stat st {};
+  if (::fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(Header)) {
+    ::close(fd);
+    throw std::runtime_error("Not a route graph: " + path);
+  }
+  size_ = (size_t)st.st_size;
+  void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED) throw std::runtime_error("Cannot map route graph " + path + ": " + std::strerror(errno));
+  base_ = p;
+
+  const char* base = static_cast<const char*>(base_);
+  Header h;
+  std::memcpy(&h, base, sizeof(h));
+  Layout l = layout(h.nodeCount, h.edgeCount);
+  if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 || h.version != kVersion || l.total > size_) {
+    ::munmap(base_, size_);
+    throw std::runtime_error("Not a route graph (or wrong version): " + path);
+  }
+  nodeCount_ = h.nodeCount;
+  edgeCount_ = h.edgeCount;
+  spanDays_ = std::max(1.0, (double)(h.lastSeen - h.firstSeen) / 86400.0);
+  codes_ = base + l.codes;
+  rate_ = reinterpret_cast<const float*>(base + l.rate);
+  offsets_ = reinterpret_cast<const uint32_t*>(base + l.offsets);
+  targets_ = reinterpret_cast<const uint32_t*>(base + l.targets);
+  counts_ = reinterpret_cast<const uint32_t*>(base + l.counts);
+  if (offsets_[nodeCount_] != edgeCount_) {
+    ::munmap(base_, size_);
+    throw std::runtime_error("Corrupt route graph: " + path);
+  }
+
+  // Per-AirportId sink scores, so scoring never searches the graph.
+  for (uint32_t i = 0; i < nodeCount_; i++) {
+    AirportId id = AirportDict::intern(code(i));
+    if (id >= sinkById_.size()) sinkById_.resize((size_t)id + 1, 0.0);
+    sinkById_[id] = sinkScore(rate_[i]);
+  }
+}
+
+RouteGraph::~RouteGraph() {
+  if (base_) ::munmap(base_, size_);
+}
+
+std::string_view RouteGraph::code(uint32_t node) const {
+  const char* c = codes_ + (size_t)node * kCodeBytes;
+  return std::string_view(c, strnlen(c, kCodeBytes));
+}
+
+long RouteGraph::node(std::string_view icao) const {
+  size_t lo = 0, hi = nodeCount_;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (code((uint32_t)mid) < icao) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo < nodeCount_ && code((uint32_t)lo) == icao ? (long)lo : -1;
+}
+
+double RouteGraph::outboundPerDay(uint32_t node) const { return rate_[node]; }
+
+RouteGraph::Edges RouteGraph::edges(uint32_t node) const {
+  Edges e;
+  e.targets = targets_ + offsets_[node];
+  e.counts = counts_ + offsets_[node];
+  e.size = offsets_[node + 1] - offsets_[node];
+  return e;
+}
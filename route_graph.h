@@ -0,0 +1,86 @@
+#pragma once
+#include "departure_source.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class ReplaySource;
+
+// Airport connectivity learned from recorded departures, stored as a compact
+// CSR graph and memory-mapped read-only by the engine.
+//
+// File layout (native endianness, every section 8-byte aligned):
+//   header   magic "ITROUTE1", version, node/edge counts, observed time span
+//   codes    nodeCount x 8-byte ICAO codes, sorted
+//   rate     nodeCount x float, departures per day (-1 = unknown)
+//   offsets  (nodeCount + 1) x uint32, each node's first edge
+//   targets  edgeCount x uint32 node indices, most frequent first per node
+//   counts   edgeCount x uint32 flights on the edge
+//
+// sink() turns the outbound rate into the 0..1 column the scoring kernel
+// penalises: 1 for an airport nothing ever leaves, near 0 for a hub, 0 when
+// the graph knows nothing about the airport.
+
+struct RouteGraphSummary {
+  size_t nodes = 0;
+  size_t edges = 0;
+  size_t flights = 0;
+  double days = 0;
+};
+
+// Writes the graph for `recording` to `path`. With completeCoverage the
+// recording is taken to hold every departure in its time span (e.g. a full
+// flight-list dump), so rates are over the whole span and airports that only
+// ever appear as destinations are stored as definite sinks. Otherwise (e.g.
+// departure_cache/, which only holds the airports and days the traveler
+// queried) each airport's rate is over the days it was seen departing, and
+// airports seen on too few days are left unknown.
+RouteGraphSummary buildRouteGraph(const ReplaySource& recording, const std::string& path,
+                                  bool completeCoverage);
+
+class RouteGraph {
+ public:
+  struct Edges {
+    const uint32_t* targets = nullptr;
+    const uint32_t* counts = nullptr;
+    size_t size = 0;
+  };
+
+  // Throws std::runtime_error if the file is missing or malformed.
+  explicit RouteGraph(const std::string& path);
+  ~RouteGraph();
+
+  RouteGraph(const RouteGraph&) = delete;
+  RouteGraph& operator=(const RouteGraph&) = delete;
+
+  size_t nodeCount() const { return nodeCount_; }
+  size_t edgeCount() const { return edgeCount_; }
+  double spanDays() const { return spanDays_; }
+
+  // Node index for an ICAO code, or -1.
+  long node(std::string_view icao) const;
+  std::string_view code(uint32_t node) const;
+  double outboundPerDay(uint32_t node) const; // -1 = unknown
+  Edges edges(uint32_t node) const;
+
+  // Dead-end score for a destination, as described above. Lock-free.
+  double sink(AirportId airport) const {
+    return airport < sinkById_.size() ? sinkById_[airport] : 0.0;
+  }
+
+ private:
+  void* base_ = nullptr;
+  size_t size_ = 0;
+  size_t nodeCount_ = 0;
+  size_t edgeCount_ = 0;
+  double spanDays_ = 0;
+  const char* codes_ = nullptr;
+  const float* rate_ = nullptr;
+  const uint32_t* offsets_ = nullptr;
+  const uint32_t* targets_ = nullptr;
+  const uint32_t* counts_ = nullptr;
+  std::vector<double> sinkById_; // by AirportId; every node is interned at load
+};
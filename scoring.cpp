@@ -0,0 +1,103 @@
+#include "scoring.h"
+
+#include <algorithm>
+#include <numeric>
+
+Personality parsePersonality(std::string_view name) {
+  if (name == "chaotic") return Personality::Chaotic;
+  if (name == "budget") return Personality::Budget;
+  if (name == "scenic") return Personality::Scenic;
+  if (name == "explorer") return Personality::Explorer;
+  return Personality::Default;
+}
+
+const char* personalityName(Personality p) {
+  switch (p) {
+    case Personality::Chaotic:  return "chaotic";
+    case Personality::Budget:   return "budget";
+    case Personality::Scenic:   return "scenic";
+    case Personality::Explorer: return "explorer";
+    case Personality::Default:  break;
+  }
+  return "default";
+}
+
+template <class Policy>
+static void run(ScoreColumns& c) {
+  scoreBatch<Policy>(c.durationHours.data(), c.distanceKm.data(), c.hub.data(), c.novelty.data(), c.sink.data(), c.jitter.data(), c.score.data(),
+                     c.size());
+}
+
+void scoreBatch(Personality personality, ScoreColumns& cols) {
+  switch (personality) {
+    case Personality::Chaotic:  run<ChaoticPolicy>(cols); break;
+    case Personality::Budget:   run<BudgetPolicy>(cols); break;
+    case Personality::Scenic:   run<ScenicPolicy>(cols); break;
+    case Personality::Explorer: run<ExplorerPolicy>(cols); break;
+    case Personality::Default:  run<DefaultPolicy>(cols); break;
+  }
+}
+
+template <class Policy>
+static ScoringParams paramsOf() {
+  ScoringParams p;
+  p.wNovel = Policy::wNovel;
+  p.wShort = Policy::wShort;
+  p.wLong = Policy::wLong;
+  p.wJit = Policy::wJit;
+  p.wSink = Policy::wSink;
+  p.wFar = Policy::wFar;
+  p.wHub = Policy::wHub;
+  return p;
+}
+
+ScoringParams scoringParams(Personality personality) {
+  switch (personality) {
+    case Personality::Chaotic:  return paramsOf<ChaoticPolicy>();
+    case Personality::Budget:   return paramsOf<BudgetPolicy>();
+    case Personality::Scenic:   return paramsOf<ScenicPolicy>();
+    case Personality::Explorer: return paramsOf<ExplorerPolicy>();
+    case Personality::Default:  break;
+  }
+  return paramsOf<DefaultPolicy>();
+}
+
+void scoreBatch(const ScoringParams& p, ScoreColumns& cols) {
+  const double* __restrict durationHours = cols.durationHours.data();
+  const double* __restrict distanceKm = cols.distanceKm.data();
+  const double* __restrict hub = cols.hub.data();
+  const double* __restrict novelty = cols.novelty.data();
+  const double* __restrict sink = cols.sink.data();
+  const double* __restrict jitter = cols.jitter.data();
+  double* __restrict out = cols.score.data();
+  size_t n = cols.size();
+  for (size_t i = 0; i < n; i++) {
+    double d = durationHours[i];
+    double s = p.wNovel * novelty[i] + p.wJit * jitter[i];
+    // A zero weight adds exactly zero, matching the policy kernel's skipped term.
+    s += p.wShort * expNonPositive(-d * 0.5);
+    s += p.wLong * (d < 6.0 ? d / 6.0 : 1.0);
+    s += p.wFar * (distanceKm[i] < kFarKm ? distanceKm[i] / kFarKm : 1.0);
+    s += p.wHub * hub[i];
+    out[i] = s - p.wSink * sink[i];
+  }
+}
+
+void fillJitter(std::mt19937& rng, double* out, size_t n) {
+  // A 32-bit draw scaled into range; uniform_real_distribution<double> would
+  // take two draws per value.
+  constexpr double scale = 0.1 / 4294967296.0;
+  for (size_t i = 0; i < n; i++) out[i] = (double)rng() * scale - 0.05;
+}
+
+std::vector<uint32_t> topK(const std::vector<double>& scores, size_t k) {
+  k = std::min(k, scores.size());
+  std::vector<uint32_t> idx(scores.size());
+  std::iota(idx.begin(), idx.end(), 0u);
+  std::partial_sort(idx.begin(), idx.begin() + (long)k, idx.end(), [&scores](uint32_t a, uint32_t b) {
+    if (scores[a] != scores[b]) return scores[a] > scores[b];
+    return a < b;
+  });
+  idx.resize(k);
+  return idx;
+}
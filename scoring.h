@@ -0,0 +1,123 @@
+#pragma once
+#include <cstdint>
+#include <random>
+#include <string_view>
+#include <vector>
+
+// Candidate scoring as a batch kernel.
+//
+// tick() gathers each candidate's inputs into columns (duration, distance,
+// destination size, novelty, sink, jitter), then one loop per personality turns them into scores. The
+// personality is resolved once per batch into a policy type, so the weights are
+// compile-time constants inside the loop and the loop body has no branches.
+
+enum class Personality : uint8_t { Default, Chaotic, Budget, Scenic, Explorer };
+
+Personality parsePersonality(std::string_view name);
+const char* personalityName(Personality p); // "default" for Default
+
+// wSink is subtracted for a destination the route graph predicts is a dead end.
+// wFar rewards great-circle distance and wHub a large destination airport
+// (both from airport_db.h; zero for airports it does not know).
+struct DefaultPolicy  { static constexpr double wNovel = 0.6, wShort = 0.2, wLong = 0.2, wJit = 0.1,  wSink = 0.4, wFar = 0.1, wHub = 0.1; };
+struct ChaoticPolicy  { static constexpr double wNovel = 0.8, wShort = 0.1, wLong = 0.1, wJit = 0.25, wSink = 0.2, wFar = 0.0, wHub = 0.0; };
+struct BudgetPolicy   { static constexpr double wNovel = 0.5, wShort = 0.6, wLong = 0.0, wJit = 0.08, wSink = 0.4, wFar = 0.0, wHub = 0.2; };
+struct ScenicPolicy   { static constexpr double wNovel = 0.5, wShort = 0.0, wLong = 0.3, wJit = 0.08, wSink = 0.3, wFar = 0.4, wHub = 0.0; };
+struct ExplorerPolicy { static constexpr double wNovel = 0.9, wShort = 0.1, wLong = 0.1, wJit = 0.1,  wSink = 0.5, wFar = 0.1, wHub = -0.1; };
+
+// Distance at which wFar's term saturates.
+constexpr double kFarKm = 4000.0;
+
+// Novelty column values.
+constexpr double kNoveltyNew = 1.0;
+constexpr double kNoveltySeen = 0.0;    // visited at some point (explorer only)
+constexpr double kNoveltyRecent = -0.5; // in the recent window
+
+struct ScoreColumns {
+  std::vector<double> durationHours;
+  std::vector<double> distanceKm; // from the table, else from the duration; 0 = unknown
+  std::vector<double> hub;        // 0 = small or unknown .. 1 = large airport
+  std::vector<double> novelty;
+  std::vector<double> sink;   // 0 = well connected or unknown .. 1 = no departures at all
+  std::vector<double> jitter;
+  std::vector<double> score;
+
+  void resize(size_t n) {
+    durationHours.resize(n);
+    distanceKm.resize(n);
+    hub.resize(n);
+    novelty.resize(n);
+    sink.resize(n);
+    jitter.resize(n);
+    score.resize(n);
+  }
+  size_t size() const { return score.size(); }
+};
+
+// exp(x) for x <= 0, written so the compiler can vectorise it (std::exp is an
+// opaque libm call). Max relative error against std::exp over [-700, 0] is
+// 9.4e-12 (scoring_bench's exp_accuracy case) -- far under the jitter.
+inline double expNonPositive(double x) {
+  x = x < -700.0 ? -700.0 : x;
+  constexpr double log2e = 1.4426950408889634;
+  constexpr double ln2hi = 6.93145751953125e-1, ln2lo = 1.42860682030941723212e-6;
+  // Adding 1.5*2^52 rounds to an integer in the low mantissa bits: no
+  // float<->int conversions, which would stop the loop from vectorising.
+  constexpr double shifter = 6755399441055744.0;
+  double kShifted = x * log2e + shifter;
+  double k = kShifted - shifter;
+  double r = (x - k * ln2hi) - k * ln2lo;  // |r| <= ln2/2
+  double p = 1.0 + r * (1.0 + r * (1.0 / 2 + r * (1.0 / 6 + r * (1.0 / 24 + r * (1.0 / 120
+           + r * (1.0 / 720 + r * (1.0 / 5040 + r * (1.0 / 40320 + r * (1.0 / 362880)))))))));
+  // Scale by 2^k through the exponent bits.
+  uint64_t bits;
+  __builtin_memcpy(&bits, &kShifted, sizeof(bits));
+  bits = (bits + 1023) << 52;
+  double scale;
+  __builtin_memcpy(&scale, &bits, sizeof(scale));
+  return p * scale;
+}
+
+template <class Policy>
+void scoreBatch(const double* __restrict durationHours,
+                const double* __restrict distanceKm,
+                const double* __restrict hub,
+                const double* __restrict novelty,
+                const double* __restrict sink,
+                const double* __restrict jitter,
+                double* __restrict out,
+                size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    double d = durationHours[i];
+    double s = Policy::wNovel * novelty[i] + Policy::wJit * jitter[i];
+    if constexpr (Policy::wShort != 0.0) s += Policy::wShort * expNonPositive(-d * 0.5);
+    if constexpr (Policy::wLong != 0.0) s += Policy::wLong * (d < 6.0 ? d / 6.0 : 1.0);
+    if constexpr (Policy::wFar != 0.0) s += Policy::wFar * (distanceKm[i] < kFarKm ? distanceKm[i] / kFarKm : 1.0);
+    if constexpr (Policy::wHub != 0.0) s += Policy::wHub * hub[i];
+    out[i] = s - Policy::wSink * sink[i];
+  }
+}
+
+// Picks the policy once, then runs the kernel over all columns.
+void scoreBatch(Personality personality, ScoreColumns& cols);
+
+// Weights as runtime values, for tuning runs (traveler mc); the live path keeps
+// the compile-time policies. Defaults are DefaultPolicy and tick()'s exploration.
+struct ScoringParams {
+  double wNovel = 0.6, wShort = 0.2, wLong = 0.2, wJit = 0.1, wSink = 0.4, wFar = 0.1, wHub = 0.1;
+  double exploreRate = 0.10; // chance of a uniform pick among the best exploreTopN
+  int exploreTopN = 5;
+};
+
+ScoringParams scoringParams(Personality personality);
+
+// Same arithmetic as the policy kernel, so a personality's own parameters
+// reproduce its scores exactly.
+void scoreBatch(const ScoringParams& params, ScoreColumns& cols);
+
+// Scoring jitter in [-0.05, 0.05), one generator draw per candidate.
+void fillJitter(std::mt19937& rng, double* out, size_t n);
+
+// Positions of the k highest scores, best first; ties go to the lower position.
+// O(n log k) instead of sorting everything.
+std::vector<uint32_t> topK(const std::vector<double>& scores, size_t k);
@@ -0,0 +1,54 @@
+#include "simulation.h"
+#include "state_io.h"
+
+#include <chrono>
+
+SimReport runSimulation(DepartureSource& source,
+                        TravelerState& st,
+                        long& hopCount,
+                        const SimOptions& options) {
+  SimReport report;
+
+  long now = options.startUtc;
+  if (now == 0) now = st.sim_time_utc + st.lag_seconds;
+  long end = now + (long)(options.days * 86400);
+  report.startUtc = now;
+  report.endUtc = end;
+
+  // next_event_utc in a loaded state refers to the real clock; start right away.
+  st.next_event_utc = 0;
+
+  TravelerEngine engine(source, options.routes);
+  engine.seed(options.seed);
+  if (options.scoring) engine.setScoringParams(*options.scoring);
+
+  bool logging = !options.logPath.empty();
+  if (logging) writeFile(options.logPath, "");
+
+  auto t0 = std::chrono::steady_clock::now();
+  TravelerState before; // only copied when there is a log to write
+  while (now < end) {
+    if (logging) before = st;
+    HopResult hop = engine.tick(st, now);
+    report.ticks++;
+
+    if (hop.didHop) {
+      hopCount += 1;
+      report.hops++;
+      if (logging) appendLogNdjson(options.logPath, now, before, hop, st, hopCount);
+    }
+
+    // Jump the virtual clock straight to the next wake-up.
+    long next = st.next_event_utc > now ? st.next_event_utc : now + options.idleStepSeconds;
+    if (!hop.didHop) report.strandedHours += (double)(next - now) / 3600.0;
+    now = next;
+  }
+  report.airports = st.visited_airports.count();
+
+  report.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  if (report.wallSeconds > 0) {
+    report.ticksPerSec = report.ticks / report.wallSeconds;
+    report.hopsPerSec = report.hops / report.wallSeconds;
+  }
+  return report;
+}
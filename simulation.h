@@ -0,0 +1,39 @@
+#pragma once
+#include "departure_source.h"
+#include "traveler.h"
+
+#include <cstdint>
+#include <string>
+
+// Time-warp simulation: drives TravelerEngine with a virtual clock instead of
+// wall-clock cron runs. Each iteration jumps straight to next_event_utc, so
+// weeks of story time replay in seconds against a local DepartureSource.
+
+struct SimOptions {
+  long startUtc = 0;                        // virtual "now" at start; 0 = derived from state
+  double days = 14;                         // virtual time to simulate
+  uint32_t seed = 1;                        // engine RNG seed, for reproducible runs
+  std::string logPath = "sim_trip_log.ndjson"; // "" = no trip log
+  long idleStepSeconds = 5 * 60;            // clock step when the engine asks for no later time
+  const RouteGraph* routes = nullptr;       // dead-end prediction for scoring; optional
+  const ScoringParams* scoring = nullptr;   // overrides the personality's weights; optional
+};
+
+struct SimReport {
+  long ticks = 0;
+  long hops = 0;
+  double strandedHours = 0;                 // virtual time after ticks that found nothing to board
+  size_t airports = 0;                      // distinct airports visited, as recorded in the state
+  long startUtc = 0;
+  long endUtc = 0;
+  double wallSeconds = 0;
+  double ticksPerSec = 0;
+  double hopsPerSec = 0;
+};
+
+// Runs `st` forward; `hopCount` continues from its current value. Hops are
+// appended to options.logPath in the trip_log.ndjson format.
+SimReport runSimulation(DepartureSource& source,
+                        TravelerState& st,
+                        long& hopCount,
+                        const SimOptions& options);
@@ -0,0 +1,352 @@
+#include "state_io.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <ctime>
+#include <cctype>
+
+std::string readFile(const std::string& path) {
+  std::ifstream in(path);
+  std::ostringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+
+void writeFile(const std::string& path, const std::string& data) {
+  std::ofstream out(path, std::ios::trunc);
+  out << data;
+}
+
+void writeFileAtomic(const std::string& path, const std::string& data) {
+  std::string tmp = path + ".tmp";
+  int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) throw std::runtime_error("Cannot write " + tmp + ": " + std::strerror(errno));
+  size_t off = 0;
+  while (off < data.size()) {
+    ssize_t n = ::write(fd, data.data() + off, data.size() - off);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) {
+      int err = errno;
+      ::close(fd);
+      throw std::runtime_error("Cannot write " + tmp + ": " + std::strerror(err));
+    }
+    off += (size_t)n;
+  }
+  if (::fsync(fd) != 0 || ::close(fd) != 0) {
+    throw std::runtime_error("Cannot flush " + tmp + ": " + std::strerror(errno));
+  }
+  if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+    throw std::runtime_error("Cannot replace " + path + ": " + std::strerror(errno));
+  }
+}
+
+static std::string extractJsonString(const std::string& json, const std::string& key, const std::string& def="") {
+  std::string pattern = "\"" + key + "\":";
+  auto p = json.find(pattern);
+  if (p == std::string::npos) return def;
+  p += pattern.size();
+  while (p < json.size() && std::isspace((unsigned char)json[p])) p++;
+  if (p >= json.size()) return def;
+  if (json.compare(p, 4, "null") == 0) return def;
+  if (json[p] != '"') return def;
+  p++;
+  auto q = json.find('"', p);
+  if (q == std::string::npos) return def;
+  return json.substr(p, q - p);
+}
+
+static long extractJsonLong(const std::string& json, const std::string& key, long def=0) {
+  std::string pattern = "\"" + key + "\":";
+  auto p = json.find(pattern);
+  if (p == std::string::npos) return def;
+  p += pattern.size();
+  while (p < json.size() && std::isspace((unsigned char)json[p])) p++;
+  if (p >= json.size()) return def;
+  if (json.compare(p, 4, "null") == 0) return def;
+  size_t q = p;
+  while (q < json.size() && (std::isdigit((unsigned char)json[q]) || json[q] == '-')) q++;
+  try { return std::stol(json.substr(p, q - p)); } catch (...) { return def; }
+}
+
+static int extractJsonInt(const std::string& json, const std::string& key, int def=0) {
+  return (int)extractJsonLong(json, key, def);
+}
+
+static std::vector<std::string> extractStringArray(const std::string& json, const std::string& name) {
+  std::vector<std::string> out;
+  std::string key = "\"" + name + "\":";
+  auto p = json.find(key);
+  if (p == std::string::npos) return out;
+  p = json.find('[', p);
+  auto q = json.find(']', p);
+  if (p == std::string::npos || q == std::string::npos || q <= p) return out;
+  std::string arr = json.substr(p + 1, q - p - 1);
+
+  size_t i = 0;
+  while (true) {
+    auto a = arr.find('"', i);
+    if (a == std::string::npos) break;
+    auto b = arr.find('"', a + 1);
+    if (b == std::string::npos) break;
+    out.push_back(arr.substr(a + 1, b - a - 1));
+    i = b + 1;
+  }
+  return out;
+}
+
+static long extractJsonHopCount(const std::string& json) {
+  return extractJsonLong(json, "hop_count", 0);
+}
+
+TravelerState loadState(const std::string& path, long& hopCount) {
+  TravelerState st;
+  std::string json = readFile(path);
+
+  st.current_airport = extractJsonString(json, "current_airport", "KCVG");
+  st.sim_time_utc    = extractJsonLong(json, "sim_time_utc", 0);
+  st.next_event_utc  = extractJsonLong(json, "next_event_utc", 0);
+  st.lag_seconds     = extractJsonLong(json, "lag_seconds", 86400);
+  st.lookback_hours  = extractJsonInt(json, "lookback_hours", 36);
+  st.avoid_recent_n  = extractJsonInt(json, "avoid_recent_n", 10);
+  st.lookahead_depth = extractJsonInt(json, "lookahead_depth", 0);
+  st.lookahead_beam  = extractJsonInt(json, "lookahead_beam", 3);
+
+  st.recent_airports.setCapacity(st.avoid_recent_n);
+  for (const auto& a : extractStringArray(json, "recent_airports")) {
+    st.recent_airports.push(AirportDict::intern(a));
+  }
+  // Older state files have no lifetime set; seed it with what we do know.
+  for (const auto& a : extractStringArray(json, "visited_airports")) {
+    st.visited_airports.insert(AirportDict::intern(a));
+  }
+  for (AirportId id : st.recent_airports.inOrder()) st.visited_airports.insert(id);
+  st.visited_airports.insert(AirportDict::intern(st.current_airport));
+
+  st.personality     = extractJsonString(json, "personality", "chaotic");
+  hopCount           = extractJsonHopCount(json);
+  st.generation      = extractJsonLong(json, "generation", 0);
+  st.fence           = extractJsonLong(json, "fence", 0);
+
+  return st;
+}
+
+std::string toJson(const TravelerState& st, long hopCount) {
+  std::ostringstream o;
+  o << "{\n";
+  o << "  \"current_airport\": \"" << st.current_airport << "\",\n";
+  o << "  \"sim_time_utc\": " << st.sim_time_utc << ",\n";
+  o << "  \"next_event_utc\": " << st.next_event_utc << ",\n";
+  o << "  \"lag_seconds\": " << st.lag_seconds << ",\n";
+  o << "  \"lookback_hours\": " << st.lookback_hours << ",\n";
+  o << "  \"avoid_recent_n\": " << st.avoid_recent_n << ",\n";
+  o << "  \"lookahead_depth\": " << st.lookahead_depth << ",\n";
+  o << "  \"lookahead_beam\": " << st.lookahead_beam << ",\n";
+  o << "  \"hop_count\": " << hopCount << ",\n";
+  o << "  \"generation\": " << st.generation << ",\n";
+  o << "  \"fence\": " << st.fence << ",\n";
+  o << "  \"personality\": \"" << st.personality << "\",\n";
+  auto writeAirports = [&o](const std::vector<AirportId>& ids) {
+    o << "[";
+    for (size_t i = 0; i < ids.size(); i++) {
+      o << "\"" << AirportDict::name(ids[i]) << "\"";
+      if (i + 1 < ids.size()) o << ", ";
+    }
+    o << "]";
+  };
+  o << "  \"recent_airports\": ";
+  writeAirports(st.recent_airports.inOrder());
+  o << ",\n";
+  // Sorted by name so the file diffs cleanly between runs.
+  std::vector<AirportId> visited = st.visited_airports.ids();
+  std::sort(visited.begin(), visited.end(), [](AirportId a, AirportId b) {
+    return AirportDict::name(a) < AirportDict::name(b);
+  });
+  o << "  \"visited_airports\": ";
+  writeAirports(visited);
+  o << "\n";
+  o << "}\n";
+  return o.str();
+}
+
+bool stateIsCurrent(const std::string& path, const TravelerState& st, long token) {
+  std::string json = readFile(path);
+  return extractJsonLong(json, "generation", 0) == st.generation && extractJsonLong(json, "fence", 0) <= token;
+}
+
+long stateFence(const std::string& path) {
+  return extractJsonLong(readFile(path), "fence", 0);
+}
+
+void commitState(const std::string& path, TravelerState& st, long hopCount, long token) {
+  if (toJson(st, hopCount) == readFile(path)) return; // nothing changed; keep the file (and its git diff) clean
+  st.generation += 1;
+  st.fence = token;
+  writeFileAtomic(path, toJson(st, hopCount));
+}
+
+TripRecord makeTripRecord(long loggedAtUtc,
+                          const TravelerState& before,
+                          const HopResult& hop,
+                          const TravelerState& after,
+                          long hopNumber) {
+  TripRecord r;
+  r.hop = hopNumber;
+  r.loggedAtUtc = loggedAtUtc;
+  r.departUtc = hop.depart_utc;
+  r.arriveUtc = hop.arrive_utc;
+  r.icao24 = hop.flight.icao24;
+  r.callsign = hop.flight.callsignStr();
+  r.from = before.current_airport;
+  r.to = after.current_airport;
+  r.reason = hop.reason;
+  return r;
+}
+
+void appendLogNdjson(const std::string& path,
+                     long loggedAtUtc,
+                     const TravelerState& before,
+                     const HopResult& hop,
+                     const TravelerState& after,
+                     long hopNumber) {
+  std::ofstream out(path, std::ios::app);
+  out << tripRecordJson(makeTripRecord(loggedAtUtc, before, hop, after, hopNumber)) << "\n";
+}
+
+static std::string formatUtc(long t) {
+  std::time_t tt = (std::time_t)t;
+  std::tm g{};
+#if defined(_WIN32)
+  gmtime_s(&g, &tt);
+#else
+  g = *std::gmtime(&tt);
+#endif
+  char buf[64];
+  std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M UTC", &g);
+  return std::string(buf);
+}
+
+void writeLatestCaption(const std::string& path,
+                        const std::string& from,
+                        const std::string& to,
+                        long hopNumber,
+                        long departUtc,
+                        long arriveUtc,
+                        const std::string& callsign,
+                        const std::string& personality,
+                        const std::string& vibeLine) {
+  std::ostringstream c;
+  c << "Hop #" << hopNumber << " ✈️\n";
+  c << from << " → " << to << "\n";
+  if (!callsign.empty()) c << "Flight: " << callsign << "\n";
+  c << "Depart: " << formatUtc(departUtc) << "\n";
+  c << "Arrive: " << formatUtc(arriveUtc) << "\n\n";
+  c << "Personality: " << personality << "\n";
+  c << vibeLine << "\n\n";
+  c << "#airport #travel #aviation #wanderlust #planespotting\n";
+  writeFile(path, c.str());
+}
+
+void writeLatestPostJson(const std::string& path,
+                         const TravelerState& before,
+                         const TravelerState& after,
+                         const HopResult& hop,
+                         long hopNumber) {
+  std::ostringstream j;
+  j << "{\n";
+  j << "  \"hop\": " << hopNumber << ",\n";
+  j << "  \"from\": \"" << before.current_airport << "\",\n";
+  j << "  \"to\": \"" << after.current_airport << "\",\n";
+  j << "  \"depart_utc\": " << hop.depart_utc << ",\n";
+  j << "  \"arrive_utc\": " << hop.arrive_utc << ",\n";
+  j << "  \"icao24\": \"" << hop.flight.icao24Hex() << "\",\n";
+  j << "  \"callsign\": \"" << hop.flight.callsignStr() << "\",\n";
+  j << "  \"reason\": \"" << hop.reason << "\"\n";
+  j << "}\n";
+  writeFile(path, j.str());
+}
+
+std::string vibeLine(const std::string& personality) {
+  if (personality == "chaotic") return "Current mood: unhinged boarding pass energy.";
+  if (personality == "budget") return "Current mood: saving money like it’s a sport.";
+  if (personality == "scenic") return "Current mood: window seat supremacy.";
+  if (personality == "explorer") return "Current mood: new airport or bust.";
+  return "Current mood: gate snacks + main character energy.";
+}
+
+std::string describeTick(const TravelerState& before, const HopResult& hop, const TravelerState& after) {
+  std::ostringstream o;
+  if (hop.didHop) {
+    o << "HOP: " << before.current_airport << " -> " << after.current_airport
+      << " depart=" << hop.depart_utc
+      << " arrive=" << hop.arrive_utc
+      << " next_event_utc=" << after.next_event_utc;
+  } else {
+    o << "NO HOP: " << hop.reason
+      << " next_event_utc=" << after.next_event_utc
+      << " sim_time_utc=" << after.sim_time_utc;
+  }
+  return o.str();
+}
+
+std::string tickMetricsJson(long atUtc, const std::string& airport, const HopResult& hop) {
+  const TickMetrics& m = hop.metrics;
+  const FetchMetrics& f = m.fetch;
+  std::ostringstream o;
+  o.setf(std::ios::fixed);
+  o.precision(3);
+  o << "{\"at_utc\":" << atUtc << ",\"airport\":\"" << airport << "\",\"hop\":" << (hop.didHop ? "true" : "false")
+    << ",\"ms\":{\"state_load\":" << m.stateLoadMs << ",\"fetch\":" << m.fetchMs
+    << ",\"dns\":" << f.dnsMs << ",\"connect\":" << f.connectMs << ",\"tls\":" << f.tlsMs
+    << ",\"wait\":" << f.waitMs << ",\"transfer\":" << f.transferMs << ",\"parse\":" << f.parseMs
+    << ",\"filter\":" << m.filterMs << ",\"score\":" << m.scoreMs << ",\"select\":" << m.selectMs
+    << ",\"state_write\":" << m.stateWriteMs << ",\"tick\":" << m.tickMs << ",\"budget\":" << m.budgetMs << "}"
+    << ",\"deadline_hit\":" << (m.deadlineHit ? "true" : "false") << ",\"partial\":" << (m.partial ? "true" : "false")
+    << ",\"requests\":" << f.requests << ",\"retries\":" << f.retries << ",\"hedges\":" << f.hedges
+    << ",\"bytes_downloaded\":" << f.bytesDownloaded << ",\"flights_parsed\":" << f.flightsParsed
+    << ",\"credits\":" << f.creditsCharged
+    << ",\"flights\":" << m.flights << ",\"candidates\":" << m.candidates << "}";
+  return o.str();
+}
+
+void appendTickMetrics(const std::string& path, long atUtc, const std::string& airport, const HopResult& hop) {
+  std::ofstream out(path, std::ios::app);
+  out << tickMetricsJson(atUtc, airport, hop) << "\n";
+}
+
+void writeHopOutputs(const std::string& dir,
+                     long loggedAtUtc,
+                     const TravelerState& before,
+                     const HopResult& hop,
+                     const TravelerState& after,
+                     long hopNumber) {
+  namespace fs = std::filesystem;
+  fs::path base(dir);
+  std::string ndjson = (base / "trip_log.ndjson").string();
+
+  // The binary log is what queries use; a log that does not exist yet starts
+  // from the existing NDJSON history. NDJSON keeps being written for
+  // compatibility, so a failure here only costs the binary copy of this hop.
+  try {
+    TripLog log((base / "trip_log").string());
+    if (log.hopCount() == 0) importTripNdjson(log, ndjson);
+    if (hopNumber > log.lastHop()) log.append(makeTripRecord(loggedAtUtc, before, hop, after, hopNumber));
+  } catch (const std::exception& e) {
+    std::cerr << "trip log: " << e.what() << "\n";
+  }
+  appendLogNdjson(ndjson, loggedAtUtc, before, hop, after, hopNumber);
+  writeLatestCaption((base / "latest_caption.txt").string(),
+                     before.current_airport, after.current_airport, hopNumber,
+                     hop.depart_utc, hop.arrive_utc, hop.flight.callsignStr(),
+                     after.personality, vibeLine(after.personality));
+  writeLatestPostJson((base / "latest_post.json").string(), before, after, hop, hopNumber);
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "traveler.h"
+#include "trip_log.h"
+
+#include <string>
+
+// Persistence helpers for a single traveler: state.json, trip_log.ndjson and
+// the "latest post" files. Shared by the single-run, fleet and other modes.
+
+std::string readFile(const std::string& path);
+void writeFile(const std::string& path, const std::string& data);
+// Write to a temp file, fsync, then rename over `path`: readers and crashes
+// see either the old contents or the new, never half a file.
+void writeFileAtomic(const std::string& path, const std::string& data);
+
+TravelerState loadState(const std::string& path, long& hopCount);
+std::string toJson(const TravelerState& st, long hopCount);
+
+// Fencing for runs that overlap (see tick_lease.h). stateIsCurrent is false
+// when the file at `path` has moved past the generation `st` was loaded at,
+// or was written under a lease token newer than `token`: another run has
+// ticked since, and this one must not log or write its hop. commitState
+// bumps st.generation, stamps `token` and writes the file atomically, unless
+// the state is unchanged.
+bool stateIsCurrent(const std::string& path, const TravelerState& st, long token);
+// The fence stamped in the state file at `path`; 0 if none (TickLease's lastFence).
+long stateFence(const std::string& path);
+void commitState(const std::string& path, TravelerState& st, long hopCount, long token);
+
+TripRecord makeTripRecord(long loggedAtUtc,
+                          const TravelerState& before,
+                          const HopResult& hop,
+                          const TravelerState& after,
+                          long hopNumber);
+
+void appendLogNdjson(const std::string& path,
+                     long loggedAtUtc,
+                     const TravelerState& before,
+                     const HopResult& hop,
+                     const TravelerState& after,
+                     long hopNumber);
+
+void writeLatestCaption(const std::string& path,
+                        const std::string& from,
+                        const std::string& to,
+                        long hopNumber,
+                        long departUtc,
+                        long arriveUtc,
+                        const std::string& callsign,
+                        const std::string& personality,
+                        const std::string& vibeLine);
+
+void writeLatestPostJson(const std::string& path,
+                         const TravelerState& before,
+                         const TravelerState& after,
+                         const HopResult& hop,
+                         long hopNumber);
+
+std::string vibeLine(const std::string& personality);
+
+// The "HOP: ..." / "NO HOP: ..." line printed after a tick.
+std::string describeTick(const TravelerState& before, const HopResult& hop, const TravelerState& after);
+
+// One NDJSON line of tick metrics: phase times in ms, then the counters.
+std::string tickMetricsJson(long atUtc, const std::string& airport, const HopResult& hop);
+void appendTickMetrics(const std::string& path, long atUtc, const std::string& airport, const HopResult& hop);
+
+// Log entries (trip_log/ binary log + trip_log.ndjson), caption and post JSON
+// for one hop, written inside `dir` ("" = cwd).
+void writeHopOutputs(const std::string& dir,
+                     long loggedAtUtc,
+                     const TravelerState& before,
+                     const HopResult& hop,
+                     const TravelerState& after,
+                     long hopNumber);
@@ -0,0 +1,349 @@
+#include "state_store.h"
+#include "scoring.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+
+namespace {
+
+constexpr char kMagic[8] = {'I', 'T', 'S', 'T', 'A', 'T', 'E', '1'};
+constexpr uint32_t kVersion = 2;
+constexpr size_t kPage = 4096;
+constexpr size_t kCodeBytes = 8;
+constexpr size_t kDictOffset = kPage;
+constexpr size_t kDictBytes = (StateStore::kMaxAirports * kCodeBytes + kPage - 1) / kPage * kPage;
+constexpr size_t kSlotsOffset = kDictOffset + kDictBytes;
+constexpr size_t kSlotBytes = kPage;
+constexpr uint32_t kInitialSlots = 16;
+
+uint32_t crc32(const void* data, size_t len) {
+  static const std::array<uint32_t, 256> table = [] {
+    std::array<uint32_t, 256> t{};
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      t[i] = c;
+    }
+    return t;
+  }();
+  uint32_t c = 0xFFFFFFFFu;
+  const uint8_t* p = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < len; i++) c = table[(c ^ p[i]) & 0xFF] ^ (c >> 8);
+  return c ^ 0xFFFFFFFFu;
+}
+
+std::string sysError(const std::string& what, const std::string& path) {
+  return what + " " + path + ": " + std::strerror(errno);
+}
+
+} // namespace
+
+struct StateStore::Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t recordBytes;   // sizeof(Record), so a layout change is caught
+  uint32_t slotCapacity;  // slots the file is sized for
+  uint32_t slotCount;     // slots in use; bumped after the new slot is written
+  uint32_t airportCount;  // dictionary entries; bumped after the entry is written
+  uint32_t reserved;
+};
+
+struct StateStore::Record {
+  uint64_t seq;           // 0 = never written
+  uint32_t crc;           // of everything after this field
+  uint32_t reserved;
+  char name[kMaxName + 1];
+  int64_t simTimeUtc;
+  int64_t nextEventUtc;
+  int64_t lagSeconds;
+  int64_t hopCount;
+  int32_t lookbackHours;
+  int32_t avoidRecentN;
+  int32_t lookaheadDepth;
+  int32_t lookaheadBeam;
+  uint16_t currentAirport; // store airport IDs are 1-based; 0 = none
+  uint8_t personality;
+  uint8_t recentCount;     // entries in `recent`, oldest first
+  uint16_t recent[kMaxRecent];
+  uint32_t pad;
+  uint64_t visited[kMaxVisited / 64]; // bit (id - 1)
+};
+
+uint32_t StateStore::recordCrc(const Record& r) {
+  static_assert(sizeof(Record) * 2 <= kSlotBytes, "two record copies per slot");
+  static_assert(kMaxVisited % 64 == 0, "visited bitset is whole words");
+  static_assert(kMaxAirports <= UINT16_MAX, "store airport IDs are 16-bit");
+  constexpr size_t from = offsetof(Record, name);
+  return crc32(reinterpret_cast<const uint8_t*>(&r) + from, sizeof(r) - from);
+}
+
+StateStore::StateStore(std::string path) : path_(std::move(path)) {
+  fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd_ < 0) throw std::runtime_error(sysError("Cannot open", path_));
+
+  struct stat st {};
+  if (::fstat(fd_, &st) != 0) throw std::runtime_error(sysError("Cannot stat", path_));
+  if (st.st_size == 0) {
+    Header h{};
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version = kVersion;
+    h.recordBytes = sizeof(Record);
+    h.slotCapacity = kInitialSlots;
+    if (::ftruncate(fd_, (off_t)(kSlotsOffset + kInitialSlots * kSlotBytes)) != 0 ||
+        ::pwrite(fd_, &h, sizeof(h), 0) != (ssize_t)sizeof(h) || ::fsync(fd_) != 0) {
+      throw std::runtime_error(sysError("Cannot initialise", path_));
+    }
+    st.st_size = (off_t)(kSlotsOffset + kInitialSlots * kSlotBytes);
+  }
+  remap((size_t)st.st_size);
+
+  const Header& h = header();
+  if (size_ < kSlotsOffset || std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 || h.version != kVersion ||
+      h.recordBytes != sizeof(Record)) {
+    throw std::runtime_error("Not a traveler state store: " + path_);
+  }
+  if (size_ < kSlotsOffset + (size_t)h.slotCapacity * kSlotBytes || h.slotCount > h.slotCapacity ||
+      h.airportCount > kMaxAirports) {
+    throw std::runtime_error("Corrupt traveler state store: " + path_);
+  }
+
+  const char* dict = reinterpret_cast<const char*>(base_ + kDictOffset);
+  for (uint32_t i = 0; i < h.airportCount; i++) {
+    const char* code = dict + (size_t)i * kCodeBytes;
+    airportIds_.emplace(std::string(code, strnlen(code, kCodeBytes)), (uint16_t)(i + 1));
+  }
+  for (uint32_t i = 0; i < h.slotCount; i++) {
+    // A slot with no valid copy cannot even be named; load() of it is impossible anyway.
+    if (const Record* r = newest(i)) slots_.emplace(r->name, i);
+  }
+}
+
+StateStore::~StateStore() {
+  if (base_) ::munmap(base_, size_);
+  if (fd_ >= 0) ::close(fd_);
+}
+
+StateStore::Header& StateStore::header() const { return *reinterpret_cast<Header*>(base_); }
+
+StateStore::Record* StateStore::slot(uint32_t index) const {
+  return reinterpret_cast<Record*>(base_ + kSlotsOffset + (size_t)index * kSlotBytes);
+}
+
+const StateStore::Record* StateStore::newest(uint32_t index) const {
+  const Record* copies = slot(index);
+  const Record* best = nullptr;
+  for (int c = 0; c < 2; c++) {
+    const Record& r = copies[c];
+    if (r.seq == 0 || r.crc != recordCrc(r)) continue;
+    if (!best || r.seq > best->seq) best = &r;
+  }
+  return best;
+}
+
+void StateStore::remap(size_t bytes) {
+  if (base_) ::munmap(base_, size_);
+  base_ = nullptr;
+  void* p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (p == MAP_FAILED) throw std::runtime_error(sysError("Cannot map", path_));
+  base_ = static_cast<uint8_t*>(p);
+  size_ = bytes;
+}
+
+void StateStore::sync(const void* p, size_t bytes) const {
+  size_t offset = (size_t)(static_cast<const uint8_t*>(p) - base_);
+  size_t start = offset / kPage * kPage;
+  ::msync(base_ + start, offset + bytes - start, MS_SYNC);
+}
+
+uint16_t StateStore::internLocked(std::string_view code) {
+  if (code.empty()) return 0;
+  auto it = airportIds_.find(std::string(code));
+  if (it != airportIds_.end()) return it->second;
+  if (code.size() > kCodeBytes) throw std::runtime_error("Airport code too long for the state store: " + std::string(code));
+
+  Header& h = header();
+  if (h.airportCount >= kMaxAirports) throw std::runtime_error("State store airport dictionary is full");
+  char* entry = reinterpret_cast<char*>(base_ + kDictOffset) + (size_t)h.airportCount * kCodeBytes;
+  std::memset(entry, 0, kCodeBytes);
+  std::memcpy(entry, code.data(), code.size());
+  sync(entry, kCodeBytes);
+  h.airportCount++;
+  sync(&h, sizeof(h));
+
+  uint16_t id = (uint16_t)h.airportCount;
+  airportIds_.emplace(std::string(code), id);
+  return id;
+}
+
+uint16_t StateStore::internVisitedLocked(std::string_view code) {
+  if (code.size() > kCodeBytes) return 0;
+  auto it = airportIds_.find(std::string(code));
+  if (it != airportIds_.end()) return it->second <= kMaxVisited ? it->second : 0;
+  return header().airportCount < kMaxVisited ? internLocked(code) : 0;
+}
+
+uint32_t StateStore::addSlotLocked(const std::string& name) {
+  Header& h = header();
+  if (h.slotCount == h.slotCapacity) {
+    uint32_t capacity = h.slotCapacity * 2;
+    size_t bytes = kSlotsOffset + (size_t)capacity * kSlotBytes;
+    if (::ftruncate(fd_, (off_t)bytes) != 0) throw std::runtime_error(sysError("Cannot grow", path_));
+    remap(bytes);
+    header().slotCapacity = capacity;
+    sync(base_, sizeof(Header));
+  }
+  uint32_t index = header().slotCount;
+  std::memset(slot(index), 0, kSlotBytes);
+  slots_.emplace(name, index);
+  return index;
+}
+
+size_t StateStore::size() const {
+  std::shared_lock<std::shared_mutex> lock(mu_);
+  return slots_.size();
+}
+
+std::vector<std::string> StateStore::names() const {
+  std::shared_lock<std::shared_mutex> lock(mu_);
+  std::vector<std::string> out;
+  out.reserve(slots_.size());
+  for (const auto& [name, index] : slots_) out.push_back(name);
+  std::sort(out.begin(), out.end());
+  return out;
+}
+
+bool StateStore::contains(const std::string& name) const {
+  std::shared_lock<std::shared_mutex> lock(mu_);
+  return slots_.count(name) != 0;
+}
+
+bool StateStore::load(const std::string& name, TravelerState& st, long& hopCount) const {
+  std::shared_lock<std::shared_mutex> lock(mu_);
+  auto it = slots_.find(name);
+  if (it == slots_.end()) return false;
+  const Record* r = newest(it->second);
+  if (!r) throw std::runtime_error("Corrupt state record for " + name + " in " + path_);
+
+  const char* dict = reinterpret_cast<const char*>(base_ + kDictOffset);
+  auto code = [dict, count = header().airportCount](uint16_t id) {
+    if (id == 0 || id > count) return std::string_view();
+    const char* c = dict + (size_t)(id - 1) * kCodeBytes;
+    return std::string_view(c, strnlen(c, kCodeBytes));
+  };
+
+  st = TravelerState{};
+  st.current_airport = std::string(code(r->currentAirport));
+  st.sim_time_utc = (long)r->simTimeUtc;
+  st.next_event_utc = (long)r->nextEventUtc;
+  st.lag_seconds = (long)r->lagSeconds;
+  st.lookback_hours = r->lookbackHours;
+  st.avoid_recent_n = r->avoidRecentN;
+  st.lookahead_depth = r->lookaheadDepth;
+  st.lookahead_beam = r->lookaheadBeam;
+  st.personality = personalityName((Personality)r->personality);
+  st.recent_airports.setCapacity(st.avoid_recent_n);
+  for (uint8_t i = 0; i < r->recentCount && i < kMaxRecent; i++) {
+    st.recent_airports.push(AirportDict::intern(code(r->recent[i])));
+  }
+  for (size_t w = 0; w < kMaxVisited / 64; w++) {
+    for (uint64_t b = r->visited[w]; b; b &= b - 1) {
+      st.visited_airports.insert(AirportDict::intern(code((uint16_t)(w * 64 + (size_t)__builtin_ctzll(b) + 1))));
+    }
+  }
+  hopCount = (long)r->hopCount;
+  return true;
+}
+
+void StateStore::save(const std::string& name, const TravelerState& st, long hopCount) {
+  if (name.empty() || name.size() > kMaxName) throw std::runtime_error("Bad traveler name for the state store: " + name);
+
+  std::vector<AirportId> recent = st.recent_airports.inOrder();
+  if (recent.size() > kMaxRecent) recent.erase(recent.begin(), recent.end() - (long)kMaxRecent);
+  std::vector<AirportId> visited = st.visited_airports.ids();
+
+  Record r{};
+  std::strncpy(r.name, name.c_str(), kMaxName);
+  r.simTimeUtc = st.sim_time_utc;
+  r.nextEventUtc = st.next_event_utc;
+  r.lagSeconds = st.lag_seconds;
+  r.hopCount = hopCount;
+  r.lookbackHours = st.lookback_hours;
+  r.avoidRecentN = st.avoid_recent_n;
+  r.lookaheadDepth = st.lookahead_depth;
+  r.lookaheadBeam = st.lookahead_beam;
+  r.personality = (uint8_t)parsePersonality(st.personality);
+  r.recentCount = (uint8_t)recent.size();
+
+  // Store IDs for every airport the record mentions. The common case (all
+  // known, traveler exists) needs only the shared lock; anything new is
+  // added under the exclusive one, together with the record itself.
+  // Visited airports only take an ID while there is a bit for it.
+  auto fill = [&](auto&& idOf, auto&& visitedIdOf) {
+    r.currentAirport = idOf(st.current_airport);
+    for (size_t i = 0; i < recent.size(); i++) r.recent[i] = idOf(AirportDict::name(recent[i]));
+    for (AirportId a : visited) {
+      uint16_t id = visitedIdOf(AirportDict::name(a));
+      if (id) r.visited[(id - 1) / 64] |= uint64_t(1) << ((id - 1) % 64);
+    }
+  };
+  auto write = [&](uint32_t index) {
+    Record* copies = slot(index);
+    const Record* cur = newest(index);
+    Record* dst = cur == &copies[0] ? &copies[1] : &copies[0];
+    r.seq = cur ? cur->seq + 1 : 1;
+    r.crc = recordCrc(r);
+    std::memcpy(dst, &r, sizeof(r));
+    sync(dst, sizeof(r));
+  };
+
+  {
+    std::shared_lock<std::shared_mutex> lock(mu_);
+    auto it = slots_.find(name);
+    bool allKnown = it != slots_.end();
+    if (allKnown) {
+      auto known = [&](std::string_view code) -> uint16_t {
+        if (code.empty()) return 0;
+        auto a = airportIds_.find(std::string(code));
+        if (a == airportIds_.end()) {
+          allKnown = false;
+          return 0;
+        }
+        return a->second;
+      };
+      fill(known, [&](std::string_view code) -> uint16_t {
+        bool roomLeft = header().airportCount < kMaxVisited && code.size() <= kCodeBytes;
+        if (!roomLeft && !airportIds_.count(std::string(code))) return 0;
+        uint16_t id = known(code);
+        return id <= kMaxVisited ? id : 0;
+      });
+    }
+    if (allKnown) {
+      write(it->second);
+      return;
+    }
+  }
+
+  std::unique_lock<std::shared_mutex> lock(mu_);
+  std::memset(r.visited, 0, sizeof(r.visited));
+  fill([&](std::string_view code) { return internLocked(code); },
+       [&](std::string_view code) { return internVisitedLocked(code); });
+  auto it = slots_.find(name);
+  if (it != slots_.end()) {
+    write(it->second);
+    return;
+  }
+  uint32_t index = addSlotLocked(name);
+  write(index);
+  header().slotCount = index + 1; // publishes the slot
+  sync(base_, sizeof(Header));
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "traveler.h"
+
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Many travelers' states in one memory-mapped file of fixed-size records.
+//
+// Layout: a header page, the store's own airport dictionary (8-byte codes, so
+// records hold 16-bit IDs that stay valid across processes), then one 4 KiB
+// slot per traveler. A slot holds two copies of the record; save() writes the
+// older copy with the next sequence number and a CRC, so a crash mid-write
+// leaves the other copy intact and load() picks the newest copy whose CRC
+// checks out. An update touches only that traveler's page.
+//
+// Fixed-size limits: the recent ring keeps at most kMaxRecent airports, the
+// dictionary holds kMaxAirports (every 16-bit ID), and a personality outside
+// the known set is stored as "default". The lifetime visited set is a bitset
+// over the first kMaxVisited IDs only: once the fleet has filled those, newly
+// seen airports still get IDs for the current airport and the recent ring, but
+// visits to them are not recorded, so no save ever fails for want of a bit.
+//
+// Thread-safe: saves of different travelers run in parallel.
+class StateStore {
+ public:
+  static constexpr size_t kMaxRecent = 64;
+  static constexpr size_t kMaxAirports = 65535;
+  static constexpr size_t kMaxVisited = 14400;
+  static constexpr size_t kMaxName = 47;
+
+  explicit StateStore(std::string path);
+  ~StateStore();
+
+  StateStore(const StateStore&) = delete;
+  StateStore& operator=(const StateStore&) = delete;
+
+  size_t size() const;
+  std::vector<std::string> names() const;
+  bool contains(const std::string& name) const;
+
+  // False if there is no such traveler; throws if both copies are corrupt.
+  bool load(const std::string& name, TravelerState& st, long& hopCount) const;
+  // Adds the traveler if new.
+  void save(const std::string& name, const TravelerState& st, long hopCount);
+
+ private:
+  struct Header;
+  struct Record;
+
+  std::string path_;
+  int fd_ = -1;
+  uint8_t* base_ = nullptr;
+  size_t size_ = 0;
+
+  mutable std::shared_mutex mu_; // shared: record access; unique: dictionary, new slots, remap
+  std::unordered_map<std::string, uint32_t> slots_;     // name -> slot
+  std::unordered_map<std::string, uint16_t> airportIds_; // code -> store ID (1-based)
+
+  static uint32_t recordCrc(const Record& r);
+  Header& header() const;
+  Record* slot(uint32_t index) const; // the two copies
+  const Record* newest(uint32_t index) const;
+  uint16_t internLocked(std::string_view code);
+  uint16_t internVisitedLocked(std::string_view code); // 0 past kMaxVisited
+  uint32_t addSlotLocked(const std::string& name);
+  void remap(size_t bytes);
+  void sync(const void* p, size_t bytes) const;
+};
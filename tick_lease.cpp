@@ -0,0 +1,148 @@
+#include "tick_lease.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+namespace {
+
+std::string readAll(int fd) {
+  std::string out;
+  char buf[512];
+  off_t at = 0;
+  ssize_t n;
+  while ((n = ::pread(fd, buf, sizeof(buf), at)) > 0) {
+    out.append(buf, (size_t)n);
+    at += n;
+  }
+  return out;
+}
+
+long field(const std::string& json, const char* key) {
+  std::string k = std::string("\"") + key + "\":";
+  auto p = json.find(k);
+  return p == std::string::npos ? 0 : std::strtol(json.c_str() + p + k.size(), nullptr, 10);
+}
+
+std::string stringField(const std::string& json, const char* key) {
+  std::string k = std::string("\"") + key + "\":\"";
+  auto p = json.find(k);
+  if (p == std::string::npos) return "";
+  p += k.size();
+  auto e = json.find('"', p);
+  return e == std::string::npos ? "" : json.substr(p, e - p);
+}
+
+LeaseHolder parse(const std::string& json) {
+  LeaseHolder h;
+  h.token = field(json, "token");
+  h.pid = field(json, "pid");
+  h.acquiredUtc = field(json, "acquired_utc");
+  h.host = stringField(json, "host");
+  return h;
+}
+
+std::string hostName() {
+  char buf[256] = {};
+  if (::gethostname(buf, sizeof(buf) - 1) != 0) return "";
+  for (char* c = buf; *c; c++) {
+    if (*c == '"' || *c == '\\') *c = '_';
+  }
+  return buf;
+}
+
+[[noreturn]] void fail(const std::string& what, const std::string& path) {
+  throw std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+}
+
+} // namespace
+
+TickLease::TickLease(std::string path, long waitMs, const std::function<long()>& lastFence)
+  : path_(std::move(path)) {
+  int fd = ::open(path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) fail("Cannot open lock file", path_);
+
+  auto giveUp = std::chrono::steady_clock::now() + std::chrono::milliseconds(waitMs);
+  while (::flock(fd, LOCK_EX | LOCK_NB) != 0) {
+    if (errno != EWOULDBLOCK && errno != EINTR) {
+      int saved = errno;
+      ::close(fd);
+      errno = saved;
+      fail("Cannot lock", path_);
+    }
+    if (std::chrono::steady_clock::now() >= giveUp) {
+      // The holder rewrites the file only while it holds the lock, and does so
+      // before doing anything else, so this reads its line (or its
+      // predecessor's, if we caught it in the middle).
+      holder_ = parse(readAll(fd));
+      ::close(fd);
+      return;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+
+  LeaseHolder last = parse(readAll(fd));
+  long floor = last.token;
+  if (lastFence) {
+    try {
+      floor = std::max(floor, lastFence());
+    } catch (...) {
+      ::close(fd);
+      throw;
+    }
+  }
+  holder_.token = floor + 1;
+  holder_.pid = (long)::getpid();
+  holder_.acquiredUtc = (long)std::time(nullptr);
+  holder_.host = hostName();
+
+  std::ostringstream o;
+  o << "{\"token\":" << holder_.token << ",\"pid\":" << holder_.pid << ",\"host\":\"" << holder_.host
+    << "\",\"acquired_utc\":" << holder_.acquiredUtc << "}\n";
+  std::string line = o.str();
+  // The token must be on disk before anything is written under it. Overwrite,
+  // then trim, so the file never reads as empty in between.
+  if (::pwrite(fd, line.data(), line.size(), 0) != (ssize_t)line.size() || ::ftruncate(fd, (off_t)line.size()) != 0 ||
+      ::fsync(fd) != 0) {
+    int saved = errno;
+    ::close(fd);
+    errno = saved;
+    fail("Cannot write lock file", path_);
+  }
+  fd_ = fd;
+}
+
+TickLease::~TickLease() { release(); }
+
+void TickLease::release() {
+  if (fd_ < 0) return;
+  // Closing drops the flock; the line stays, so the next holder counts on from our token.
+  ::close(fd_);
+  fd_ = -1;
+}
+
+std::string TickLease::describeHolder() const {
+  std::ostringstream o;
+  o << "pid " << holder_.pid;
+  if (!holder_.host.empty()) o << " on " << holder_.host;
+  o << ", token " << holder_.token;
+  if (holder_.acquiredUtc > 0) {
+    std::time_t t = (std::time_t)holder_.acquiredUtc;
+    std::tm tm{};
+    gmtime_r(&t, &tm);
+    char buf[32];
+    std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%SZ", &tm);
+    o << ", since " << buf;
+  }
+  return o.str();
+}
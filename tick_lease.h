@@ -0,0 +1,58 @@
+#pragma once
+#include <functional>
+#include <string>
+
+// Single-flight coordination between processes ticking the same state.
+//
+// The lease is an exclusive flock() on a lock file next to the state
+// ("state.json.lock"): the kernel drops it when the holder exits or crashes,
+// so there is nothing to expire or clean up. The file itself is never
+// replaced (that would split the lock across inodes); it holds one JSON line
+// naming the current holder and the last fencing token handed out.
+//
+// Each acquisition gets a token one higher than the last. Writers stamp it into
+// the state they write (commitState in state_io.h) and refuse to write over a
+// state stamped with a newer one, so a holder that lost the lease without
+// noticing (a lock file on a network mount, a paused process) cannot overwrite
+// its successor's hop. The lock file is not the only record of the last token:
+// a fresh checkout (CI) or a lost lock file starts from nothing, so the caller
+// passes the fence found in the state, and the token is issued above both.
+
+struct LeaseHolder {
+  long token = 0;
+  long pid = 0;
+  long acquiredUtc = 0;
+  std::string host;
+};
+
+class TickLease {
+ public:
+  // Takes the lease on `path`, creating the file if needed, waiting up to
+  // `waitMs` for the current holder to finish (0 = not at all). held() says
+  // whether it was granted. `lastFence`, if given, is called once the lock is
+  // held and returns the newest token already written into the state; the new
+  // token is above it. Throws std::runtime_error if the file cannot be opened
+  // or written.
+  explicit TickLease(std::string path, long waitMs = 0, const std::function<long()>& lastFence = {});
+  ~TickLease();
+
+  TickLease(const TickLease&) = delete;
+  TickLease& operator=(const TickLease&) = delete;
+
+  bool held() const { return fd_ >= 0; }
+  long token() const { return held() ? holder_.token : 0; }
+  const std::string& path() const { return path_; }
+
+  // Us while held, else whoever held it as of the attempt.
+  const LeaseHolder& holder() const { return holder_; }
+
+  // "pid 123 on host, token 7, since 2026-01-14T10:00:00Z"
+  std::string describeHolder() const;
+
+  void release();
+
+ private:
+  std::string path_;
+  int fd_ = -1;
+  LeaseHolder holder_;
+};
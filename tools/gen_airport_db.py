@@ -0,0 +1,142 @@
+#!/usr/bin/env python3
+"""Generates airport_db_data.h: a constexpr perfect-hash table of airports.
+
+    tools/gen_airport_db.py airports.csv > airport_db_data.h
+
+The input is OurAirports' airports.csv (https://ourairports.com/data/) or any
+CSV with the same column names: ident (or icao_code / gps_code), type,
+latitude_deg and longitude_deg. Only 4-character ICAO codes are kept. The
+checked-in header is built from tools/airports_seed.csv, a hand-picked subset
+of hubs; regenerate it from the full file for worldwide coverage.
+
+The table is hash-and-displace: a key's bucket is airportHash(key, 0) % buckets,
+and the bucket's displacement d puts it in slot airportHash(key, d) % slots.
+Displacements are searched largest bucket first, so every key lands in its own
+slot and a lookup is two hashes and one compare. The hash must match
+airportHash() in airport_db.h.
+"""
+
+import csv
+import os
+import sys
+
+KINDS = {
+    "closed": "Closed",
+    "heliport": "Heliport",
+    "seaplane_base": "SeaplaneBase",
+    "balloonport": "Heliport",
+    "small_airport": "Small",
+    "medium_airport": "Medium",
+    "large_airport": "Large",
+}
+
+KEYS_PER_BUCKET = 4
+LOAD = 0.85
+
+
+def airport_key(code):
+    return sum(ord(c) << (8 * i) for i, c in enumerate(code))
+
+
+def airport_hash(key, seed):
+    h = key ^ ((seed * 0x9E3779B9) & 0xFFFFFFFF)
+    h ^= h >> 16
+    h = (h * 0x85EBCA6B) & 0xFFFFFFFF
+    h ^= h >> 13
+    h = (h * 0xC2B2AE35) & 0xFFFFFFFF
+    h ^= h >> 16
+    return h
+
+
+def icao_code(row):
+    for column in ("icao_code", "gps_code", "ident"):
+        code = (row.get(column) or "").strip().upper()
+        if len(code) == 4 and code.isascii() and code.isalnum():
+            return code
+    return None
+
+
+def read_airports(path):
+    airports = {}
+    with open(path, newline="", encoding="utf-8") as f:
+        for row in csv.DictReader(f):
+            code = icao_code(row)
+            if not code:
+                continue
+            try:
+                lat = float(row["latitude_deg"])
+                lon = float(row["longitude_deg"])
+            except (KeyError, ValueError):
+                continue
+            kind = KINDS.get((row.get("type") or "").strip(), "Unknown")
+            # A code used twice (a closed field and its replacement) keeps the open one.
+            if code in airports and kind == "Closed":
+                continue
+            airports[code] = (lat, lon, kind)
+    return airports
+
+
+def build(keys):
+    buckets = max(1, (len(keys) + KEYS_PER_BUCKET - 1) // KEYS_PER_BUCKET)
+    slots = max(1, int(len(keys) / LOAD) + 1)
+    members = [[] for _ in range(buckets)]
+    for key in keys:
+        members[airport_hash(key, 0) % buckets].append(key)
+
+    displacement = [0] * buckets
+    taken = [False] * slots
+    for b in sorted(range(buckets), key=lambda b: -len(members[b])):
+        if not members[b]:
+            continue
+        seed = 1
+        while True:
+            placed = [airport_hash(key, seed) % slots for key in members[b]]
+            if len(set(placed)) == len(placed) and not any(taken[s] for s in placed):
+                break
+            seed += 1
+            if seed >= 1 << 32:
+                sys.exit("gen_airport_db: no displacement found; lower LOAD")
+        displacement[b] = seed
+        for s in placed:
+            taken[s] = True
+    return buckets, slots, displacement
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit("usage: gen_airport_db.py airports.csv > airport_db_data.h")
+    airports = read_airports(sys.argv[1])
+    if not airports:
+        sys.exit("gen_airport_db: no airports with a 4-character code in " + sys.argv[1])
+
+    codes = sorted(airports)
+    keys = {airport_key(code): code for code in codes}
+    buckets, slots, displacement = build(list(keys))
+    table = [None] * slots
+    for key, code in keys.items():
+        b = airport_hash(key, 0) % buckets
+        table[airport_hash(key, displacement[b]) % slots] = code
+
+    out = sys.stdout
+    out.write("// Generated by tools/gen_airport_db.py from %s -- do not edit.\n" % os.path.basename(sys.argv[1]))
+    out.write("// %d airports in %d slots, %d buckets. Included by airport_db.h only.\n" % (len(codes), slots, buckets))
+    out.write("#pragma once\n\n")
+    out.write("inline constexpr uint32_t kAirportCount = %d;\n" % len(codes))
+    out.write("inline constexpr uint32_t kAirportBuckets = %d;\n" % buckets)
+    out.write("inline constexpr uint32_t kAirportSlots = %d;\n\n" % slots)
+    out.write("inline constexpr uint32_t kAirportDisplacement[kAirportBuckets] = {")
+    for i, d in enumerate(displacement):
+        out.write(("\n  " if i % 12 == 0 else " ") + "%d," % d)
+    out.write("\n};\n\n")
+    out.write("inline constexpr AirportRecord kAirportTable[kAirportSlots] = {\n")
+    for code in table:
+        if code is None:
+            out.write("  {},\n")
+        else:
+            lat, lon, kind = airports[code]
+            out.write('  {airportKey("%s"), %.4ff, %.4ff, AirportKind::%s},\n' % (code, lat, lon, kind))
+    out.write("};\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -1,62 +1,74 @@
 #include "traveler.h"
+#include "airport_db.h"
+#include "planner.h"
+#include "route_graph.h"
+#include "scoring.h"
 
 #include <algorithm>
+#include <chrono>
 #include <random>
-#include <cmath>
 
-TravelerEngine::TravelerEngine(OpenSkyClient client) : client_(std::move(client)) {}
+using Clock = std::chrono::steady_clock;
 
-bool TravelerEngine::isRecentlyVisited(const TravelerState& st, const std::string& airport) const {
-  for (const auto& a : st.recent_airports) {
-    if (a == airport) return true;
-  }
-  return false;
+static double msSince(Clock::time_point t0) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
 }
 
-void TravelerEngine::pushRecent(TravelerState& st, const std::string& airport) const {
-  st.recent_airports.push_back(airport);
-  if ((int)st.recent_airports.size() > st.avoid_recent_n) {
-    st.recent_airports.erase(st.recent_airports.begin());
-  }
+TravelerEngine::TravelerEngine(DepartureSource& source, const RouteGraph* routes)
+  : source_(source), routes_(routes), rng_(std::random_device{}()) {}
+
+void TravelerEngine::pushRecent(TravelerState& st, AirportId airport) const {
+  if (st.recent_airports.capacity() != st.avoid_recent_n) st.recent_airports.setCapacity(st.avoid_recent_n);
+  st.recent_airports.push(airport);
+  st.visited_airports.insert(airport);
 }
 
-double TravelerEngine::scoreFlight(const TravelerState& st, const Flight& f) const {
+void TravelerEngine::gatherInputs(const TravelerState& st, const Flight& f, bool lifetimeNovelty,
+                                  ScoreColumns& cols, size_t i) const {
   long dur = 0;
-  if (f.lastSeen > 0 && f.firstSeen > 0) dur = std::max(0L, f.lastSeen - f.firstSeen);
-  double durationHours = dur / 3600.0;
-
-  bool novel = !isRecentlyVisited(st, f.estArrivalAirport);
-  double noveltyScore = novel ? 1.0 : -0.5;
-
-  double shortnessScore = std::exp(-durationHours / 2.0);
-  double longnessScore  = std::min(1.0, durationHours / 6.0);
-
-  static thread_local std::mt19937 gen(std::random_device{}());
-  std::uniform_real_distribution<double> jitterDist(-0.05, 0.05);
-  double jitter = jitterDist(gen);
-
-  double wNovel = 0.6, wShort = 0.2, wLong = 0.2, wJit = 0.1;
-
-  if (st.personality == "chaotic") {
-    wNovel = 0.8; wShort = 0.1; wLong = 0.1; wJit = 0.25;
-  } else if (st.personality == "budget") {
-    wNovel = 0.5; wShort = 0.6; wLong = 0.0; wJit = 0.08;
-  } else if (st.personality == "scenic") {
-    wNovel = 0.5; wShort = 0.0; wLong = 0.7; wJit = 0.08;
+  if (f.firstSeen > 0) dur = std::max(0L, estimatedArrival(f) - f.firstSeen);
+  cols.durationHours[i] = dur / 3600.0;
+  // Only a measured duration says anything about an unknown airport's distance.
+  long observed = f.firstSeen > 0 && f.lastSeen > f.firstSeen ? f.lastSeen - f.firstSeen : 0;
+  cols.distanceKm[i] = routeKm(f.estDepartureAirport, f.estArrivalAirport, observed);
+  cols.hub[i] = hubScore(f.estArrivalAirport);
+
+  if (st.recent_airports.contains(f.estArrivalAirport)) {
+    cols.novelty[i] = kNoveltyRecent;
+  } else if (lifetimeNovelty && st.visited_airports.contains(f.estArrivalAirport)) {
+    cols.novelty[i] = kNoveltySeen; // been there at some point; only brand-new airports count as novel
+  } else {
+    cols.novelty[i] = kNoveltyNew;
   }
-
-  return (wNovel * noveltyScore) + (wShort * shortnessScore) + (wLong * longnessScore) + (wJit * jitter);
+  cols.sink[i] = routes_ ? routes_->sink(f.estArrivalAirport) : 0.0;
 }
 
-HopResult TravelerEngine::tick(TravelerState& st, long nowUtc) {
-  HopResult out;
-
-  // Real-time waiting gate
-  if (st.next_event_utc > 0 && nowUtc < st.next_event_utc) {
-    out.reason = "Not time yet.";
-    return out;
+void TravelerEngine::scoreCandidates(const TravelerState& st,
+                                     const std::vector<Flight>& flights,
+                                     const std::vector<uint32_t>& candidates,
+                                     ScoreColumns& cols) const {
+  Personality p = parsePersonality(st.personality);
+  cols.resize(candidates.size());
+  for (size_t i = 0; i < candidates.size(); i++) {
+    gatherInputs(st, flights[candidates[i]], p == Personality::Explorer, cols, i);
   }
+  fillJitter(rng_, cols.jitter.data(), cols.size());
+  if (params_) scoreBatch(*params_, cols);
+  else scoreBatch(p, cols);
+}
+
+double TravelerEngine::scoreFlight(const TravelerState& st, const Flight& f) const {
+  Personality p = parsePersonality(st.personality);
+  ScoreColumns cols;
+  cols.resize(1);
+  gatherInputs(st, f, p == Personality::Explorer, cols, 0);
+  fillJitter(rng_, cols.jitter.data(), 1);
+  if (params_) scoreBatch(*params_, cols);
+  else scoreBatch(p, cols);
+  return cols.score[0];
+}
 
+void TravelerEngine::anchorStoryTime(TravelerState& st, long nowUtc) {
   // Initialize story time if first run
   if (st.sim_time_utc == 0) {
     st.sim_time_utc = nowUtc - st.lag_seconds;
@@ -67,10 +79,12 @@ HopResult TravelerEngine::tick(TravelerState& st, long nowUtc) {
   if (st.sim_time_utc > targetStoryNow + 6 * 3600) {
     st.sim_time_utc = targetStoryNow;
   }
+}
 
+void TravelerEngine::queryWindow(long simTimeUtc, int lookbackHours, long& windowBegin, long& windowEnd) {
   // ✅ NEW: Look AHEAD window (search forward from sim_time_utc)
-  long windowBegin = st.sim_time_utc;
-  long windowEnd   = st.sim_time_utc + (long)st.lookback_hours * 3600; // 36h lookahead
+  windowBegin = simTimeUtc;
+  windowEnd   = simTimeUtc + (long)lookbackHours * 3600; // 36h lookahead
 
   // Hard safety: never query more than 48h
   if (windowEnd - windowBegin > 172800) {
@@ -85,62 +99,251 @@ HopResult TravelerEngine::tick(TravelerState& st, long nowUtc) {
     // snap end to within 2 days
     windowEnd = (beginDay + 2) * 86400 - 1;
   }
+}
+
+bool TravelerEngine::isDue(const TravelerState& st, long nowUtc) {
+  return !(st.next_event_utc > 0 && nowUtc < st.next_event_utc);
+}
+
+bool TravelerEngine::nextWindow(const TravelerState& st, long nowUtc, long& beginUtc, long& endUtc) {
+  if (!isDue(st, nowUtc)) return false;
+  TravelerState copy = st;
+  anchorStoryTime(copy, nowUtc);
+  queryWindow(copy.sim_time_utc, copy.lookback_hours, beginUtc, endUtc);
+  return true;
+}
+
+void TravelerEngine::collectCandidates(const std::vector<Flight>& flights, AirportId here, long fromUtc,
+                                       std::vector<uint32_t>& candidates) {
+  // Depart from here at/after fromUtc, have an arrival, not a self-hop. Kept as
+  // indices into `flights`; only the chosen flight is ever copied.
+  candidates.clear();
+  candidates.reserve(flights.size());
+  for (uint32_t i = 0; i < (uint32_t)flights.size(); i++) {
+    const Flight& f = flights[i];
+    if (f.estDepartureAirport != here) continue;
+    if (f.firstSeen < fromUtc) continue;
+    if (f.estArrivalAirport == kNoAirport) continue;
+    if (f.estArrivalAirport == here) continue; // prevent self-hop
+    candidates.push_back(i);
+  }
+}
+
+bool TravelerEngine::scanAhead(TravelerState& st, long nowUtc, long windowEnd,
+                               std::vector<Flight>& flights, std::vector<uint32_t>& candidates,
+                               long& scannedTo) {
+  constexpr long kMaxDays = 7;       // partitions fetched per tick, at most
+  constexpr size_t kParallel = 3;    // partitions in flight at once
+
+  // anchorStoryTime() pulls story time back from beyond now - lag + 6h, and
+  // nothing later has been flown yet anyway, so that is the horizon.
+  long horizon = nowUtc - st.lag_seconds + 6 * 3600;
+  AirportId here = AirportDict::intern(st.current_airport);
+  auto key = [here](long day) { return ((uint64_t)here << 32) | (uint32_t)day; };
+
+  // The window can end mid-day; the scan picks up right after it, so the rest
+  // of that day is searched before later ones.
+  long scanFrom = windowEnd + 1;
+  long firstDay = scanFrom / 86400;
+  auto dayStart = [scanFrom](long d) { return std::max(d * 86400, scanFrom); };
+  std::vector<long> days;
+  for (long d = firstDay; d < firstDay + kMaxDays && dayStart(d) <= horizon; d++) {
+    days.push_back(d);
+  }
+
+  scannedTo = 0;
+  for (size_t i = 0; i < days.size(); i += kParallel) {
+    size_t n = std::min(kParallel, days.size() - i);
+    std::vector<DepartureRequest> wave;
+    std::vector<size_t> slot; // wave request -> position in this group of days
+    for (size_t k = 0; k < n; k++) {
+      long d = days[i + k];
+      if (dryDays_.count(key(d))) continue;
+      wave.push_back(DepartureRequest{st.current_airport, dayStart(d), (d + 1) * 86400 - 1});
+      slot.push_back(k);
+    }
+    std::vector<std::vector<Flight>> results(n);
+    std::vector<bool> fetched(n, false), failed(n, false);
+    source_.getDeparturesBatch(wave, [&](size_t w, std::vector<Flight> got, std::exception_ptr error) {
+      fetched[slot[w]] = true;
+      if (error) failed[slot[w]] = true;
+      else results[slot[w]] = std::move(got);
+    });
+
+    // Earliest day first; an unanswered day ends the scan (unknown is not empty).
+    for (size_t k = 0; k < n; k++) {
+      long d = days[i + k];
+      if (fetched[k]) {
+        if (failed[k]) return false;
+        flights = std::move(results[k]);
+        collectCandidates(flights, here, dayStart(d), candidates);
+        if (!candidates.empty()) {
+          st.sim_time_utc = dayStart(d);
+          return true;
+        }
+        // Only whole, published days are remembered; an empty answer for a
+        // day OpenSky has not published yet says nothing.
+        if (dayStart(d) == d * 86400 && (d + 1) * 86400 + kPublishLagSeconds <= nowUtc) dryDays_.insert(key(d));
+      }
+      scannedTo = (d + 1) * 86400;
+    }
+  }
+  return false;
+}
+
+HopResult TravelerEngine::tick(TravelerState& st, long nowUtc) {
+  return tick(st, nowUtc, Clock::time_point::max());
+}
+
+HopResult TravelerEngine::tick(TravelerState& st, long nowUtc, Clock::time_point deadline) {
+  HopResult out;
+
+  // Real-time waiting gate
+  if (!isDue(st, nowUtc)) {
+    out.reason = "Not time yet.";
+    return out;
+  }
+
+  auto t0 = Clock::now();
+  FetchMetricsScope scope(out.metrics.fetch);
+  FetchDeadlineScope budget(deadline);
+  if (FetchDeadlineScope::active()) {
+    out.metrics.budgetMs = std::chrono::duration<double, std::milli>(FetchDeadlineScope::deadline() - t0).count();
+  }
+  runTick(st, nowUtc, out);
+  out.metrics.tickMs = msSince(t0);
+  out.metrics.deadlineHit = FetchDeadlineScope::active() && Clock::now() >= FetchDeadlineScope::deadline();
+  return out;
+}
+
+void TravelerEngine::runTick(TravelerState& st, long nowUtc, HopResult& out) {
+  TickMetrics& m = out.metrics;
+  auto lap = Clock::now();
+  auto phase = [&lap](double& ms) {
+    auto t = Clock::now();
+    ms += std::chrono::duration<double, std::milli>(t - lap).count();
+    lap = t;
+  };
+
+  anchorStoryTime(st, nowUtc);
+
+  long windowBegin = 0, windowEnd = 0;
+  queryWindow(st.sim_time_utc, st.lookback_hours, windowBegin, windowEnd);
+
+  // Out of time: choose from the known part of the window, or look again
+  // soon. The next tick usually finds the data cached or prefetched.
+  constexpr long kDeadlineRetrySeconds = 60;
 
   std::vector<Flight> flights;
   try {
-    flights = client_.getDepartures(st.current_airport, windowBegin, windowEnd);
+    flights = source_.getDepartures(st.current_airport, windowBegin, windowEnd);
+    phase(m.fetchMs);
+  } catch (const PartialDepartures& e) {
+    flights = e.flights();
+    m.partial = true;
+    phase(m.fetchMs);
+  } catch (const DeadlineExceeded& e) {
+    st.next_event_utc = nowUtc + kDeadlineRetrySeconds;
+    out.reason = std::string("OpenSky timeout: ") + e.what();
+    phase(m.fetchMs);
+    return;
+  } catch (const FetchError& e) {
+    // Rate limited or out of credits: come back when the source says it is worth it.
+    st.next_event_utc = nowUtc + std::max(5 * 60L, e.retryAfterSeconds());
+    out.reason = std::string("OpenSky error: ") + e.what();
+    phase(m.fetchMs);
+    return;
   } catch (const std::exception& e) {
     // ✅ Self-heal: schedule a retry even on API errors
     st.next_event_utc = nowUtc + 5 * 60;
     out.reason = std::string("OpenSky error: ") + e.what();
-    return out;
+    phase(m.fetchMs);
+    return;
   }
 
-  // Candidates: depart from current airport, depart at/after sim_time, have arrival, not self-hop
-  std::vector<Flight> candidates;
-  candidates.reserve(flights.size());
-  for (const auto& f : flights) {
-    if (f.estDepartureAirport != st.current_airport) continue;
-    if (f.firstSeen < st.sim_time_utc) continue;
-    if (f.estArrivalAirport.empty()) continue;
-    if (f.estArrivalAirport == st.current_airport) continue; // prevent self-hop
-    candidates.push_back(f);
+  AirportId here = AirportDict::intern(st.current_airport);
+  std::vector<uint32_t> candidates;
+  collectCandidates(flights, here, st.sim_time_utc, candidates);
+  m.flights = (long)flights.size();
+  phase(m.filterMs);
+
+  std::string planNote;
+  if (m.partial) {
+    if (candidates.empty()) {
+      // What is missing may hold the next departure; not a dry window.
+      st.next_event_utc = nowUtc + kDeadlineRetrySeconds;
+      out.reason = "Only part of the window arrived before the deadline; scheduled recheck.";
+      return;
+    }
+    planNote = ", partial window";
   }
 
   if (candidates.empty()) {
-    // ✅ Advance story time forward, retry soon
-    st.sim_time_utc += 6 * 3600;        // bump 6 hours to escape dry windows faster
-    st.next_event_utc = nowUtc + 5 * 60;
-    out.reason = "No candidates in window; advanced story time + scheduled recheck.";
-    return out;
+    long dryFrom = st.sim_time_utc;
+    long scannedTo = 0;
+    bool found = scanAhead(st, nowUtc, windowEnd, flights, candidates, scannedTo);
+    m.flights += (long)flights.size();
+    phase(m.fetchMs);
+    if (!found) {
+      // ✅ Advance story time forward (past every day found empty), retry soon
+      st.sim_time_utc = std::max(st.sim_time_utc + 6 * 3600, scannedTo);
+      st.next_event_utc = nowUtc + 5 * 60;
+      out.reason = "No candidates in window; advanced story time + scheduled recheck.";
+      return;
+    }
+    planNote = ", waited " + std::to_string((st.sim_time_utc - dryFrom) / 3600) + "h for a departure";
   }
 
-  // Score candidates
-  struct Scored { Flight f; double score; };
-  std::vector<Scored> scored;
-  scored.reserve(candidates.size());
-  for (const auto& f : candidates) scored.push_back({f, scoreFlight(st, f)});
+  m.candidates = (long)candidates.size();
+
+  // Score candidates in one batch; only the best few are ever ranked.
+  ScoreColumns cols;
+  scoreCandidates(st, flights, candidates, cols);
+  phase(m.scoreMs);
+  // Exploration: 10% chance pick randomly among top 5 (unless tuned otherwise)
+  double exploreRate = params_ ? params_->exploreRate : 0.10;
+  size_t exploreTopN = params_ ? (size_t)std::max(1, params_->exploreTopN) : 5;
 
-  std::sort(scored.begin(), scored.end(), [](const Scored& a, const Scored& b) {
-    return a.score > b.score;
-  });
+  size_t keep = exploreTopN;
+  if (st.lookahead_depth > 1) keep = std::max<size_t>(keep, (size_t)std::max(1, st.lookahead_beam));
+  std::vector<uint32_t> best = topK(cols.score, keep); // positions in `candidates`, best first
 
-  // Exploration: 10% chance pick randomly among top 5
-  static thread_local std::mt19937 gen(std::random_device{}());
   std::uniform_real_distribution<double> coin(0.0, 1.0);
 
-  size_t topK = std::min<size_t>(5, scored.size());
+  size_t topN = std::min(exploreTopN, best.size());
   size_t chosenIdx = 0;
 
-  if (coin(gen) < 0.10 && topK > 1) {
-    std::uniform_int_distribution<size_t> pick(0, topK - 1);
-    chosenIdx = pick(gen);
+  if (coin(rng_) < exploreRate && topN > 1) {
+    std::uniform_int_distribution<size_t> pick(0, topN - 1);
+    chosenIdx = pick(rng_);
+  } else if (st.lookahead_depth > 1 && best.size() > 1) {
+    // Look a few hops ahead from the best candidates and avoid dead ends.
+    PlannerOptions popts;
+    popts.depth = st.lookahead_depth;
+    popts.beam = st.lookahead_beam;
+
+    std::vector<Flight> ranked;
+    std::vector<double> rankedScores;
+    for (size_t i = 0; i < best.size() && (int)i < popts.beam; i++) {
+      ranked.push_back(flights[candidates[best[i]]]);
+      rankedScores.push_back(cols.score[best[i]]);
+    }
+
+    LookaheadPlanner planner(
+        source_,
+        [this](const TravelerState& s, const Flight& f) { return scoreFlight(s, f); },
+        [lookback = st.lookback_hours](long t, long& b, long& e) { queryWindow(t, lookback, b, e); },
+        popts);
+    PlannerResult plan = planner.plan(st, ranked, rankedScores);
+    chosenIdx = plan.candidateIndex;
+    planNote += ", lookahead " + std::to_string(plan.pathHops) + " hops";
   }
 
-  Flight chosen = scored[chosenIdx].f;
+  const Flight& chosen = flights[candidates[best[chosenIdx]]];
+  phase(m.selectMs);
 
   long departUtc = chosen.firstSeen;
-  long arriveUtc = (chosen.lastSeen > 0 ? chosen.lastSeen : (departUtc + 2 * 3600));
+  long arriveUtc = estimatedArrival(chosen);
 
   // Real-time wait: next tick after flight duration
   long flightDuration = std::max(60L, arriveUtc - departUtc);
@@ -148,14 +351,18 @@ HopResult TravelerEngine::tick(TravelerState& st, long nowUtc) {
 
   // Advance story time and location
   st.sim_time_utc = arriveUtc;
-  st.current_airport = chosen.estArrivalAirport;
+  st.current_airport = std::string(chosen.arrival());
   pushRecent(st, chosen.estArrivalAirport);
 
+  // The next tick's window is known now; let the source fetch it during the flight.
+  long nextBegin = 0, nextEnd = 0;
+  if (nextWindow(st, st.next_event_utc, nextBegin, nextEnd)) {
+    source_.prefetch(st.current_airport, nextBegin, nextEnd);
+  }
+
   out.didHop = true;
   out.flight = chosen;
   out.depart_utc = departUtc;
   out.arrive_utc = arriveUtc;
-  out.reason = "Hopped (personality scoring: " + st.personality + ").";
-
-  return out;
+  out.reason = "Hopped (personality scoring: " + st.personality + planNote + ").";
 }
\ No newline at end of file
@@ -1,6 +1,14 @@
 #pragma once
-#include "opensky_client.h"
+#include "airport_sets.h"
+#include "departure_source.h"
+#include "scoring.h"
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <random>
 #include <string>
+#include <string_view>
+#include <unordered_set>
 #include <vector>
 
 struct TravelerState {
@@ -10,10 +18,33 @@ struct TravelerState {
   long lag_seconds = 86400;      // 24h lag
   int lookback_hours = 36;       // used as lookAHEAD hours now
   int avoid_recent_n = 10;
+  int lookahead_depth = 0;       // >1 enables the multi-hop planner
+  int lookahead_beam = 3;        // paths kept per planner level
 
-  std::string personality = "chaotic"; // chaotic / budget / scenic
+  std::string personality = "chaotic"; // chaotic / budget / scenic / explorer
 
-  std::vector<std::string> recent_airports;
+  RecentAirports recent_airports{10};   // last avoid_recent_n airports
+  VisitedAirports visited_airports;     // every airport ever visited (explorer avoids these)
+
+  long generation = 0; // bumped by every commitState() (state_io.h)
+  long fence = 0;      // lease token of the run that wrote it
+};
+
+// Where one tick's time went (milliseconds) and what it pulled in.
+struct TickMetrics {
+  double stateLoadMs = 0;   // set by the caller
+  double fetchMs = 0;       // getDepartures, dry-window scan included
+  double filterMs = 0;
+  double scoreMs = 0;
+  double selectMs = 0;      // top-K, exploration, lookahead planner
+  double stateWriteMs = 0;  // set by the caller
+  double tickMs = 0;        // all of tick()
+  long flights = 0;         // departures returned for the window(s)
+  long candidates = 0;
+  double budgetMs = 0;      // time the deadline allowed; 0 = no deadline
+  bool deadlineHit = false; // still running when the deadline passed
+  bool partial = false;     // chose from a window the deadline cut short
+  FetchMetrics fetch;       // network side of this thread's fetches; zero on a cache hit
 };
 
 struct HopResult {
@@ -22,18 +53,70 @@ struct HopResult {
   long depart_utc = 0;
   long arrive_utc = 0;
   std::string reason;
+  TickMetrics metrics;      // empty when not due
 };
 
+class RouteGraph;
+
 class TravelerEngine {
  public:
-  explicit TravelerEngine(OpenSkyClient client);
+  // With a route graph, destinations it predicts are dead ends score lower.
+  explicit TravelerEngine(DepartureSource& source, const RouteGraph* routes = nullptr);
   HopResult tick(TravelerState& st, long nowUtc);
 
+  // The same, with every fetch bounded by `deadline` (see FetchDeadlineScope).
+  // When it passes, the tick chooses from whatever part of the window is
+  // known, or schedules a recheck a minute later; it does not wait longer.
+  HopResult tick(TravelerState& st, long nowUtc, std::chrono::steady_clock::time_point deadline);
+
+  // Reseed scoring jitter and exploration; same seed + same data = same journey.
+  void seed(uint32_t s) { rng_.seed(s); }
+
+  // Score with these weights and exploration settings instead of the
+  // personality's built-in policy (the personality still picks novelty rules).
+  void setScoringParams(const ScoringParams& params) { params_ = params; }
+
+  // False while the real-time gate (next_event_utc) is closed.
+  static bool isDue(const TravelerState& st, long nowUtc);
+
+  // The departures window the next tick() will query, after the same story-time
+  // initialisation/anchoring tick() applies. False if the traveler is not due.
+  static bool nextWindow(const TravelerState& st, long nowUtc, long& beginUtc, long& endUtc);
+
+  // Departure window searched from story time `simTimeUtc` (OpenSky partition rules applied).
+  static void queryWindow(long simTimeUtc, int lookbackHours, long& windowBegin, long& windowEnd);
+
  private:
-  OpenSkyClient client_;
+  DepartureSource& source_;
+  const RouteGraph* routes_;
+  mutable std::mt19937 rng_;
+  std::optional<ScoringParams> params_;
+  std::unordered_set<uint64_t> dryDays_; // (airport, UTC day) partitions known to have no candidates
+
+  // Dry-window escape: fetches the UTC days after `windowEnd` (a few at a time,
+  // bounded by the story-time horizon) and stops at the first with a candidate.
+  // On success st.sim_time_utc moves to that day and its flights/candidates are
+  // returned; otherwise `scannedTo` is where the empty days end (0 = none).
+  bool scanAhead(TravelerState& st, long nowUtc, long windowEnd,
+                 std::vector<Flight>& flights, std::vector<uint32_t>& candidates, long& scannedTo);
+
+  static void collectCandidates(const std::vector<Flight>& flights, AirportId here, long fromUtc,
+                                std::vector<uint32_t>& candidates);
 
-  bool isRecentlyVisited(const TravelerState& st, const std::string& airport) const;
-  void pushRecent(TravelerState& st, const std::string& airport) const;
+  void runTick(TravelerState& st, long nowUtc, HopResult& out);
+  void pushRecent(TravelerState& st, AirportId airport) const;
 
+  // Single-flight scoring (used by the lookahead planner); same kernel as the batch.
   double scoreFlight(const TravelerState& st, const Flight& f) const;
+
+  // Scores flights[candidates[i]] into cols.score[i].
+  void scoreCandidates(const TravelerState& st,
+                       const std::vector<Flight>& flights,
+                       const std::vector<uint32_t>& candidates,
+                       ScoreColumns& cols) const;
+
+  void gatherInputs(const TravelerState& st, const Flight& f, bool lifetimeNovelty,
+                    ScoreColumns& cols, size_t i) const;
+
+  static void anchorStoryTime(TravelerState& st, long nowUtc);
 };
\ No newline at end of file
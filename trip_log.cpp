@@ -0,0 +1,600 @@
+#include "trip_log.h"
+#include "departure_source.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char kMagic[8] = {'I', 'T', 'T', 'R', 'L', 'O', 'G', '1'};
+constexpr uint32_t kVersion = 1;
+
+struct SegmentHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t capacity;     // rows the column arrays are sized for
+  uint64_t count;        // committed rows; written after the row's columns
+  int64_t minDepart;
+  int64_t maxDepart;
+  uint64_t indexOffset;  // postings block, 0 until sealed
+  uint32_t indexBytes;
+  uint32_t reserved[3];
+};
+static_assert(sizeof(SegmentHeader) == 64, "segment header is one cache line");
+
+// Columns in file order, and their widths in bytes.
+enum Column { kHop, kLoggedAt, kDepart, kArrive, kCallsign, kIcao24, kFrom, kTo, kReason, kColumnCount };
+constexpr size_t kWidth[kColumnCount] = {8, 8, 8, 8, 8, 4, 4, 4, 4};
+
+size_t columnOffset(uint32_t capacity, int column) {
+  size_t off = sizeof(SegmentHeader);
+  for (int c = 0; c < column; c++) off += kWidth[c] * capacity;
+  return off;
+}
+
+// Postings block of a sealed segment: uint32 n, n entries, then the row lists.
+struct PostingEntry {
+  uint32_t airport;
+  uint32_t first;  // index into the row lists
+  uint32_t n;
+};
+
+std::string segmentName(long firstHop) {
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "seg-%012ld.tlog", firstHop);
+  return buf;
+}
+
+std::string sysError(const std::string& what, const std::string& path) {
+  return what + " " + path + ": " + std::strerror(errno);
+}
+
+std::vector<std::string> readLines(const std::string& path) {
+  std::vector<std::string> out;
+  std::ifstream in(path);
+  std::string line;
+  while (std::getline(in, line)) out.push_back(line);
+  return out;
+}
+
+// Synced before returning: rows are msync'd as they are written, so a new ID
+// has to be durable before the first row that uses it.
+void appendLine(const std::string& path, const std::string& line) {
+  int fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) throw std::runtime_error(sysError("Cannot open", path));
+  std::string data = line + "\n";
+  bool ok = ::write(fd, data.data(), data.size()) == (ssize_t)data.size() && ::fsync(fd) == 0;
+  int saved = errno;
+  ::close(fd);
+  errno = saved;
+  if (!ok) throw std::runtime_error(sysError("Cannot append to", path));
+}
+
+} // namespace
+
+struct TripLog::Segment {
+  std::string path;
+  long firstHop = 0;
+  int fd = -1;
+  uint8_t* base = nullptr;
+  size_t size = 0;
+
+  ~Segment() {
+    unmap();
+    if (fd >= 0) ::close(fd);
+  }
+
+  SegmentHeader& header() const { return *reinterpret_cast<SegmentHeader*>(base); }
+  template <class T>
+  T* column(int c) const { return reinterpret_cast<T*>(base + columnOffset(header().capacity, c)); }
+
+  uint32_t count() const { return (uint32_t)header().count; }
+  uint32_t capacity() const { return header().capacity; }
+  bool sealed() const { return header().indexOffset != 0; }
+  long lastHop() const { return count() ? (long)column<int64_t>(kHop)[count() - 1] : firstHop - 1; }
+
+  void map() {
+    struct stat stt {};
+    if (::fstat(fd, &stt) != 0) throw std::runtime_error(sysError("Cannot stat", path));
+    size = (size_t)stt.st_size;
+    void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) throw std::runtime_error(sysError("Cannot map", path));
+    base = static_cast<uint8_t*>(p);
+  }
+  void unmap() {
+    if (base) ::munmap(base, size);
+    base = nullptr;
+  }
+  void resize(size_t bytes) {
+    unmap();
+    if (::ftruncate(fd, (off_t)bytes) != 0) throw std::runtime_error(sysError("Cannot resize", path));
+    map();
+  }
+  void sync(size_t offset, size_t bytes) const {
+    size_t page = (size_t)::sysconf(_SC_PAGESIZE);
+    size_t start = offset / page * page;
+    ::msync(base + start, offset + bytes - start, MS_SYNC);
+  }
+
+  static std::unique_ptr<Segment> open(const std::string& path) {
+    auto s = std::make_unique<Segment>();
+    s->path = path;
+    s->fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+    if (s->fd < 0) throw std::runtime_error(sysError("Cannot open", path));
+    s->map();
+    if (s->size < sizeof(SegmentHeader)) throw std::runtime_error("Truncated trip log segment " + path);
+    const SegmentHeader& h = s->header();
+    if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 || h.version != kVersion) {
+      throw std::runtime_error("Not a trip log segment: " + path);
+    }
+    if (s->size < columnOffset(h.capacity, kColumnCount) || h.count > h.capacity ||
+        (h.indexOffset && s->size < h.indexOffset + h.indexBytes)) {
+      throw std::runtime_error("Corrupt trip log segment " + path);
+    }
+    s->firstHop = h.count ? (long)s->column<int64_t>(kHop)[0] : std::atol(fs::path(path).stem().string().c_str() + 4);
+    return s;
+  }
+};
+
+// ---- NDJSON (the original trip_log.ndjson format) ----
+
+static void writeJsonString(std::ostringstream& o, const std::string& s) {
+  o << '"';
+  for (char c : s) {
+    switch (c) {
+      case '"': o << "\\\""; break;
+      case '\\': o << "\\\\"; break;
+      case '\b': o << "\\b"; break;
+      case '\f': o << "\\f"; break;
+      case '\n': o << "\\n"; break;
+      case '\r': o << "\\r"; break;
+      case '\t': o << "\\t"; break;
+      default:
+        if ((unsigned char)c < 0x20) {
+          char buf[8];
+          std::snprintf(buf, sizeof(buf), "\\u%04x", (unsigned)(unsigned char)c);
+          o << buf;
+        } else {
+          o << c;
+        }
+    }
+  }
+  o << '"';
+}
+
+std::string tripRecordJson(const TripRecord& r) {
+  Flight f;
+  f.icao24 = r.icao24;
+  std::ostringstream o;
+  o << "{";
+  o << "\"hop\":" << r.hop << ",";
+  o << "\"logged_at_utc\":" << r.loggedAtUtc << ",";
+  o << "\"from\":"; writeJsonString(o, r.from); o << ",";
+  o << "\"to\":"; writeJsonString(o, r.to); o << ",";
+  o << "\"depart_utc\":" << r.departUtc << ",";
+  o << "\"arrive_utc\":" << r.arriveUtc << ",";
+  o << "\"icao24\":\"" << f.icao24Hex() << "\",";
+  o << "\"callsign\":"; writeJsonString(o, r.callsign); o << ",";
+  o << "\"reason\":"; writeJsonString(o, r.reason);
+  o << "}";
+  return o.str();
+}
+
+// Raw value of a flat key: unescaped string contents, or the number's text.
+static bool jsonField(const std::string& line, const char* key, std::string& out) {
+  std::string pattern = std::string("\"") + key + "\":";
+  size_t p = line.find(pattern);
+  if (p == std::string::npos) return false;
+  p += pattern.size();
+  while (p < line.size() && line[p] == ' ') p++;
+  out.clear();
+  if (p < line.size() && line[p] == '"') {
+    for (p++; p < line.size() && line[p] != '"'; p++) {
+      if (line[p] == '\\' && p + 1 < line.size()) {
+        switch (line[++p]) {
+          case 'b': out += '\b'; break;
+          case 'f': out += '\f'; break;
+          case 'n': out += '\n'; break;
+          case 'r': out += '\r'; break;
+          case 't': out += '\t'; break;
+          case 'u': // writeJsonString only emits these below 0x20
+            if (p + 4 < line.size()) {
+              out += (char)std::strtol(line.substr(p + 1, 4).c_str(), nullptr, 16);
+              p += 4;
+            }
+            break;
+          default: out += line[p];
+        }
+      } else {
+        out += line[p];
+      }
+    }
+    return true;
+  }
+  while (p < line.size() && line[p] != ',' && line[p] != '}' && line[p] != ' ') out += line[p++];
+  return !out.empty();
+}
+
+bool parseTripRecordJson(const std::string& line, TripRecord& r) {
+  std::string v;
+  if (!jsonField(line, "hop", v)) return false;
+  r = TripRecord{};
+  r.hop = std::atol(v.c_str());
+  if (jsonField(line, "logged_at_utc", v)) r.loggedAtUtc = std::atol(v.c_str());
+  if (jsonField(line, "depart_utc", v)) r.departUtc = std::atol(v.c_str());
+  if (jsonField(line, "arrive_utc", v)) r.arriveUtc = std::atol(v.c_str());
+  if (jsonField(line, "icao24", v)) {
+    Flight f;
+    f.setIcao24(v);
+    r.icao24 = f.icao24;
+  }
+  jsonField(line, "callsign", r.callsign);
+  jsonField(line, "from", r.from);
+  jsonField(line, "to", r.to);
+  jsonField(line, "reason", r.reason);
+  return true;
+}
+
+size_t importTripNdjson(TripLog& log, const std::string& ndjsonPath) {
+  // One sync at the end instead of two per row; a crash mid-import just means
+  // importing again.
+  log.setSyncEachAppend(false);
+  struct Restore {
+    TripLog& log;
+    ~Restore() { log.sync(); log.setSyncEachAppend(true); }
+  } restore{log};
+
+  std::ifstream in(ndjsonPath);
+  std::string line;
+  size_t imported = 0;
+  TripRecord r;
+  while (std::getline(in, line)) {
+    if (!parseTripRecordJson(line, r) || r.hop <= log.lastHop()) continue;
+    log.append(r);
+    imported++;
+  }
+  return imported;
+}
+
+bool parseUtcPeriod(const std::string& text, long& beginUtc, long& endUtc) {
+  bool digitsOnly = !text.empty() && std::all_of(text.begin(), text.end(), [](char c) { return c >= '0' && c <= '9'; });
+  if (digitsOnly && text.size() > 4) {
+    beginUtc = endUtc = std::atol(text.c_str());
+    return true;
+  }
+  std::tm t{};
+  int n = std::sscanf(text.c_str(), "%d-%d-%d", &t.tm_year, &t.tm_mon, &t.tm_mday);
+  if (n < 1) return false;
+  t.tm_year -= 1900;
+  t.tm_mon = n >= 2 ? t.tm_mon - 1 : 0;
+  t.tm_mday = n >= 3 ? t.tm_mday : 1;
+  beginUtc = (long)timegm(&t);
+  if (n == 1) t.tm_year++;
+  else if (n == 2) t.tm_mon++;
+  else t.tm_mday++;
+  endUtc = (long)timegm(&t) - 1;
+  return true;
+}
+
+// ---- TripLog ----
+
+TripLog::TripLog(std::string dir, uint32_t segmentCapacity)
+  : dir_(std::move(dir)), capacity_(std::max<uint32_t>(16, segmentCapacity)) {
+  fs::create_directories(dir_);
+
+  airports_ = readLines((fs::path(dir_) / "airports.dict").string());
+  for (size_t i = 0; i < airports_.size(); i++) airportIds_[airports_[i]] = (uint32_t)i + 1;
+  reasons_ = readLines((fs::path(dir_) / "reasons.dict").string());
+  for (size_t i = 0; i < reasons_.size(); i++) reasonIds_[reasons_[i]] = (uint32_t)i + 1;
+
+  std::vector<std::string> files;
+  for (const auto& entry : fs::directory_iterator(dir_)) {
+    std::string name = entry.path().filename().string();
+    if (name.rfind("seg-", 0) != 0) continue;
+    if (entry.path().extension() == ".tmp") {
+      fs::remove(entry.path()); // an interrupted rotation or compaction
+    } else if (entry.path().extension() == ".tlog") {
+      files.push_back(entry.path().string());
+    }
+  }
+  std::sort(files.begin(), files.end()); // zero-padded first hop: name order is hop order
+
+  for (const auto& f : files) {
+    auto s = Segment::open(f);
+    // A compaction interrupted after its rename leaves the merged-away
+    // segments behind; their hops are already in the merged one.
+    if (!segments_.empty() && s->count() && s->firstHop <= segments_.back()->lastHop()) {
+      s.reset();
+      fs::remove(f);
+      continue;
+    }
+    segments_.push_back(std::move(s));
+  }
+}
+
+TripLog::~TripLog() = default;
+
+uint32_t TripLog::internAirport(const std::string& code) {
+  if (code.empty()) return 0;
+  auto it = airportIds_.find(code);
+  if (it != airportIds_.end()) return it->second;
+  appendLine((fs::path(dir_) / "airports.dict").string(), code);
+  airports_.push_back(code);
+  return airportIds_[code] = (uint32_t)airports_.size();
+}
+
+uint32_t TripLog::internReason(const std::string& reason) {
+  std::string r = reason;
+  std::replace(r.begin(), r.end(), '\n', ' ');
+  auto it = reasonIds_.find(r);
+  if (it != reasonIds_.end()) return it->second;
+  appendLine((fs::path(dir_) / "reasons.dict").string(), r);
+  reasons_.push_back(r);
+  return reasonIds_[r] = (uint32_t)reasons_.size();
+}
+
+std::unique_ptr<TripLog::Segment> TripLog::createSegment(long firstHop, uint32_t capacity, const std::string& path) {
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) throw std::runtime_error(sysError("Cannot create", path));
+  SegmentHeader h{};
+  std::memcpy(h.magic, kMagic, sizeof(kMagic));
+  h.version = kVersion;
+  h.capacity = capacity;
+  bool ok = ::ftruncate(fd, (off_t)columnOffset(capacity, kColumnCount)) == 0 &&
+            ::pwrite(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h);
+  ::close(fd);
+  if (!ok) throw std::runtime_error(sysError("Cannot write", path));
+  auto s = Segment::open(path);
+  s->firstHop = firstHop;
+  return s;
+}
+
+void TripLog::append(const TripRecord& r) {
+  if (r.hop <= lastHop()) {
+    throw std::runtime_error("Trip log: hop " + std::to_string(r.hop) + " is not after hop " + std::to_string(lastHop()));
+  }
+  // Dictionary lines go first; a row never refers to an ID that is not on disk.
+  uint32_t from = internAirport(r.from);
+  uint32_t to = internAirport(r.to);
+  uint32_t reason = internReason(r.reason);
+
+  if (!segments_.empty() && !segments_.back()->sealed() && segments_.back()->count() == segments_.back()->capacity()) {
+    seal(*segments_.back());
+  }
+  if (segments_.empty() || segments_.back()->sealed()) {
+    std::string path = (fs::path(dir_) / segmentName(r.hop)).string();
+    auto s = createSegment(r.hop, capacity_, path + ".tmp");
+    if (std::rename((path + ".tmp").c_str(), path.c_str()) != 0) throw std::runtime_error(sysError("Cannot rename", path));
+    s->path = path;
+    segments_.push_back(std::move(s));
+  }
+
+  Segment& s = *segments_.back();
+  uint32_t i = s.count();
+  s.column<int64_t>(kHop)[i] = r.hop;
+  s.column<int64_t>(kLoggedAt)[i] = r.loggedAtUtc;
+  s.column<int64_t>(kDepart)[i] = r.departUtc;
+  s.column<int64_t>(kArrive)[i] = r.arriveUtc;
+  char* cs = s.column<char>(kCallsign) + (size_t)i * 8;
+  std::memset(cs, 0, 8);
+  std::memcpy(cs, r.callsign.data(), std::min<size_t>(8, r.callsign.size()));
+  s.column<uint32_t>(kIcao24)[i] = r.icao24;
+  s.column<uint32_t>(kFrom)[i] = from;
+  s.column<uint32_t>(kTo)[i] = to;
+  s.column<uint32_t>(kReason)[i] = reason;
+  // Columns reach the disk before the count that commits them.
+  if (syncEachAppend_) s.sync(0, columnOffset(s.capacity(), kColumnCount));
+
+  SegmentHeader& h = s.header();
+  h.minDepart = i == 0 ? r.departUtc : std::min<int64_t>(h.minDepart, r.departUtc);
+  h.maxDepart = i == 0 ? r.departUtc : std::max<int64_t>(h.maxDepart, r.departUtc);
+  h.count = i + 1;
+  if (syncEachAppend_) s.sync(0, sizeof(SegmentHeader));
+  if (i == 0) s.firstHop = r.hop;
+}
+
+void TripLog::seal(Segment& s) {
+  std::map<uint32_t, std::vector<uint32_t>> postings;
+  const uint32_t* from = s.column<uint32_t>(kFrom);
+  const uint32_t* to = s.column<uint32_t>(kTo);
+  for (uint32_t i = 0; i < s.count(); i++) {
+    postings[from[i]].push_back(i);
+    if (to[i] != from[i]) postings[to[i]].push_back(i);
+  }
+
+  std::vector<uint32_t> block;
+  block.push_back((uint32_t)postings.size());
+  uint32_t next = 0;
+  for (const auto& [airport, rows] : postings) {
+    block.insert(block.end(), {airport, next, (uint32_t)rows.size()});
+    next += (uint32_t)rows.size();
+  }
+  for (const auto& entry : postings) block.insert(block.end(), entry.second.begin(), entry.second.end());
+
+  size_t offset = columnOffset(s.capacity(), kColumnCount);
+  size_t bytes = block.size() * sizeof(uint32_t);
+  s.resize(offset + bytes);
+  std::memcpy(s.base + offset, block.data(), bytes);
+  s.sync(offset, bytes);
+
+  s.header().indexOffset = offset;
+  s.header().indexBytes = (uint32_t)bytes;
+  s.sync(0, sizeof(SegmentHeader));
+}
+
+TripRecord TripLog::row(const Segment& s, uint32_t i) const {
+  auto name = [](const std::vector<std::string>& dict, uint32_t id) {
+    return id >= 1 && id <= dict.size() ? dict[id - 1] : std::string();
+  };
+  TripRecord r;
+  r.hop = (long)s.column<int64_t>(kHop)[i];
+  r.loggedAtUtc = (long)s.column<int64_t>(kLoggedAt)[i];
+  r.departUtc = (long)s.column<int64_t>(kDepart)[i];
+  r.arriveUtc = (long)s.column<int64_t>(kArrive)[i];
+  const char* cs = s.column<char>(kCallsign) + (size_t)i * 8;
+  r.callsign.assign(cs, strnlen(cs, 8));
+  r.icao24 = s.column<uint32_t>(kIcao24)[i];
+  r.from = name(airports_, s.column<uint32_t>(kFrom)[i]);
+  r.to = name(airports_, s.column<uint32_t>(kTo)[i]);
+  r.reason = name(reasons_, s.column<uint32_t>(kReason)[i]);
+  return r;
+}
+
+void TripLog::sync() {
+  for (const auto& s : segments_) s->sync(0, s->size);
+}
+
+long TripLog::hopCount() const {
+  long n = 0;
+  for (const auto& s : segments_) n += s->count();
+  return n;
+}
+
+long TripLog::lastHop() const {
+  for (auto it = segments_.rbegin(); it != segments_.rend(); ++it) {
+    if ((*it)->count()) return (*it)->lastHop();
+  }
+  return 0;
+}
+
+std::optional<TripRecord> TripLog::findHop(long hop) const {
+  auto it = std::upper_bound(segments_.begin(), segments_.end(), hop,
+                             [](long h, const std::unique_ptr<Segment>& s) { return h < s->firstHop; });
+  if (it == segments_.begin()) return std::nullopt;
+  const Segment& s = **(it - 1);
+  const int64_t* hops = s.column<int64_t>(kHop);
+  const int64_t* pos = std::lower_bound(hops, hops + s.count(), (int64_t)hop);
+  if (pos == hops + s.count() || *pos != hop) return std::nullopt;
+  return row(s, (uint32_t)(pos - hops));
+}
+
+std::vector<TripRecord> TripLog::throughAirport(const std::string& icao) const {
+  std::vector<TripRecord> out;
+  auto id = airportIds_.find(icao);
+  if (id == airportIds_.end()) return out;
+  uint32_t a = id->second;
+
+  for (const auto& sp : segments_) {
+    const Segment& s = *sp;
+    if (s.sealed()) {
+      const uint32_t* block = reinterpret_cast<const uint32_t*>(s.base + s.header().indexOffset);
+      const PostingEntry* entries = reinterpret_cast<const PostingEntry*>(block + 1);
+      const PostingEntry* end = entries + block[0];
+      const PostingEntry* e = std::lower_bound(entries, end, a,
+                                               [](const PostingEntry& p, uint32_t v) { return p.airport < v; });
+      if (e == end || e->airport != a) continue;
+      const uint32_t* rows = reinterpret_cast<const uint32_t*>(end);
+      for (uint32_t k = 0; k < e->n; k++) out.push_back(row(s, rows[e->first + k]));
+    } else {
+      const uint32_t* from = s.column<uint32_t>(kFrom);
+      const uint32_t* to = s.column<uint32_t>(kTo);
+      for (uint32_t i = 0; i < s.count(); i++) {
+        if (from[i] == a || to[i] == a) out.push_back(row(s, i));
+      }
+    }
+  }
+  // Postings list a segment's departures and arrivals separately.
+  std::sort(out.begin(), out.end(), [](const TripRecord& x, const TripRecord& y) { return x.hop < y.hop; });
+  return out;
+}
+
+std::vector<TripRecord> TripLog::departedBetween(long beginUtc, long endUtc) const {
+  std::vector<TripRecord> out;
+  for (const auto& sp : segments_) {
+    const Segment& s = *sp;
+    if (!s.count() || s.header().maxDepart < beginUtc || s.header().minDepart > endUtc) continue;
+    const int64_t* depart = s.column<int64_t>(kDepart);
+    for (uint32_t i = 0; i < s.count(); i++) {
+      if (depart[i] >= beginUtc && depart[i] <= endUtc) out.push_back(row(s, i));
+    }
+  }
+  return out;
+}
+
+void TripLog::forEach(const std::function<void(const TripRecord&)>& fn) const {
+  for (const auto& s : segments_) {
+    for (uint32_t i = 0; i < s->count(); i++) fn(row(*s, i));
+  }
+}
+
+CompactReport TripLog::compact(uint32_t maxRows) {
+  CompactReport report;
+  report.segmentsBefore = segments_.size();
+
+  // segments_ is only changed once a merged segment has been renamed into
+  // place, so a failure part way leaves this log as it is on disk.
+  size_t i = 0;
+  while (i < segments_.size()) {
+    size_t j = i;
+    uint64_t rows = 0;
+    while (j < segments_.size() && segments_[j]->sealed() && rows + segments_[j]->count() <= maxRows) {
+      rows += segments_[j]->count();
+      j++;
+    }
+    if (j - i < 2) {
+      i++;
+      continue;
+    }
+
+    // Build the merged segment beside the first one, then rename it into place.
+    std::string path = segments_[i]->path;
+    std::unique_ptr<Segment> merged;
+    try {
+      merged = createSegment(segments_[i]->firstHop, (uint32_t)rows, path + ".tmp");
+      uint32_t at = 0;
+      SegmentHeader& h = merged->header();
+      h.minDepart = segments_[i]->header().minDepart;
+      h.maxDepart = segments_[i]->header().maxDepart;
+      for (size_t k = i; k < j; k++) {
+        const Segment& src = *segments_[k];
+        for (int c = 0; c < kColumnCount; c++) {
+          std::memcpy(merged->column<uint8_t>(c) + kWidth[c] * at, src.column<uint8_t>(c), kWidth[c] * src.count());
+        }
+        h.minDepart = std::min(h.minDepart, src.header().minDepart);
+        h.maxDepart = std::max(h.maxDepart, src.header().maxDepart);
+        at += src.count();
+      }
+      merged->sync(0, merged->size);
+      h.count = rows;
+      merged->sync(0, sizeof(SegmentHeader));
+      seal(*merged);
+      if (std::rename((path + ".tmp").c_str(), path.c_str()) != 0) throw std::runtime_error(sysError("Cannot rename", path));
+    } catch (...) {
+      merged.reset();
+      std::error_code ec;
+      fs::remove(path + ".tmp", ec);
+      throw;
+    }
+    merged->path = path;
+
+    std::vector<std::string> mergedAway;
+    for (size_t k = i + 1; k < j; k++) mergedAway.push_back(segments_[k]->path);
+    segments_[i] = std::move(merged);
+    segments_.erase(segments_.begin() + (long)i + 1, segments_.begin() + (long)j);
+    // Leftovers are harmless: opening the log drops segments a merged one covers.
+    for (const auto& p : mergedAway) {
+      std::error_code ec;
+      fs::remove(p, ec);
+    }
+    i++;
+  }
+
+  report.segmentsAfter = segments_.size();
+  return report;
+}
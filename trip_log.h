@@ -0,0 +1,101 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// One hop as recorded in the trip log.
+struct TripRecord {
+  long hop = 0;
+  long loggedAtUtc = 0;
+  long departUtc = 0;
+  long arriveUtc = 0;
+  uint32_t icao24 = 0;
+  std::string callsign;
+  std::string from;
+  std::string to;
+  std::string reason;
+};
+
+// The trip_log.ndjson line for a record (no trailing newline).
+std::string tripRecordJson(const TripRecord& r);
+// Parses a trip_log.ndjson line; false if it has no "hop".
+bool parseTripRecordJson(const std::string& line, TripRecord& out);
+
+// "2026-03" -> that month, "2026-03-14" -> that day, "2026" -> that year, or a
+// unix timestamp; [beginUtc, endUtc] inclusive. False if unparseable.
+bool parseUtcPeriod(const std::string& text, long& beginUtc, long& endUtc);
+
+struct CompactReport {
+  size_t segmentsBefore = 0;
+  size_t segmentsAfter = 0;
+};
+
+// Append-only binary trip log.
+//
+// <dir>/seg-<first hop>.tlog files hold the hops in columns (hop, times,
+// callsign, icao24, from/to airport IDs, reason ID), each column a fixed-width
+// array sized for the segment's capacity, so a query touches only the columns
+// it needs. A row is committed by the header's row count, written after its
+// columns. Airport codes and reasons are kept once in airports.dict /
+// reasons.dict (one per line; ID = line number).
+//
+// When the active segment fills up it is sealed: a postings index (airport ID
+// -> rows) is appended and a new segment started. compact() merges runs of
+// sealed segments into larger ones. Lookups:
+//   hop N      binary search over segments, then over the hop column
+//   airport    postings in sealed segments, a two-column scan in the active one
+//   time range segments pruned by their min/max departure, then one column scan
+class TripLog {
+ public:
+  explicit TripLog(std::string dir, uint32_t segmentCapacity = 4096);
+  ~TripLog();
+
+  TripLog(const TripLog&) = delete;
+  TripLog& operator=(const TripLog&) = delete;
+
+  // Hops must be appended in increasing order.
+  void append(const TripRecord& r);
+
+  // Each append is synced to disk by default; bulk loads turn that off and
+  // call sync() once at the end.
+  void setSyncEachAppend(bool on) { syncEachAppend_ = on; }
+  void sync();
+
+  long hopCount() const;
+  long lastHop() const; // 0 when empty
+  size_t segmentCount() const { return segments_.size(); }
+
+  std::optional<TripRecord> findHop(long hop) const;
+  std::vector<TripRecord> throughAirport(const std::string& icao) const;
+  std::vector<TripRecord> departedBetween(long beginUtc, long endUtc) const;
+  void forEach(const std::function<void(const TripRecord&)>& fn) const;
+
+  // Merges adjacent sealed segments while the result stays within maxRows.
+  CompactReport compact(uint32_t maxRows = 64 * 1024);
+
+ private:
+  struct Segment;
+
+  std::string dir_;
+  uint32_t capacity_;
+  bool syncEachAppend_ = true;
+  std::vector<std::unique_ptr<Segment>> segments_; // by first hop
+
+  std::vector<std::string> airports_; // ID - 1 -> code
+  std::unordered_map<std::string, uint32_t> airportIds_;
+  std::vector<std::string> reasons_;
+  std::unordered_map<std::string, uint32_t> reasonIds_;
+
+  uint32_t internAirport(const std::string& code);
+  uint32_t internReason(const std::string& reason);
+  TripRecord row(const Segment& s, uint32_t i) const;
+  void seal(Segment& s);
+  std::unique_ptr<Segment> createSegment(long firstHop, uint32_t capacity, const std::string& path);
+};
+
+// Appends the records of a trip_log.ndjson that are newer than log.lastHop().
+size_t importTripNdjson(TripLog& log, const std::string& ndjsonPath);